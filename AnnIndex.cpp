@@ -0,0 +1,113 @@
+#include "AnnIndex.h"
+#include "FeaturePager.h"
+#include "SimdKernels.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <random>
+
+// Centroids are unit length, so the largest dot product is the largest cosine.
+std::size_t AnnIndex::nearest_list(const double* row) const {
+    std::size_t best = 0;
+    double best_similarity = -std::numeric_limits<double>::infinity();
+    for (std::size_t list = 0; list < lists.size(); ++list) {
+        double similarity = dot_product(centroid(list), row, row_stride);
+        if (similarity > best_similarity) {
+            best_similarity = similarity;
+            best = list;
+        }
+    }
+    return best;
+}
+
+void AnnIndex::build(const MovieCatalog& movies, const AnnOptions& options) {
+    dim = movies.dimension();
+    row_stride = movies.stride();
+    indexed = movies.size();
+    std::size_t list_total = options.lists;
+    if (list_total == 0) {
+        list_total = static_cast<std::size_t>(std::sqrt(static_cast<double>(indexed)));
+    }
+    list_total = std::max<std::size_t>(1, std::min(list_total, std::max<std::size_t>(1, indexed)));
+
+    centroids.assign(list_total * row_stride, 0.0);
+    lists.assign(list_total, {});
+    if (indexed == 0) {
+        return;
+    }
+
+    // Seed the centroids with distinct random movies.
+    std::vector<movie_id> order(indexed);
+    std::iota(order.begin(), order.end(), 0);
+    std::mt19937 random(options.seed);
+    std::shuffle(order.begin(), order.end(), random);
+    auto set_centroid = [&](std::size_t list, const double* row, double norm) {
+        double* target = centroids.data() + list * row_stride;
+        for (std::size_t i = 0; i < row_stride; ++i) {
+            target[i] = (norm > 0.0) ? row[i] / norm : 0.0;
+        }
+    };
+    RowCursor rows(movies);
+    for (std::size_t list = 0; list < list_total; ++list) {
+        set_centroid(list, rows.row(order[list]), movies.norm(order[list]));
+    }
+
+    // Spherical k-means: assign by cosine, recenter on the normalized mean.
+    std::vector<std::size_t> assignment(indexed, 0);
+    std::vector<double> sums(list_total * row_stride);
+    std::vector<std::size_t> sizes(list_total);
+    for (std::size_t round = 0; round <= options.iterations; ++round) {
+        bool changed = false;
+        for (movie_id id = 0; id < indexed; ++id) {
+            std::size_t list = nearest_list(rows.row(id));
+            changed |= (round == 0 || list != assignment[id]);
+            assignment[id] = list;
+        }
+        if (!changed || round == options.iterations) {
+            break;
+        }
+
+        std::fill(sums.begin(), sums.end(), 0.0);
+        std::fill(sizes.begin(), sizes.end(), 0);
+        for (movie_id id = 0; id < indexed; ++id) {
+            double norm = movies.norm(id);
+            if (norm == 0.0) continue;
+            const double* row = rows.row(id);
+            double* sum = sums.data() + assignment[id] * row_stride;
+            for (std::size_t i = 0; i < dim; ++i) {
+                sum[i] += row[i] / norm;
+            }
+            sizes[assignment[id]]++;
+        }
+        for (std::size_t list = 0; list < list_total; ++list) {
+            if (sizes[list] == 0) continue; // keep the old centroid for an empty cluster
+            const double* sum = sums.data() + list * row_stride;
+            set_centroid(list, sum, std::sqrt(dot_product(sum, sum, row_stride)));
+        }
+    }
+
+    for (movie_id id = 0; id < indexed; ++id) {
+        lists[assignment[id]].push_back(id);
+    }
+}
+
+std::vector<const std::vector<movie_id>*> AnnIndex::probe(const double* query,
+                                                          std::size_t probes) const {
+    std::vector<std::pair<double, std::size_t>> ranked;
+    ranked.reserve(lists.size());
+    for (std::size_t list = 0; list < lists.size(); ++list) {
+        ranked.emplace_back(dot_product(centroid(list), query, row_stride), list);
+    }
+    probes = std::min(probes, ranked.size());
+    std::partial_sort(ranked.begin(), ranked.begin() + probes, ranked.end(),
+                      [](const auto& a, const auto& b) {
+                          return a.first != b.first ? a.first > b.first : a.second < b.second;
+                      });
+
+    std::vector<const std::vector<movie_id>*> selected;
+    for (std::size_t i = 0; i < probes; ++i) {
+        selected.push_back(&lists[ranked[i].second]);
+    }
+    return selected;
+}
@@ -0,0 +1,48 @@
+#ifndef ANNINDEX_H
+#define ANNINDEX_H
+
+#include "MovieCatalog.h"
+#include <cstddef>
+#include <vector>
+
+struct AnnOptions {
+    std::size_t lists = 0;       // number of clusters, 0 for about sqrt(catalog size)
+    std::size_t probes = 8;      // clusters scanned per query
+    std::size_t iterations = 10; // k-means rounds
+    unsigned seed = 42;
+};
+
+/**
+ * Inverted-file (IVF) approximate nearest-neighbor index over the catalog's
+ * normalized feature vectors. Movies are clustered with spherical k-means; a
+ * query only scores the movies of the `probes` clusters whose centroids are
+ * most similar to it. Movies added to the catalog after the build are not
+ * clustered and are always scanned.
+ */
+class AnnIndex {
+private:
+    std::size_t dim;
+    std::size_t row_stride;
+    std::size_t indexed;
+    std::vector<double, AlignedAllocator<double, FEATURE_ALIGNMENT>> centroids;
+    std::vector<std::vector<movie_id>> lists; // ids in increasing order
+
+    const double* centroid(std::size_t list) const { return centroids.data() + list * row_stride; }
+    std::size_t nearest_list(const double* row) const;
+
+public:
+    AnnIndex() : dim(0), row_stride(0), indexed(0) {}
+
+    void build(const MovieCatalog& movies, const AnnOptions& options);
+
+    /**
+     * @return the lists of the `probes` clusters closest to the query, closest first
+     */
+    std::vector<const std::vector<movie_id>*> probe(const double* query, std::size_t probes) const;
+
+    // Movies with ids from here on were added after the build.
+    movie_id indexed_count() const { return static_cast<movie_id>(indexed); }
+    std::size_t list_count() const { return lists.size(); }
+};
+
+#endif // ANNINDEX_H
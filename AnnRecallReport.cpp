@@ -0,0 +1,73 @@
+#include "AnnRecallReport.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <stdexcept>
+
+typedef std::chrono::steady_clock rs_clock;
+
+static double micros_since(rs_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(rs_clock::now() - start).count();
+}
+
+AnnRecallReport measure_ann_recall(const RecommendationSystem& rs, const std::vector<User>& users,
+                                   int n, const std::vector<std::size_t>& probe_counts) {
+    if (!rs.get_ann_index()) {
+        throw std::logic_error("No ANN index enabled");
+    }
+
+    AnnRecallReport report{n, 0, 0.0, {}};
+    std::vector<std::vector<scored_movie>> exact;
+    rs_clock::time_point start = rs_clock::now();
+    for (const User& user : users) {
+        exact.push_back(rs.recommend_top_n_by_content_exact(user, n));
+    }
+    report.users = users.size();
+    report.exact_micros = users.empty() ? 0.0 : micros_since(start) / users.size();
+
+    for (std::size_t probes : probe_counts) {
+        AnnRecallPoint point{probes, 0.0, 0.0, 0.0};
+        std::size_t scored_users = 0;
+        start = rs_clock::now();
+        std::vector<std::vector<scored_movie>> approximate;
+        for (const User& user : users) {
+            approximate.push_back(rs.recommend_top_n_by_content_ann(user, n, probes));
+        }
+        point.ann_micros = users.empty() ? 0.0 : micros_since(start) / users.size();
+
+        for (std::size_t u = 0; u < users.size(); ++u) {
+            if (exact[u].empty()) continue;
+            std::size_t found = 0;
+            for (const auto& [movie, score] : exact[u]) {
+                found += std::any_of(approximate[u].begin(), approximate[u].end(),
+                                     [&](const scored_movie& candidate) {
+                                         return candidate.first == movie;
+                                     });
+            }
+            point.recall += static_cast<double>(found) / exact[u].size();
+            point.top1_agreement += (!approximate[u].empty() &&
+                                     approximate[u].front().first == exact[u].front().first);
+            scored_users++;
+        }
+        if (scored_users > 0) {
+            point.recall /= scored_users;
+            point.top1_agreement /= scored_users;
+        }
+        report.points.push_back(point);
+    }
+    return report;
+}
+
+std::ostream& operator<<(std::ostream& os, const AnnRecallReport& report) {
+    os << "ANN recall@" << report.n << " over " << report.users << " users"
+       << " (exact scan " << std::fixed << std::setprecision(1) << report.exact_micros
+       << " us/query)\n";
+    os << "probes  recall  top1    us/query\n";
+    for (const AnnRecallPoint& point : report.points) {
+        os << std::setw(6) << point.probes << "  "
+           << std::setprecision(4) << point.recall << "  "
+           << point.top1_agreement << "  "
+           << std::setprecision(1) << point.ann_micros << "\n";
+    }
+    return os;
+}
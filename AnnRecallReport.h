@@ -0,0 +1,34 @@
+#ifndef ANNRECALLREPORT_H
+#define ANNRECALLREPORT_H
+
+#include "RecommendationSystem.h"
+#include "User.h"
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+struct AnnRecallPoint {
+    std::size_t probes;
+    double recall;          // mean fraction of the exact top-n found by the index
+    double top1_agreement;  // fraction of users whose best movie is unchanged
+    double ann_micros;      // mean query latency through the index
+};
+
+struct AnnRecallReport {
+    int n;
+    std::size_t users;
+    double exact_micros;    // mean query latency of the exhaustive scan
+    std::vector<AnnRecallPoint> points;
+};
+
+/**
+ * Compares ANN content recommendations against the exhaustive scan for every
+ * user and probe count, to pick an accuracy/latency operating point.
+ * @throws std::logic_error if rs has no ANN index enabled
+ */
+AnnRecallReport measure_ann_recall(const RecommendationSystem& rs, const std::vector<User>& users,
+                                   int n, const std::vector<std::size_t>& probe_counts);
+
+std::ostream& operator<<(std::ostream& os, const AnnRecallReport& report);
+
+#endif // ANNRECALLREPORT_H
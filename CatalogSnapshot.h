@@ -0,0 +1,66 @@
+#ifndef CATALOGSNAPSHOT_H
+#define CATALOGSNAPSHOT_H
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Binary catalog snapshot, native byte order:
+ *
+ *   SnapshotHeader
+ *   string table:  count x { int32 year, uint32 name_length, name bytes }
+ *   features:      count x stride doubles, row-major, FEATURE_ALIGNMENT aligned
+ *   norms:         count doubles
+ *
+ * The checksum is FNV-1a over everything after the header.
+ */
+
+#define SNAPSHOT_MAGIC "RSCATLG"
+#define SNAPSHOT_VERSION 1
+
+struct SnapshotHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t header_size;
+    std::uint64_t dimension;
+    std::uint64_t stride;
+    std::uint64_t count;
+    std::uint64_t strings_offset;
+    std::uint64_t strings_size;
+    std::uint64_t features_offset;
+    std::uint64_t norms_offset;
+    std::uint64_t file_size;
+    std::uint64_t checksum;
+};
+
+#define FNV_OFFSET_BASIS 14695981039346656037ull
+#define FNV_PRIME 1099511628211ull
+
+inline std::uint64_t snapshot_checksum(const char* data, std::size_t size,
+                                       std::uint64_t hash = FNV_OFFSET_BASIS) {
+    for (std::size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+// Layout arithmetic on header fields, which may hold anything: false instead
+// of a wrapped result when a * b or a + b does not fit in 64 bits.
+inline bool checked_product(std::uint64_t a, std::uint64_t b, std::uint64_t& product) {
+    if (b != 0 && a > UINT64_MAX / b) {
+        return false;
+    }
+    product = a * b;
+    return true;
+}
+
+inline bool checked_sum(std::uint64_t a, std::uint64_t b, std::uint64_t& sum) {
+    if (a > UINT64_MAX - b) {
+        return false;
+    }
+    sum = a + b;
+    return true;
+}
+
+#endif // CATALOGSNAPSHOT_H
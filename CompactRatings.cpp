@@ -0,0 +1,50 @@
+#include "CompactRatings.h"
+#include <algorithm>
+
+std::vector<CompactRating>::const_iterator CompactRatings::lower_bound(movie_id id) const {
+    return std::lower_bound(entries.begin(), entries.end(), id,
+                            [](const CompactRating& entry, movie_id key) { return entry.id < key; });
+}
+
+void CompactRatings::set(movie_id id, double rating) {
+    float stored = static_cast<float>(rating);
+    if (entries.empty() || entries.back().id < id) {
+        entries.push_back(CompactRating{id, stored});
+        return;
+    }
+    auto it = entries.begin() + (lower_bound(id) - entries.cbegin());
+    if (it != entries.end() && it->id == id) {
+        it->rating = stored;
+    } else {
+        entries.insert(it, CompactRating{id, stored});
+    }
+}
+
+void CompactRatings::merge(const std::vector<CompactRating>& ratings) {
+    std::vector<CompactRating> merged;
+    merged.reserve(entries.size() + ratings.size());
+    auto old = entries.cbegin();
+    for (std::size_t i = 0; i < ratings.size(); ++i) {
+        if (i + 1 < ratings.size() && ratings[i + 1].id == ratings[i].id) {
+            continue;
+        }
+        while (old != entries.cend() && old->id < ratings[i].id) {
+            merged.push_back(*old++);
+        }
+        if (old != entries.cend() && old->id == ratings[i].id) {
+            ++old;
+        }
+        merged.push_back(ratings[i]);
+    }
+    merged.insert(merged.end(), old, entries.cend());
+    entries.swap(merged);
+}
+
+bool CompactRatings::contains(movie_id id) const {
+    return find(id) != nullptr;
+}
+
+const float* CompactRatings::find(movie_id id) const {
+    auto it = lower_bound(id);
+    return (it != entries.end() && it->id == id) ? &it->rating : nullptr;
+}
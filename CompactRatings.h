@@ -0,0 +1,52 @@
+#ifndef COMPACTRATINGS_H
+#define COMPACTRATINGS_H
+
+#include "MovieCatalog.h"
+#include <cstddef>
+#include <vector>
+
+struct CompactRating {
+    movie_id id;
+    float rating;
+};
+
+/**
+ * A user's ratings as an array of (movie id, rating) sorted by id: 8 bytes
+ * per rating instead of a hash node per rating. Ids refer to the catalog
+ * of the user's RecommendationSystem.
+ */
+class CompactRatings {
+private:
+    std::vector<CompactRating> entries;
+
+    std::vector<CompactRating>::const_iterator lower_bound(movie_id id) const;
+
+public:
+    /**
+     * Sets or replaces the rating of a movie. Appending in increasing id
+     * order is O(1), anything else shifts the tail.
+     */
+    void set(movie_id id, double rating);
+
+    /**
+     * Sets many ratings in one merge instead of one insertion each.
+     * @param ratings - sorted by id; of equal ids the last one wins
+     */
+    void merge(const std::vector<CompactRating>& ratings);
+
+    bool contains(movie_id id) const;
+
+    /**
+     * @return pointer to the rating of the movie, nullptr if it is not rated
+     */
+    const float* find(movie_id id) const;
+
+    std::size_t size() const { return entries.size(); }
+    bool empty() const { return entries.empty(); }
+    std::size_t memory_usage() const { return entries.capacity() * sizeof(CompactRating); }
+
+    std::vector<CompactRating>::const_iterator begin() const { return entries.begin(); }
+    std::vector<CompactRating>::const_iterator end() const { return entries.end(); }
+};
+
+#endif // COMPACTRATINGS_H
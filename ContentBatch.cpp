@@ -0,0 +1,84 @@
+#include "ContentBatch.h"
+#include "FeaturePager.h"
+#include "SimdKernels.h"
+#include <algorithm>
+
+ContentBatch::ContentBatch(std::size_t stride) : stride(stride), rated_offsets(1, 0) {}
+
+std::vector<TopN> ContentBatch::score(const MovieCatalog& movies, std::size_t n,
+                                      ThreadPool* executor) const {
+    std::vector<TopN> best(size(), TopN(n, movies.size()));
+    if (movies.empty() || n == 0 || size() == 0) {
+        return best;
+    }
+    std::size_t blocks = (size() + BATCH_USER_BLOCK - 1) / BATCH_USER_BLOCK;
+    auto run = [&](std::size_t block) {
+        std::size_t first = block * BATCH_USER_BLOCK;
+        score_block(movies, first, std::min<std::size_t>(BATCH_USER_BLOCK, size() - first), best);
+    };
+    if (executor && blocks > 1) {
+        executor->parallel_for(blocks, run);
+    } else {
+        for (std::size_t block = 0; block < blocks; ++block) run(block);
+    }
+    return best;
+}
+
+// Packs each catalog tile dimension-major (width a multiple of 8, padded with
+// zero columns), multiplies the block's preference rows with it, and feeds
+// the cosines of the unrated movies to the users' selections. Ids only grow,
+// so a cosine not above a full selection's floor is dropped before the rated
+// check.
+void ContentBatch::score_block(const MovieCatalog& movies, std::size_t first_user,
+                               std::size_t users, std::vector<TopN>& best) const {
+    const std::size_t dim = movies.dimension();
+    const dot_panel_func kernel = dot_panel_kernel();
+    thread_local std::vector<double, AlignedAllocator<double, FEATURE_ALIGNMENT>> panel, dots;
+    panel.assign(dim * BATCH_MOVIE_TILE, 0.0);
+    dots.assign(BATCH_USER_BLOCK * BATCH_MOVIE_TILE, 0.0);
+
+    // Per user, the first rated id not below the current movie.
+    std::vector<std::size_t> cursor(rated_offsets.begin() + first_user,
+                                    rated_offsets.begin() + first_user + users);
+
+    const movie_id count = static_cast<movie_id>(movies.size());
+    RowCursor rows(movies);
+    for (movie_id tile = 0; tile < count; tile += BATCH_MOVIE_TILE) {
+        std::size_t columns = std::min<std::size_t>(BATCH_MOVIE_TILE, count - tile);
+        std::size_t width = (columns + 7) / 8 * 8;
+        for (std::size_t c = 0; c < columns; ++c) {
+            const double* row = rows.row(tile + c);
+            for (std::size_t k = 0; k < dim; ++k) {
+                panel[k * width + c] = row[k];
+            }
+        }
+        for (std::size_t c = columns; c < width; ++c) {
+            for (std::size_t k = 0; k < dim; ++k) {
+                panel[k * width + c] = 0.0;
+            }
+        }
+
+        kernel(preferences.data() + first_user * stride, users, stride,
+               panel.data(), dim, width, dots.data(), BATCH_MOVIE_TILE);
+
+        for (std::size_t r = 0; r < users; ++r) {
+            const std::size_t user = first_user + r;
+            const std::size_t rated_end = rated_offsets[user + 1];
+            std::size_t& next = cursor[r];
+            TopN& selection = best[user];
+            double* scores = dots.data() + r * BATCH_MOVIE_TILE;
+            for (std::size_t c = 0; c < columns; ++c) {
+                scores[c] = cosine_from_norms(scores[c], norms[user], movies.norm(tile + c));
+            }
+            double floor = selection.floor();
+            for (std::size_t c = 0; c < columns; ++c) {
+                if (!(scores[c] > floor)) continue;
+                movie_id id = tile + static_cast<movie_id>(c);
+                while (next < rated_end && rated_ids[next] < id) ++next;
+                if (next < rated_end && rated_ids[next] == id) continue;
+                selection.push(scores[c], id);
+                floor = selection.floor();
+            }
+        }
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef CONTENTBATCH_H
+#define CONTENTBATCH_H
+
+#include "MovieCatalog.h"
+#include "ThreadPool.h"
+#include "TopN.h"
+#include <cstddef>
+#include <vector>
+
+// Users scored together against one packed catalog tile.
+#define BATCH_USER_BLOCK 32
+
+// Movies per packed tile; with 8 to 32 features a tile stays in L2.
+#define BATCH_MOVIE_TILE 256
+
+/**
+ * Content scoring for many users in one pass: the users' preference vectors
+ * are stacked into a matrix and multiplied with the catalog feature matrix
+ * tile by tile, so each tile is packed and loaded once per block of
+ * BATCH_USER_BLOCK users instead of once per user.
+ *
+ * Every movie is scored exactly in float64; there is no ANN or quantized
+ * path. Scores equal the per-user scan's up to summation order.
+ */
+class ContentBatch {
+private:
+    std::size_t stride;
+    std::vector<double, AlignedAllocator<double, FEATURE_ALIGNMENT>> preferences; // one row per user
+    std::vector<double> norms;
+    std::vector<movie_id> rated_ids;          // per user, sorted
+    std::vector<std::size_t> rated_offsets;   // user u: [rated_offsets[u], rated_offsets[u + 1])
+
+    void score_block(const MovieCatalog& movies, std::size_t first_user, std::size_t users,
+                     std::vector<TopN>& best) const;
+
+public:
+    // @param stride - row stride of the catalog the users will be scored against
+    explicit ContentBatch(std::size_t stride);
+
+    /**
+     * Appends a user.
+     * @param preference - stride doubles, zero past the catalog dimension
+     * @param rated - ids the user rated, sorted; they are never returned
+     */
+    template <typename Iterator>
+    void add(const double* preference, double norm, Iterator rated_begin, Iterator rated_end) {
+        preferences.insert(preferences.end(), preference, preference + stride);
+        norms.push_back(norm);
+        rated_ids.insert(rated_ids.end(), rated_begin, rated_end);
+        rated_offsets.push_back(rated_ids.size());
+    }
+
+    std::size_t size() const { return norms.size(); }
+
+    /**
+     * The n best unrated movies of every user, in the order they were added.
+     * Blocks of users run in parallel on the executor when one is given.
+     */
+    std::vector<TopN> score(const MovieCatalog& movies, std::size_t n, ThreadPool* executor) const;
+};
+
+#endif // CONTENTBATCH_H
@@ -0,0 +1,89 @@
+#include "DataGenerator.h"
+#include <cstdint>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+// Title and year of movie i, shared by both files.
+static std::string movie_title(std::size_t i, unsigned seed) {
+    std::uint64_t mixed = (i + 1) * 0x9e3779b97f4a7c15ULL ^ seed;
+    return "Movie" + std::to_string(i) + "-" + std::to_string(1950 + mixed % 71);
+}
+
+static std::ofstream open_output(const std::string& file_path) {
+    std::ofstream file(file_path);
+    if (!file) {
+        throw std::runtime_error("Failed to open file: " + file_path);
+    }
+    return file;
+}
+
+void DataGenerator::write_movies(const std::string& file_path,
+                                 const DataGeneratorOptions& options) {
+    if (options.dimension == 0) {
+        throw std::invalid_argument("Feature dimension must be positive.");
+    }
+    std::ofstream file = open_output(file_path);
+    std::mt19937_64 random(options.seed);
+    std::uniform_real_distribution<double> feature(1.0, 10.0);
+
+    file.precision(4);
+    file << std::fixed;
+    for (std::size_t i = 0; i < options.movies; ++i) {
+        file << movie_title(i, options.seed);
+        for (std::size_t f = 0; f < options.dimension; ++f) {
+            file << ' ' << feature(random);
+        }
+        file << '\n';
+    }
+    if (!file) {
+        throw std::runtime_error("Failed to write file: " + file_path);
+    }
+}
+
+void DataGenerator::write_users(const std::string& file_path,
+                                const DataGeneratorOptions& options) {
+    if (options.movies == 0) {
+        throw std::invalid_argument("Users need at least one movie to rate.");
+    }
+    std::ofstream file = open_output(file_path);
+    // Independent of the movies stream, so either file can be regenerated alone.
+    std::mt19937_64 random(options.seed * 0x2545f4914f6cdd1dULL + 1);
+    std::uniform_real_distribution<double> rating(1.0, 10.0);
+    std::bernoulli_distribution rated(options.density);
+    std::uniform_int_distribution<std::size_t> any_movie(0, options.movies - 1);
+
+    for (std::size_t i = 0; i < options.movies; ++i) {
+        file << (i ? " " : "") << movie_title(i, options.seed);
+    }
+    file << '\n';
+
+    file.precision(3);
+    file << std::fixed;
+    std::vector<double> ratings(options.movies);
+    for (std::size_t u = 0; u < options.users; ++u) {
+        bool any = false;
+        for (double& value : ratings) {
+            value = rated(random) ? rating(random) : 0.0;
+            any = any || value != 0.0;
+        }
+        if (!any) {
+            ratings[any_movie(random)] = rating(random);
+        }
+
+        file << "user" << u;
+        for (double value : ratings) {
+            file << ' ';
+            if (value == 0.0) {
+                file << "NA";
+            } else {
+                file << value;
+            }
+        }
+        file << '\n';
+    }
+    if (!file) {
+        throw std::runtime_error("Failed to write file: " + file_path);
+    }
+}
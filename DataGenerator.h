@@ -0,0 +1,27 @@
+#ifndef DATAGENERATOR_H
+#define DATAGENERATOR_H
+
+#include <cstddef>
+#include <string>
+
+struct DataGeneratorOptions {
+    std::size_t movies = 1000;
+    std::size_t dimension = 16;
+    std::size_t users = 100;
+    double density = 0.1; // probability that a user rated a given movie
+    unsigned seed = 1;
+};
+
+/**
+ * Writes synthetic movies and users files in the formats read by
+ * RecommendationSystemLoader and UsersLoader. The same options always produce
+ * the same files. Titles are "Movie<i>" with a year in [1950, 2020], features
+ * are in [1, 10] and ratings in [1, 10]; every user rates at least one movie.
+ */
+class DataGenerator {
+public:
+    static void write_movies(const std::string& file_path, const DataGeneratorOptions& options);
+    static void write_users(const std::string& file_path, const DataGeneratorOptions& options);
+};
+
+#endif // DATAGENERATOR_H
@@ -0,0 +1,186 @@
+#include "FeaturePager.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define RS_HAVE_PREAD 1
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#endif
+
+FeaturePager::FeaturePager(const std::string& path, std::uint64_t offset, std::size_t stride,
+                           std::size_t rows, const PagerOptions& options)
+    : path(path), offset(offset), row_stride(stride), row_count(rows), options(options) {
+    if (this->options.block_rows == 0) {
+        throw std::invalid_argument("Pages need at least one row");
+    }
+    std::size_t block_bytes =
+        std::max<std::size_t>(1, this->options.block_rows * stride * sizeof(double));
+    capacity = std::max<std::size_t>(1, this->options.cache_bytes / block_bytes);
+#ifdef RS_HAVE_PREAD
+    fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open file: " + path);
+    }
+#endif
+}
+
+FeaturePager::~FeaturePager() {
+#ifdef RS_HAVE_PREAD
+    if (fd >= 0) {
+        ::close(fd);
+    }
+#endif
+}
+
+// Reads one block; runs without the lock so that misses on different blocks overlap.
+std::shared_ptr<const FeaturePager::Page> FeaturePager::read_page(std::size_t block) const {
+    auto page = std::make_shared<Page>();
+    page->first = block * options.block_rows;
+    page->count = std::min(options.block_rows, row_count - page->first);
+    page->rows.resize(page->count * row_stride);
+    std::size_t length = page->rows.size() * sizeof(double);
+    std::uint64_t position = offset + page->first * row_stride * sizeof(double);
+    char* bytes = reinterpret_cast<char*>(page->rows.data());
+#ifdef RS_HAVE_PREAD
+    while (length > 0) {
+        ssize_t got = ::pread(fd, bytes, length, static_cast<off_t>(position));
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) {
+            throw std::runtime_error("Failed to read features from " + path);
+        }
+        bytes += got;
+        position += static_cast<std::uint64_t>(got);
+        length -= static_cast<std::size_t>(got);
+    }
+#else
+    std::ifstream file(path, std::ios::binary);
+    file.seekg(static_cast<std::streamoff>(position));
+    if (!file.read(bytes, static_cast<std::streamsize>(length))) {
+        throw std::runtime_error("Failed to read features from " + path);
+    }
+#endif
+    return page;
+}
+
+FeaturePager::Block FeaturePager::pin(std::size_t row) {
+    if (row >= row_count) {
+        throw std::out_of_range("Feature row " + std::to_string(row) + " is not in the file");
+    }
+    std::size_t block = row / options.block_rows;
+    Block handle;
+    handle.row_stride = row_stride;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        auto found = pages.find(block);
+        if (found != pages.end()) {
+            lru.splice(lru.begin(), lru, found->second);
+            ++hits;
+            handle.page = *found->second;
+            return handle;
+        }
+        ++misses;
+    }
+
+    std::shared_ptr<const Page> page = read_page(block);
+    std::lock_guard<std::mutex> guard(lock);
+    auto found = pages.find(block);
+    if (found != pages.end()) {
+        // Another reader missed on it at the same time.
+        handle.page = *found->second;
+        return handle;
+    }
+    lru.push_front(page);
+    pages.emplace(block, lru.begin());
+    while (pages.size() > capacity) {
+        // A pinned page is only dropped from the cache; its readers keep it alive.
+        pages.erase(lru.back()->first / options.block_rows);
+        lru.pop_back();
+        ++evictions;
+    }
+    handle.page = std::move(page);
+    return handle;
+}
+
+// Blocks already cached are skipped, so a scan over a resident working set
+// makes no system calls.
+void FeaturePager::prefetch(std::size_t row) {
+    std::size_t next = row / options.block_rows + 1;
+    std::size_t first = SIZE_MAX, last = 0;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        for (std::size_t block = next; block < next + options.prefetch_blocks; ++block) {
+            if (block * options.block_rows >= row_count) break;
+            if (pages.count(block)) continue;
+            first = std::min(first, block);
+            last = block;
+            ++prefetches;
+        }
+    }
+    if (first == SIZE_MAX) {
+        return;
+    }
+    std::size_t begin = first * options.block_rows;
+    std::size_t rows = std::min((last + 1) * options.block_rows, row_count) - begin;
+#if defined(RS_HAVE_PREAD) && defined(POSIX_FADV_WILLNEED)
+    ::posix_fadvise(fd, static_cast<off_t>(offset + begin * row_stride * sizeof(double)),
+                    static_cast<off_t>(rows * row_stride * sizeof(double)), POSIX_FADV_WILLNEED);
+#else
+    (void)rows;
+#endif
+}
+
+PagerStats FeaturePager::stats() const {
+    std::lock_guard<std::mutex> guard(lock);
+    PagerStats result;
+    result.hits = hits;
+    result.misses = misses;
+    result.evictions = evictions;
+    result.prefetches = prefetches;
+    result.resident_blocks = pages.size();
+    result.capacity_blocks = capacity;
+    result.block_bytes = options.block_rows * row_stride * sizeof(double);
+    return result;
+}
+
+void FeaturePager::reset_stats() {
+    std::lock_guard<std::mutex> guard(lock);
+    hits = misses = evictions = prefetches = 0;
+}
+
+std::ostream& operator<<(std::ostream& os, const PagerStats& stats) {
+    os << "feature pages: hits=" << stats.hits << " misses=" << stats.misses
+       << " hit_rate=" << stats.hit_rate() << " evictions=" << stats.evictions
+       << " prefetches=" << stats.prefetches << " resident=" << stats.resident_blocks << "/"
+       << stats.capacity_blocks << " x " << stats.block_bytes << " bytes\n";
+    return os;
+}
+
+const double* RowCursor::page_in(movie_id id) {
+    bool forward = !block.empty() && id >= block.end();
+    block = pager->pin(id);
+    block_base = block.row(block.begin());
+    block_first = block.begin();
+    block_count = block.end() - block.begin();
+    if (forward) {
+        pager->prefetch(id);
+    }
+    return block.row(id);
+}
+
+void PinnedRows::push_back(movie_id id) {
+    FeaturePager* pager = movies.pager();
+    if (!pager) {
+        rows.push_back(movies.row(id));
+        return;
+    }
+    if (blocks.empty() || !blocks.back().covers(id)) {
+        blocks.push_back(pager->pin(id));
+    }
+    rows.push_back(blocks.back().row(id));
+}
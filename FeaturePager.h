@@ -0,0 +1,181 @@
+#ifndef FEATUREPAGER_H
+#define FEATUREPAGER_H
+
+#include "MovieCatalog.h"
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Feature rows read from disk together.
+#define DEFAULT_PAGE_ROWS 256
+#define DEFAULT_PAGE_CACHE_BYTES (64u << 20)
+
+struct PagerOptions {
+    std::size_t block_rows = DEFAULT_PAGE_ROWS;
+    // Bound on the cached blocks; blocks pinned by readers may exceed it briefly.
+    std::size_t cache_bytes = DEFAULT_PAGE_CACHE_BYTES;
+    // Blocks a sequential reader asks the OS to read ahead of itself.
+    std::size_t prefetch_blocks = 2;
+};
+
+struct PagerStats {
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0; // blocks read from the file
+    std::uint64_t evictions = 0;
+    std::uint64_t prefetches = 0;
+    std::size_t resident_blocks = 0;
+    std::size_t capacity_blocks = 0;
+    std::size_t block_bytes = 0;
+
+    double hit_rate() const {
+        return (hits + misses) ? static_cast<double>(hits) / (hits + misses) : 0.0;
+    }
+};
+
+std::ostream& operator<<(std::ostream& os, const PagerStats& stats);
+
+/**
+ * Serves the feature rows of a snapshot file (see CatalogSnapshot.h) without
+ * loading them: rows are read in blocks of block_rows into a mutex-protected
+ * LRU cache bounded by cache_bytes. A Block handle pins its rows, so they stay
+ * valid after the block is evicted and until the handle is dropped.
+ *
+ * Prefetching is a read-ahead hint to the OS (posix_fadvise), so the miss on
+ * the next block of a scan is served from the page cache, which the kernel
+ * can reclaim under memory pressure, unlike the process heap.
+ */
+class FeaturePager {
+private:
+    struct Page {
+        std::size_t first;
+        std::size_t count;
+        std::vector<double, AlignedAllocator<double, FEATURE_ALIGNMENT>> rows;
+    };
+
+public:
+    /**
+     * Pinned rows [begin(), end()). An empty handle covers no row.
+     */
+    class Block {
+    private:
+        friend class FeaturePager;
+        std::shared_ptr<const Page> page;
+        std::size_t row_stride = 0;
+
+    public:
+        bool empty() const { return !page; }
+        std::size_t begin() const { return page ? page->first : 0; }
+        std::size_t end() const { return page ? page->first + page->count : 0; }
+        bool covers(std::size_t row) const { return page && row - page->first < page->count; }
+        const double* row(std::size_t row) const {
+            return page->rows.data() + (row - page->first) * row_stride;
+        }
+        // Keeps the rows alive, e.g. as a FeatureView owner.
+        std::shared_ptr<const void> owner() const { return page; }
+    };
+
+private:
+    std::string path;
+    int fd = -1;
+    std::uint64_t offset;
+    std::size_t row_stride;
+    std::size_t row_count;
+    PagerOptions options;
+    std::size_t capacity;
+
+    mutable std::mutex lock;
+    std::list<std::shared_ptr<const Page>> lru; // most recent first
+    std::unordered_map<std::size_t, decltype(lru)::iterator> pages;
+    std::uint64_t hits = 0, misses = 0, evictions = 0, prefetches = 0;
+
+    std::shared_ptr<const Page> read_page(std::size_t block) const;
+
+public:
+    /**
+     * @param offset - byte offset of row 0 in the file
+     * @param stride - doubles per (padded) row
+     * @param rows - number of rows in the file
+     * @throws std::runtime_error if the file cannot be opened
+     */
+    FeaturePager(const std::string& path, std::uint64_t offset, std::size_t stride,
+                 std::size_t rows, const PagerOptions& options = PagerOptions());
+    ~FeaturePager();
+
+    FeaturePager(const FeaturePager&) = delete;
+    FeaturePager& operator=(const FeaturePager&) = delete;
+
+    /**
+     * The block holding `row`, read from the file if it is not cached.
+     * @throws std::runtime_error if the read fails
+     */
+    Block pin(std::size_t row);
+
+    // Hints that the prefetch_blocks blocks after the one holding `row` are read next.
+    void prefetch(std::size_t row);
+
+    std::size_t stride() const { return row_stride; }
+    std::size_t size() const { return row_count; }
+    std::size_t block_rows() const { return options.block_rows; }
+
+    PagerStats stats() const;
+    void reset_stats();
+};
+
+/**
+ * Reads the feature rows of a catalog, resident or paged. On a paged catalog
+ * the block of the last row read stays pinned, so a scan over ascending ids
+ * pins every block once, and stepping to the next block prefetches the ones
+ * after it. A row pointer stays valid until the cursor moves to another
+ * block. One cursor per thread.
+ */
+class RowCursor {
+private:
+    const MovieCatalog& movies;
+    FeaturePager* pager;
+    FeaturePager::Block block;
+    // Cached from `block` so that a row inside it is one compare away.
+    const double* block_base = nullptr;
+    std::size_t block_first = 0;
+    std::size_t block_count = 0;
+
+    const double* page_in(movie_id id);
+
+public:
+    explicit RowCursor(const MovieCatalog& movies) : movies(movies), pager(movies.pager()) {}
+
+    const double* row(movie_id id) {
+        if (!pager) return movies.row(id);
+        if (id - block_first < block_count) {
+            return block_base + (id - block_first) * movies.stride();
+        }
+        return page_in(id);
+    }
+};
+
+/**
+ * Rows of a set of movies that all stay valid for the object's lifetime, such
+ * as the rated movies a prediction compares every candidate with. Ids pushed
+ * in ascending order pin each block once.
+ */
+class PinnedRows {
+private:
+    const MovieCatalog& movies;
+    std::vector<const double*> rows;
+    std::vector<FeaturePager::Block> blocks;
+
+public:
+    explicit PinnedRows(const MovieCatalog& movies) : movies(movies) {}
+
+    void push_back(movie_id id);
+    void reserve(std::size_t count) { rows.reserve(count); }
+    const double* operator[](std::size_t i) const { return rows[i]; }
+    std::size_t size() const { return rows.size(); }
+};
+
+#endif // FEATUREPAGER_H
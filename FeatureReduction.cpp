@@ -0,0 +1,198 @@
+#include "FeatureReduction.h"
+#include "FeaturePager.h"
+#include "SimdKernels.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+// Jacobi sweeps stop once the off-diagonal mass is this small relative to the trace.
+#define JACOBI_TOLERANCE 1e-24
+#define JACOBI_MAX_SWEEPS 64
+
+FeatureReduction::FeatureReduction(std::size_t input_dimension, std::size_t output_dimension)
+    : in_dim(input_dimension), in_stride(0), out_dim(output_dimension), retained(0.0) {}
+
+// Sum of x x^T over (a sample of) the catalog rows, dim x dim and symmetric.
+static std::vector<double> second_moment(const MovieCatalog& movies, std::size_t sample_rows) {
+    const std::size_t dim = movies.dimension();
+    const std::size_t rows = std::min(movies.size(), std::max<std::size_t>(sample_rows, 1));
+    std::vector<double> moment(dim * dim, 0.0);
+    RowCursor cursor(movies);
+    for (std::size_t r = 0; r < rows; ++r) {
+        const double* x = cursor.row(static_cast<movie_id>(r * movies.size() / rows));
+        for (std::size_t i = 0; i < dim; ++i) {
+            double* line = moment.data() + i * dim;
+            for (std::size_t j = i; j < dim; ++j) {
+                line[j] += x[i] * x[j];
+            }
+        }
+    }
+    for (std::size_t i = 0; i < dim; ++i) {
+        for (std::size_t j = 0; j < i; ++j) {
+            moment[i * dim + j] = moment[j * dim + i];
+        }
+    }
+    return moment;
+}
+
+// Cyclic Jacobi eigen-decomposition of a symmetric matrix, in place: the
+// diagonal of `a` ends up holding the eigenvalues and the columns of
+// `vectors` the matching unit eigenvectors.
+static void jacobi_eigen(std::vector<double>& a, std::vector<double>& vectors, std::size_t dim) {
+    vectors.assign(dim * dim, 0.0);
+    double trace = 0.0;
+    for (std::size_t i = 0; i < dim; ++i) {
+        vectors[i * dim + i] = 1.0;
+        trace += std::fabs(a[i * dim + i]);
+    }
+    for (int sweep = 0; sweep < JACOBI_MAX_SWEEPS; ++sweep) {
+        double off = 0.0;
+        for (std::size_t p = 0; p < dim; ++p) {
+            for (std::size_t q = p + 1; q < dim; ++q) {
+                off += a[p * dim + q] * a[p * dim + q];
+            }
+        }
+        if (off <= JACOBI_TOLERANCE * trace * trace) {
+            return;
+        }
+        for (std::size_t p = 0; p < dim; ++p) {
+            for (std::size_t q = p + 1; q < dim; ++q) {
+                double apq = a[p * dim + q];
+                if (apq == 0.0) {
+                    continue;
+                }
+                double theta = (a[q * dim + q] - a[p * dim + p]) / (2.0 * apq);
+                double t = (theta >= 0.0 ? 1.0 : -1.0) /
+                           (std::fabs(theta) + std::sqrt(theta * theta + 1.0));
+                double c = 1.0 / std::sqrt(t * t + 1.0);
+                double s = t * c;
+                for (std::size_t k = 0; k < dim; ++k) {
+                    double akp = a[k * dim + p], akq = a[k * dim + q];
+                    a[k * dim + p] = c * akp - s * akq;
+                    a[k * dim + q] = s * akp + c * akq;
+                }
+                for (std::size_t k = 0; k < dim; ++k) {
+                    double apk = a[p * dim + k], aqk = a[q * dim + k];
+                    a[p * dim + k] = c * apk - s * aqk;
+                    a[q * dim + k] = s * apk + c * aqk;
+                }
+                for (std::size_t k = 0; k < dim; ++k) {
+                    double vkp = vectors[k * dim + p], vkq = vectors[k * dim + q];
+                    vectors[k * dim + p] = c * vkp - s * vkq;
+                    vectors[k * dim + q] = s * vkp + c * vkq;
+                }
+            }
+        }
+    }
+}
+
+std::shared_ptr<const FeatureReduction> FeatureReduction::fit(const MovieCatalog& movies,
+                                                              const ReductionOptions& options) {
+    if (movies.empty()) {
+        throw std::invalid_argument("Cannot fit a feature reduction to an empty catalog");
+    }
+    const std::size_t dim = movies.dimension();
+    if (options.dimension >= dim) {
+        throw std::invalid_argument("A reduction to " + std::to_string(options.dimension) +
+                                    " dimensions does not reduce " + std::to_string(dim) +
+                                    " features");
+    }
+    if (options.dimension == 0 && options.method == ReductionMethod::random_projection) {
+        throw std::invalid_argument("A random projection needs a target dimension");
+    }
+    if (options.dimension == 0 &&
+        !(options.explained_variance > 0.0 && options.explained_variance <= 1.0)) {
+        throw std::invalid_argument("Explained variance target must be in (0, 1]");
+    }
+
+    std::vector<double> moment = second_moment(movies, options.sample_rows);
+    double total = 0.0;
+    for (std::size_t i = 0; i < dim; ++i) {
+        total += moment[i * dim + i];
+    }
+
+    std::size_t width = options.dimension;
+    std::vector<double> picked; // width rows of dim
+    if (options.method == ReductionMethod::pca) {
+        std::vector<double> diagonal = moment;
+        std::vector<double> vectors;
+        jacobi_eigen(diagonal, vectors, dim);
+        std::vector<std::size_t> order(dim);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+            return diagonal[a * dim + a] > diagonal[b * dim + b];
+        });
+        if (width == 0) {
+            double kept = 0.0;
+            while (width < dim &&
+                   (width == 0 || kept < options.explained_variance * total)) {
+                kept += diagonal[order[width] * dim + order[width]];
+                ++width;
+            }
+            if (width >= dim) {
+                throw std::invalid_argument("Only the full feature width explains the "
+                                            "requested variance");
+            }
+        }
+        for (std::size_t j = 0; j < width; ++j) {
+            for (std::size_t i = 0; i < dim; ++i) {
+                picked.push_back(vectors[i * dim + order[j]]);
+            }
+        }
+    } else {
+        std::mt19937_64 generator(options.seed);
+        std::normal_distribution<double> gaussian(0.0, 1.0 / std::sqrt(static_cast<double>(width)));
+        for (std::size_t i = 0; i < width * dim; ++i) {
+            picked.push_back(gaussian(generator));
+        }
+    }
+
+    std::shared_ptr<FeatureReduction> reduction(new FeatureReduction(dim, width));
+    reduction->in_stride = movies.stride();
+    reduction->components.assign(width * movies.stride(), 0.0);
+    double kept = 0.0;
+    for (std::size_t j = 0; j < width; ++j) {
+        const double* component = picked.data() + j * dim;
+        std::copy(component, component + dim,
+                  reduction->components.begin() + j * reduction->in_stride);
+        // c^T M c is the squared norm the rows keep along c.
+        for (std::size_t i = 0; i < dim; ++i) {
+            kept += component[i] * dot_product(moment.data() + i * dim, component, dim);
+        }
+    }
+    reduction->retained = total > 0.0 ? kept / total : 1.0;
+    return reduction;
+}
+
+void FeatureReduction::project(const double* features, double* out) const {
+    for (std::size_t j = 0; j < out_dim; ++j) {
+        out[j] = dot_product(components.data() + j * in_stride, features, in_stride);
+    }
+}
+
+std::vector<double> FeatureReduction::project(const std::vector<double>& features) const {
+    if (features.size() != in_dim) {
+        throw std::invalid_argument("Expected " + std::to_string(in_dim) + " features, got " +
+                                    std::to_string(features.size()));
+    }
+    std::vector<double> padded(in_stride, 0.0);
+    std::copy(features.begin(), features.end(), padded.begin());
+    std::vector<double> out(out_dim);
+    project(padded.data(), out.data());
+    return out;
+}
+
+MovieCatalog FeatureReduction::project(const MovieCatalog& movies) const {
+    if (movies.dimension() != in_dim || movies.stride() != in_stride) {
+        throw std::invalid_argument("Catalog width does not match the fitted reduction");
+    }
+    std::vector<double> rows(movies.size() * out_dim);
+    RowCursor cursor(movies);
+    for (movie_id id = 0; id < movies.size(); ++id) {
+        project(cursor.row(id), rows.data() + id * out_dim);
+    }
+    return movies.with_features(out_dim, rows);
+}
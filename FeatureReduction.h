@@ -0,0 +1,76 @@
+#ifndef FEATUREREDUCTION_H
+#define FEATUREREDUCTION_H
+
+#include "MovieCatalog.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Catalog rows the covariance is accumulated over; larger catalogs are subsampled.
+#define DEFAULT_REDUCTION_SAMPLE 20000
+
+enum class ReductionMethod { pca, random_projection };
+
+struct ReductionOptions {
+    ReductionMethod method = ReductionMethod::pca;
+    // Output width. 0 lets PCA pick the smallest width reaching explained_variance.
+    std::size_t dimension = 0;
+    double explained_variance = 0.95;
+    std::uint64_t seed = 1; // random_projection only
+    std::size_t sample_rows = DEFAULT_REDUCTION_SAMPLE;
+};
+
+/**
+ * A linear map from catalog features to fewer dimensions, fitted once at load
+ * time so that every later dot product is shorter.
+ *
+ * PCA keeps the leading eigenvectors of the (uncentered) second moment matrix
+ * of the rows, which best preserves their dot products and so the cosine
+ * scores; the components are found by Jacobi rotations, which is meant for
+ * feature widths in the hundreds. A random projection uses a seeded Gaussian
+ * matrix scaled by 1/sqrt(dimension) and only needs a target width.
+ *
+ * Both are linear, so a preference vector summed over full rows projects to
+ * the preference over the projected rows.
+ */
+class FeatureReduction {
+private:
+    std::size_t in_dim;
+    std::size_t in_stride;
+    std::size_t out_dim;
+    std::vector<double> components; // out_dim rows of in_stride, zero padded
+    double retained;
+
+    FeatureReduction(std::size_t input_dimension, std::size_t output_dimension);
+
+public:
+    /**
+     * Fits a reduction to the catalog's rows.
+     * @throws std::invalid_argument if the catalog is empty, the options ask
+     * for no reduction (a width of at least the feature width, or a variance
+     * target only the full width reaches) or a random projection has no width
+     */
+    static std::shared_ptr<const FeatureReduction> fit(const MovieCatalog& movies,
+                                                       const ReductionOptions& options);
+
+    /**
+     * @param features - input_stride() doubles, zero past input_dimension()
+     * @param out - receives output_dimension() doubles
+     */
+    void project(const double* features, double* out) const;
+    std::vector<double> project(const std::vector<double>& features) const;
+
+    // The same movies and ids with projected rows.
+    MovieCatalog project(const MovieCatalog& movies) const;
+
+    std::size_t input_dimension() const { return in_dim; }
+    std::size_t input_stride() const { return in_stride; }
+    std::size_t output_dimension() const { return out_dim; }
+
+    // Squared norm of the projected rows over that of the fitted rows: the
+    // explained variance for PCA, near 1 (either side) for a random projection.
+    double explained_variance() const { return retained; }
+};
+
+#endif // FEATUREREDUCTION_H
@@ -0,0 +1,62 @@
+#include "MappedFile.h"
+#include <fstream>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define RS_HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string& path) : bytes(nullptr), length(0), mapped(false) {
+#ifdef RS_HAVE_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open file: " + path);
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Failed to open file: " + path);
+    }
+    length = static_cast<std::size_t>(info.st_size);
+    if (length > 0) {
+        void* region = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (region == MAP_FAILED) {
+            ::close(fd);
+            throw std::runtime_error("Failed to map file: " + path);
+        }
+        bytes = static_cast<const char*>(region);
+        mapped = true;
+    }
+    ::close(fd);
+#else
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open file: " + path);
+    }
+    length = static_cast<std::size_t>(file.tellg());
+    buffer.resize(length);
+    file.seekg(0);
+    file.read(buffer.data(), static_cast<std::streamsize>(length));
+    bytes = buffer.data();
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifdef RS_HAVE_MMAP
+    if (mapped) {
+        ::munmap(const_cast<char*>(bytes), length);
+    }
+#endif
+}
+
+void MappedFile::advise_sequential() const {
+#ifdef RS_HAVE_MMAP
+    if (mapped) {
+        ::madvise(const_cast<char*>(bytes), length, MADV_SEQUENTIAL);
+    }
+#endif
+}
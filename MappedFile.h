@@ -0,0 +1,36 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * Read-only view of a whole file. Uses mmap where available and otherwise
+ * reads the file into memory. The data is page aligned in the mmap case.
+ */
+class MappedFile {
+private:
+    const char* bytes;
+    std::size_t length;
+    bool mapped;
+    std::vector<char> buffer;
+
+public:
+    /**
+     * @throws std::runtime_error "Failed to open file: <path>" if it cannot be read
+     */
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return bytes; }
+    std::size_t size() const { return length; }
+
+    // Hints that the file will be read front to back.
+    void advise_sequential() const;
+};
+
+#endif // MAPPEDFILE_H
@@ -1,11 +1,14 @@
 #include "Movie.h"
 #include <iostream>
 
-Movie::Movie(const std::string& name, int year) : name(name), year(year) {
+Movie::Movie(std::string_view name, int year)
+    : title(TitleInterner::instance().intern(name)),
+      name(&TitleInterner::instance().title(title)),
+      year(year) {
 }
 
-std::string Movie::get_name() const {
-    return name;
+const std::string& Movie::get_name() const {
+    return *name;
 }
 
 int Movie::get_year() const {
@@ -16,7 +19,10 @@ bool Movie::operator<(const Movie& other) const {
     if (year != other.year) {
         return year < other.year;
     }
-    return name < other.name;
+    if (title == other.title) {
+        return false;
+    }
+    return *name < *other.name;
 }
 
 std::ostream& operator<<(std::ostream& os, const Movie& movie) {
@@ -28,8 +34,9 @@ std::size_t sp_movie_hash(const sp_movie& movie) {
     if (!movie) {
         throw std::invalid_argument("Nullptr passed to sp_movie_hash");
     }
+    // Titles are interned, so the handle stands in for the string.
     std::size_t res = HASH_START;
-    res = res * RES_MULT + std::hash<std::string>()(movie->get_name());
+    res = res * RES_MULT + std::hash<title_id>()(movie->get_title_id());
     res = res * RES_MULT + std::hash<int>()(movie->get_year());
     return res;
 }
@@ -38,5 +45,5 @@ bool sp_movie_equal(const sp_movie& m1, const sp_movie& m2) {
     if (!m1 || !m2) {
         return false;
     }
-    return !(*m1 < *m2) && !(*m2 < *m1);
+    return m1->get_title_id() == m2->get_title_id() && m1->get_year() == m2->get_year();
 }
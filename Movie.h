@@ -6,6 +6,7 @@
 #include <memory>
 #include <string>
 #include <functional>
+#include "TitleInterner.h"
 
 #define HASH_START 17
 #define RES_MULT 31
@@ -22,15 +23,19 @@ bool sp_movie_equal(const sp_movie& m1, const sp_movie& m2);
 
 class Movie {
 private:
-    std::string name;
+    title_id title;
+    const std::string* name; // owned by the TitleInterner
     int year;
 
 public:
-    Movie(const std::string& name, int year);
+    Movie(std::string_view name, int year);
 
-    std::string get_name() const;
+    const std::string& get_name() const;
     int get_year() const;
 
+    // Interned handle of the title: equal titles have equal handles.
+    title_id get_title_id() const { return title; }
+
     bool operator<(const Movie& other) const;
 
     friend std::ostream& operator<<(std::ostream& os, const Movie& movie);
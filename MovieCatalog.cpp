@@ -0,0 +1,285 @@
+#include "MovieCatalog.h"
+#include "FeaturePager.h"
+#include "SimdKernels.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#define DOUBLES_PER_LINE (FEATURE_ALIGNMENT / sizeof(double))
+
+/**
+ * Rows shared by a catalog and its copies. Slots [0, used) are written; every
+ * copy reads a prefix of them, so the writer can fill slot `used` while
+ * readers are active.
+ */
+class MovieCatalog::Storage {
+public:
+    std::size_t capacity = 0;
+    std::size_t used = 0;
+    std::vector<double, AlignedAllocator<double, FEATURE_ALIGNMENT>> features;
+    std::vector<double> norms;
+    std::vector<sp_movie> movies;
+
+    // Point into the vectors above, or into external memory kept alive by `external`.
+    const double* feature_base = nullptr;
+    const double* norm_base = nullptr;
+    std::shared_ptr<const void> external;
+    std::shared_ptr<FeaturePager> pager;
+};
+
+/**
+ * Open-addressing (name, year) -> id table with a single writer and lock-free
+ * readers. A slot's key is written before its id is released, so a reader that
+ * sees an id also sees its key. Readers ignore ids past their own catalog size.
+ */
+class MovieCatalog::IdTable {
+private:
+    struct Slot {
+        std::atomic<std::uint64_t> key{0};
+        std::atomic<movie_id> id{INVALID_MOVIE_ID};
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    std::size_t mask;
+    std::size_t used = 0;
+
+    static std::size_t slot_of(std::uint64_t key) {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        return static_cast<std::size_t>(key);
+    }
+
+public:
+    explicit IdTable(std::size_t entries) {
+        std::size_t capacity = 16;
+        while (capacity < entries * 2) capacity *= 2;
+        slots.reset(new Slot[capacity]);
+        mask = capacity - 1;
+    }
+
+    // Keeps the load factor at or below one half.
+    bool full() const { return (used + 1) * 2 > mask + 1; }
+    std::size_t entries() const { return used; }
+
+    void insert(std::uint64_t key, movie_id id) {
+        std::size_t i = slot_of(key) & mask;
+        while (slots[i].id.load(std::memory_order_relaxed) != INVALID_MOVIE_ID) {
+            i = (i + 1) & mask;
+        }
+        slots[i].key.store(key, std::memory_order_relaxed);
+        slots[i].id.store(id, std::memory_order_release);
+        ++used;
+    }
+
+    movie_id find(std::uint64_t key) const {
+        for (std::size_t i = slot_of(key) & mask;; i = (i + 1) & mask) {
+            movie_id id = slots[i].id.load(std::memory_order_acquire);
+            if (id == INVALID_MOVIE_ID || slots[i].key.load(std::memory_order_relaxed) == key) {
+                return id;
+            }
+        }
+    }
+};
+
+MovieCatalog::MovieCatalog()
+    : dim(0), row_stride(0), count(0),
+      feature_base(nullptr), norm_base(nullptr), movie_base(nullptr), page_source(nullptr) {}
+
+movie_id MovieCatalog::add(std::string_view name, int year,
+                           const std::vector<double>& movie_features) {
+    if (page_source) {
+        throw std::logic_error("Movies cannot be added to a paged catalog");
+    }
+    if (count == 0) {
+        dim = movie_features.size();
+        row_stride = (dim + DOUBLES_PER_LINE - 1) / DOUBLES_PER_LINE * DOUBLES_PER_LINE;
+    } else if (movie_features.size() != dim) {
+        throw std::runtime_error("Feature size mismatch for " + std::string(name));
+    }
+    if (count >= INVALID_MOVIE_ID) {
+        throw std::length_error("Movie catalog is full");
+    }
+
+    reserve_slot();
+    double* new_row = storage->features.data() + count * row_stride;
+    // Padding stays zero so kernels may run over the full stride.
+    std::copy(movie_features.begin(), movie_features.end(), new_row);
+    storage->norms[count] = std::sqrt(dot_product(new_row, new_row, row_stride));
+
+    movie_id id = static_cast<movie_id>(count);
+    register_movie(name, year);
+    return id;
+}
+
+// Makes slot `count` writable without touching any row another copy can see.
+// A new buffer is needed when the current one is full, external, or has
+// already been appended to by a copy that diverged from this one.
+void MovieCatalog::reserve_slot() {
+    bool diverged = storage && storage->used != count;
+    if (storage && !diverged && !storage->external && count < storage->capacity) {
+        return;
+    }
+
+    auto next = std::make_shared<Storage>();
+    next->capacity = std::max<std::size_t>(INITIAL_CATALOG_CAPACITY, count * 2);
+    next->used = count;
+    next->features.assign(next->capacity * row_stride, 0.0);
+    next->norms.assign(next->capacity, 0.0);
+    next->movies.resize(next->capacity);
+    std::copy(feature_base, feature_base + count * row_stride, next->features.begin());
+    std::copy(norm_base, norm_base + count, next->norms.begin());
+    std::copy(movie_base, movie_base + count, next->movies.begin());
+    next->feature_base = next->features.data();
+    next->norm_base = next->norms.data();
+    set_storage(std::move(next));
+
+    if (diverged) {
+        // The shared table holds the other copy's newer ids.
+        ids.reset();
+    }
+}
+
+void MovieCatalog::set_storage(std::shared_ptr<Storage> next) {
+    storage = std::move(next);
+    feature_base = storage->feature_base;
+    norm_base = storage->norm_base;
+    movie_base = storage->movies.data();
+    page_source = storage->pager.get();
+}
+
+// Fills slot `count` with the movie and publishes it in the id table.
+void MovieCatalog::register_movie(std::string_view name, int year) {
+    sp_movie movie = std::make_shared<Movie>(name, year);
+    std::uint64_t key = movie_key(movie->get_title_id(), year);
+
+    if (!ids || ids->full()) {
+        auto table = std::make_shared<IdTable>(std::max<std::size_t>(count + 1, ids ? ids->entries() * 2 : 0));
+        for (movie_id id = 0; id < count; ++id) {
+            table->insert(movie_key(movie_base[id]->get_title_id(), movie_base[id]->get_year()), id);
+        }
+        ids = std::move(table);
+    }
+
+    storage->movies[count] = std::move(movie);
+    ids->insert(key, static_cast<movie_id>(count));
+    ++count;
+    storage->used = count;
+}
+
+void MovieCatalog::attach_external(std::size_t dimension, std::size_t stride,
+                                   std::size_t rows_count, const double* rows,
+                                   const double* row_norms, std::shared_ptr<const void> owner) {
+    if (count != 0) {
+        throw std::logic_error("External storage can only be attached to an empty catalog");
+    }
+    dim = dimension;
+    row_stride = stride;
+
+    auto next = std::make_shared<Storage>();
+    next->capacity = rows_count;
+    next->movies.resize(rows_count);
+    next->feature_base = rows;
+    next->norm_base = row_norms;
+    next->external = std::move(owner);
+    set_storage(std::move(next));
+    ids.reset();
+}
+
+void MovieCatalog::attach_paged(std::size_t dimension, std::vector<double> row_norms,
+                                std::shared_ptr<FeaturePager> pager) {
+    if (count != 0) {
+        throw std::logic_error("A pager can only be attached to an empty catalog");
+    }
+    if (!pager || pager->size() != row_norms.size()) {
+        throw std::invalid_argument("Expected a pager over " + std::to_string(row_norms.size()) +
+                                    " rows");
+    }
+    dim = dimension;
+    row_stride = pager->stride();
+
+    auto next = std::make_shared<Storage>();
+    next->capacity = row_norms.size();
+    next->movies.resize(row_norms.size());
+    next->norms = std::move(row_norms);
+    next->norm_base = next->norms.data();
+    next->external = pager;
+    next->pager = std::move(pager);
+    set_storage(std::move(next));
+    ids.reset();
+}
+
+movie_id MovieCatalog::add_external(std::string_view name, int year) {
+    if (!is_external()) {
+        throw std::logic_error("No external storage attached");
+    }
+    if (count >= storage->capacity) {
+        throw std::out_of_range("More titles than external rows");
+    }
+    movie_id id = static_cast<movie_id>(count);
+    register_movie(name, year);
+    return id;
+}
+
+bool MovieCatalog::is_external() const {
+    return storage && storage->external;
+}
+
+MovieCatalog MovieCatalog::with_features(std::size_t dimension,
+                                         const std::vector<double>& rows) const {
+    if (rows.size() != count * dimension) {
+        throw std::invalid_argument("Expected " + std::to_string(count) + " feature rows");
+    }
+    MovieCatalog result;
+    result.dim = dimension;
+    result.row_stride = (dimension + DOUBLES_PER_LINE - 1) / DOUBLES_PER_LINE * DOUBLES_PER_LINE;
+    result.count = count;
+
+    auto next = std::make_shared<Storage>();
+    next->capacity = std::max<std::size_t>(INITIAL_CATALOG_CAPACITY, count);
+    next->used = count;
+    next->features.assign(next->capacity * result.row_stride, 0.0);
+    next->norms.assign(next->capacity, 0.0);
+    next->movies.resize(next->capacity);
+    for (std::size_t id = 0; id < count; ++id) {
+        double* row = next->features.data() + id * result.row_stride;
+        std::copy(rows.begin() + id * dimension, rows.begin() + (id + 1) * dimension, row);
+        next->norms[id] = std::sqrt(dot_product(row, row, result.row_stride));
+    }
+    std::copy(movie_base, movie_base + count, next->movies.begin());
+    next->feature_base = next->features.data();
+    next->norm_base = next->norms.data();
+    result.set_storage(std::move(next));
+
+    result.ids = std::make_shared<IdTable>(count);
+    for (movie_id id = 0; id < count; ++id) {
+        result.ids->insert(movie_key(movie_base[id]->get_title_id(), movie_base[id]->get_year()),
+                           id);
+    }
+    return result;
+}
+
+FeatureView MovieCatalog::features_of(movie_id id) const {
+    if (page_source) {
+        FeaturePager::Block block = page_source->pin(id);
+        return FeatureView(block.row(id), dim, block.owner());
+    }
+    return FeatureView(row(id), dim, storage);
+}
+
+movie_id MovieCatalog::find(std::string_view name, int year) const {
+    title_id title = TitleInterner::instance().find(name);
+    if (title == INVALID_TITLE_ID || !ids) {
+        return INVALID_MOVIE_ID;
+    }
+    movie_id id = ids->find(movie_key(title, year));
+    return (id < count) ? id : INVALID_MOVIE_ID;
+}
+
+movie_id MovieCatalog::find(const sp_movie& movie) const {
+    if (!movie || !ids) {
+        return INVALID_MOVIE_ID;
+    }
+    movie_id id = ids->find(movie_key(movie->get_title_id(), movie->get_year()));
+    return (id < count) ? id : INVALID_MOVIE_ID;
+}
@@ -0,0 +1,152 @@
+#ifndef MOVIECATALOG_H
+#define MOVIECATALOG_H
+
+#include "Movie.h"
+#include "AlignedAllocator.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Feature rows start on a cache line and are padded to a whole number of lines.
+#define FEATURE_ALIGNMENT 64
+
+// Rows reserved by the first add(); capacity doubles from there.
+#define INITIAL_CATALOG_CAPACITY 64
+
+class FeaturePager;
+
+typedef std::uint32_t movie_id;
+const movie_id INVALID_MOVIE_ID = std::numeric_limits<movie_id>::max();
+
+/**
+ * Read-only view over the features of a single movie in a MovieCatalog.
+ * The view keeps the catalog storage it points into alive.
+ */
+class FeatureView {
+private:
+    const double* ptr;
+    std::size_t len;
+    std::shared_ptr<const void> owner;
+
+public:
+    FeatureView() : ptr(nullptr), len(0) {}
+    FeatureView(const double* ptr, std::size_t len, std::shared_ptr<const void> owner = nullptr)
+        : ptr(ptr), len(len), owner(std::move(owner)) {}
+
+    const double* data() const { return ptr; }
+    std::size_t size() const { return len; }
+    bool empty() const { return len == 0; }
+    const double* begin() const { return ptr; }
+    const double* end() const { return ptr + len; }
+    double operator[](std::size_t i) const { return ptr[i]; }
+
+    std::vector<double> to_vector() const { return std::vector<double>(ptr, ptr + len); }
+};
+
+/**
+ * Dense movie store: every movie gets a consecutive movie_id in insertion
+ * order and its features live in one row-major, aligned buffer. A side table
+ * maps (name, year) to the id.
+ *
+ * A MovieCatalog is a cheap, immutable-looking handle: copying it shares the
+ * storage, and a copy only ever sees the movies that existed when it was made.
+ * add() appends past the end of every copy, so readers of older copies are
+ * never disturbed and need no locking. add() itself must not run concurrently
+ * with another add() on a copy sharing the same storage.
+ */
+class MovieCatalog {
+private:
+    class Storage;
+    class IdTable;
+
+    std::size_t dim;
+    std::size_t row_stride;
+    std::size_t count;
+    std::shared_ptr<Storage> storage;
+    std::shared_ptr<IdTable> ids;
+
+    // Cached from `storage` so that reads are a single indirection.
+    const double* feature_base;
+    const double* norm_base;
+    const sp_movie* movie_base;
+    FeaturePager* page_source;
+
+    static std::uint64_t movie_key(title_id title, int year) {
+        return (static_cast<std::uint64_t>(title) << 32) | static_cast<std::uint32_t>(year);
+    }
+
+    void reserve_slot();
+    void set_storage(std::shared_ptr<Storage> next);
+    void register_movie(std::string_view name, int year);
+
+public:
+    MovieCatalog();
+
+    /**
+     * Appends a movie that is not in the catalog yet.
+     * @return the id of the new movie
+     * @throws std::logic_error if the catalog is paged
+     */
+    movie_id add(std::string_view name, int year, const std::vector<double>& movie_features);
+
+    /**
+     * @return the id of the movie, or INVALID_MOVIE_ID if it is not in the catalog.
+     * Does not allocate.
+     */
+    movie_id find(std::string_view name, int year) const;
+    movie_id find(const sp_movie& movie) const;
+
+    /**
+     * Serves features and norms from external memory (e.g. a mapped snapshot)
+     * instead of copying them. The `rows` titles are then registered in id
+     * order with add_external. The first add() copies the rows into owned storage.
+     * @param owner - keeps the external memory alive
+     */
+    void attach_external(std::size_t dimension, std::size_t stride, std::size_t rows_count,
+                         const double* rows, const double* row_norms,
+                         std::shared_ptr<const void> owner);
+    movie_id add_external(std::string_view name, int year);
+    bool is_external() const;
+
+    /**
+     * Keeps only the norms in memory and reads feature rows through `pager`
+     * (see FeaturePager). The titles are then registered with add_external.
+     * A paged catalog is read-only. Its rows are read through RowCursor,
+     * PinnedRows or features_of(); row() must not be used.
+     */
+    void attach_paged(std::size_t dimension, std::vector<double> row_norms,
+                      std::shared_ptr<FeaturePager> pager);
+    bool is_paged() const { return page_source != nullptr; }
+    FeaturePager* pager() const { return page_source; }
+
+    /**
+     * A catalog with the same movies (the same sp_movie objects) and ids whose
+     * features are `rows`, size() rows of `dimension` doubles back to back.
+     * It owns its storage and shares nothing else with this one.
+     */
+    MovieCatalog with_features(std::size_t dimension, const std::vector<double>& rows) const;
+
+    const sp_movie& movie(movie_id id) const { return movie_base[id]; }
+    FeatureView features_of(movie_id id) const;
+
+    // Pointer to the (padded) feature row of the movie; resident catalogs only.
+    const double* row(movie_id id) const { return feature_base + id * row_stride; }
+
+    // Euclidean norm of the movie's features, computed once when it is added.
+    double norm(movie_id id) const { return norm_base[id]; }
+
+    std::size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    std::size_t dimension() const { return dim; }
+    std::size_t stride() const { return row_stride; }
+
+    const sp_movie* begin() const { return movie_base; }
+    const sp_movie* end() const { return movie_base + count; }
+};
+
+#endif // MOVIECATALOG_H
@@ -0,0 +1,98 @@
+#include "QuantizationReport.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+
+typedef std::chrono::steady_clock rs_clock;
+
+static double micros_since(rs_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(rs_clock::now() - start).count();
+}
+
+// Content lists and predictions of every user under the current storage.
+struct ScoreSample {
+    std::vector<std::vector<scored_movie>> content;
+    std::vector<double> predictions;
+    double content_micros = 0.0;
+};
+
+static ScoreSample sample_scores(const RecommendationSystem& rs, const std::vector<User>& users,
+                                 int n, int k, std::size_t targets_per_user) {
+    ScoreSample sample;
+    rs_clock::time_point start = rs_clock::now();
+    for (const User& user : users) {
+        sample.content.push_back(rs.recommend_top_n_by_content_exact(user, n));
+    }
+    sample.content_micros = users.empty() ? 0.0 : micros_since(start) / users.size();
+
+    MovieCatalog movies = rs.get_movies();
+    std::size_t targets = std::min(targets_per_user, movies.size());
+    for (const User& user : users) {
+        for (std::size_t t = 0; t < targets; ++t) {
+            movie_id target = static_cast<movie_id>(t * movies.size() / targets);
+            sample.predictions.push_back(rs.predict_movie_score(user, movies.movie(target), k));
+        }
+    }
+    return sample;
+}
+
+QuantizationReport measure_quantization_error(RecommendationSystem& rs,
+                                              const std::vector<User>& users,
+                                              FeatureStorage storage, int n, int k,
+                                              std::size_t targets_per_user) {
+    rs.set_feature_storage(FeatureStorage::float64);
+    ScoreSample exact = sample_scores(rs, users, n, k, targets_per_user);
+    rs.set_feature_storage(storage);
+    ScoreSample reduced = sample_scores(rs, users, n, k, targets_per_user);
+
+    MovieCatalog movies = rs.get_movies();
+    std::shared_ptr<const QuantizedFeatures> quantized = rs.get_quantized_features();
+    QuantizationReport report{storage, users.size(),
+                              quantized ? quantized->memory_usage() : 0,
+                              movies.size() * movies.stride() * sizeof(double),
+                              0.0, 0.0, 0.0, exact.content_micros, reduced.content_micros};
+
+    std::size_t compared_users = 0;
+    for (std::size_t u = 0; u < users.size(); ++u) {
+        const auto& a = exact.content[u];
+        const auto& b = reduced.content[u];
+        for (std::size_t r = 0; r < std::min(a.size(), b.size()); ++r) {
+            report.max_content_deviation =
+                std::max(report.max_content_deviation, std::fabs(a[r].second - b[r].second));
+        }
+        if (!a.empty()) {
+            report.top1_agreement += (!b.empty() && a.front().first == b.front().first);
+            compared_users++;
+        }
+    }
+    if (compared_users > 0) {
+        report.top1_agreement /= compared_users;
+    }
+    for (std::size_t i = 0; i < exact.predictions.size(); ++i) {
+        report.max_predict_deviation = std::max(
+            report.max_predict_deviation, std::fabs(exact.predictions[i] - reduced.predictions[i]));
+    }
+    return report;
+}
+
+static const char* storage_name(FeatureStorage storage) {
+    switch (storage) {
+        case FeatureStorage::float32: return "float32";
+        case FeatureStorage::uint8: return "uint8";
+        default: return "float64";
+    }
+}
+
+std::ostream& operator<<(std::ostream& os, const QuantizationReport& report) {
+    os << storage_name(report.storage) << " features over " << report.users << " users: "
+       << report.feature_bytes << " bytes (double rows " << report.double_bytes << ")\n";
+    os << std::scientific << std::setprecision(3)
+       << "max content score deviation " << report.max_content_deviation << "\n"
+       << "max predicted score deviation " << report.max_predict_deviation << "\n"
+       << std::fixed << std::setprecision(4)
+       << "top-1 agreement " << report.top1_agreement << "\n"
+       << std::setprecision(1) << "content us/query " << report.double_micros << " -> "
+       << report.quantized_micros << "\n";
+    return os;
+}
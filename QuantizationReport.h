@@ -0,0 +1,37 @@
+#ifndef QUANTIZATIONREPORT_H
+#define QUANTIZATIONREPORT_H
+
+#include "RecommendationSystem.h"
+#include "User.h"
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+struct QuantizationReport {
+    FeatureStorage storage;
+    std::size_t users;
+    std::size_t feature_bytes;   // the reduced copy
+    std::size_t double_bytes;    // the double rows it stands in for
+    double max_content_deviation; // largest |score difference| at equal rank of the top n
+    double max_predict_deviation; // largest |predict_movie_score difference|
+    double top1_agreement;        // fraction of users whose best content movie is unchanged
+    double double_micros;         // mean content query latency in double
+    double quantized_micros;      // mean content query latency on the reduced copy
+};
+
+/**
+ * Runs content recommendations and predictions for every user in double and
+ * then with `storage`, and reports how far the scores moved. Leaves rs with
+ * `storage` selected; meant to be run before the system starts serving.
+ * @param n - length of the content lists compared
+ * @param k - k of the compared predictions
+ * @param targets_per_user - movies predicted per user, spread over the catalog
+ */
+QuantizationReport measure_quantization_error(RecommendationSystem& rs,
+                                              const std::vector<User>& users,
+                                              FeatureStorage storage, int n = 10, int k = 5,
+                                              std::size_t targets_per_user = 10);
+
+std::ostream& operator<<(std::ostream& os, const QuantizationReport& report);
+
+#endif // QUANTIZATIONREPORT_H
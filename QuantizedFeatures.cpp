@@ -0,0 +1,91 @@
+#include "QuantizedFeatures.h"
+#include "FeaturePager.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+QuantizedFeatures::QuantizedFeatures()
+    : mode(FeatureStorage::float32), dim(0), row_stride(0), rows(0), offset(0.0), step(1.0),
+      kernels(quantized_kernels()) {}
+
+void QuantizedFeatures::build(const MovieCatalog& movies, FeatureStorage storage) {
+    if (storage == FeatureStorage::float64) {
+        throw std::invalid_argument("float64 features are the catalog itself");
+    }
+    mode = storage;
+    dim = movies.dimension();
+    rows = movies.size();
+    std::size_t element_bytes = (storage == FeatureStorage::uint8) ? 1 : sizeof(float);
+    std::size_t per_line = QUANTIZED_ROW_BYTES / element_bytes;
+    row_stride = std::max<std::size_t>(1, (dim + per_line - 1) / per_line) * per_line;
+    floats.clear();
+    codes.clear();
+    code_sums.clear();
+
+    if (storage == FeatureStorage::float32) {
+        floats.assign(rows * row_stride, 0.0f);
+        RowCursor cursor(movies);
+        for (movie_id id = 0; id < rows; ++id) {
+            const double* row = cursor.row(id);
+            std::transform(row, row + dim, floats.begin() + id * row_stride,
+                           [](double value) { return static_cast<float>(value); });
+        }
+        return;
+    }
+
+    double low = 0.0, high = 0.0;
+    RowCursor cursor(movies);
+    for (movie_id id = 0; id < rows; ++id) {
+        const double* row = cursor.row(id);
+        auto [row_low, row_high] = std::minmax_element(row, row + dim);
+        low = (id == 0) ? *row_low : std::min(low, *row_low);
+        high = (id == 0) ? *row_high : std::max(high, *row_high);
+    }
+    offset = low;
+    step = (high > low) ? (high - low) / 255.0 : 1.0;
+
+    codes.assign(rows * row_stride, 0);
+    code_sums.assign(rows, 0);
+    for (movie_id id = 0; id < rows; ++id) {
+        const double* row = cursor.row(id);
+        std::uint8_t* target = codes.data() + id * row_stride;
+        for (std::size_t i = 0; i < dim; ++i) {
+            double code = std::round((row[i] - offset) / step);
+            target[i] = static_cast<std::uint8_t>(std::clamp(code, 0.0, 255.0));
+            code_sums[id] += target[i];
+        }
+    }
+}
+
+void QuantizedFeatures::prepare(const double* query, Query& prepared) const {
+    prepared.values.assign(row_stride, 0.0f);
+    prepared.sum = 0.0;
+    for (std::size_t i = 0; i < dim; ++i) {
+        prepared.values[i] = static_cast<float>(query[i]);
+        prepared.sum += query[i];
+    }
+}
+
+// With x = offset + step * code:
+//   q . x = offset * sum(q) + step * (q . code)
+//   x . y = dim * offset^2 + offset * step * (sum(cx) + sum(cy)) + step^2 * (cx . cy)
+double QuantizedFeatures::dot(const Query& query, movie_id id) const {
+    if (mode == FeatureStorage::float32) {
+        return kernels.f32(query.values.data(), float_row(id), row_stride);
+    }
+    return offset * query.sum + step * kernels.f32_u8(query.values.data(), code_row(id), row_stride);
+}
+
+double QuantizedFeatures::dot(movie_id a, movie_id b) const {
+    if (mode == FeatureStorage::float32) {
+        return kernels.f32(float_row(a), float_row(b), row_stride);
+    }
+    double code_dot = static_cast<double>(kernels.u8(code_row(a), code_row(b), row_stride));
+    return dim * offset * offset + offset * step * static_cast<double>(code_sums[a] + code_sums[b]) +
+           step * step * code_dot;
+}
+
+std::size_t QuantizedFeatures::memory_usage() const {
+    return floats.capacity() * sizeof(float) + codes.capacity() +
+           code_sums.capacity() * sizeof(std::uint64_t);
+}
@@ -0,0 +1,77 @@
+#ifndef QUANTIZEDFEATURES_H
+#define QUANTIZEDFEATURES_H
+
+#include "MovieCatalog.h"
+#include "SimdKernels.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Quantized rows are padded to a whole number of AVX2 registers.
+#define QUANTIZED_ROW_BYTES 32
+
+// Precision of the copy of the features that content and CF scans read.
+enum class FeatureStorage { float64, float32, uint8 };
+
+/**
+ * Reduced-precision copy of a catalog's feature rows, used to cut memory
+ * traffic in the similarity scans. The double rows stay canonical: norms,
+ * snapshots and the neighbor index still use them, and only dot products are
+ * taken from this copy before the cosine is finished in double.
+ *
+ * uint8 rows store every feature as offset + step * code, with offset and
+ * step chosen from the catalog's value range ([1, 10] for loaded catalogs, a
+ * step of 9/255). Movies added after build() are not covered.
+ */
+class QuantizedFeatures {
+public:
+    /**
+     * A double query vector converted once for repeated dot() calls.
+     */
+    class Query {
+    private:
+        friend class QuantizedFeatures;
+        std::vector<float, AlignedAllocator<float, FEATURE_ALIGNMENT>> values;
+        double sum = 0.0;
+    };
+
+private:
+    FeatureStorage mode;
+    std::size_t dim;
+    std::size_t row_stride; // in elements
+    std::size_t rows;
+    double offset;
+    double step;
+    std::vector<float, AlignedAllocator<float, FEATURE_ALIGNMENT>> floats;
+    std::vector<std::uint8_t, AlignedAllocator<std::uint8_t, FEATURE_ALIGNMENT>> codes;
+    std::vector<std::uint64_t> code_sums; // per uint8 row
+    QuantizedKernels kernels;
+
+    const float* float_row(movie_id id) const { return floats.data() + id * row_stride; }
+    const std::uint8_t* code_row(movie_id id) const { return codes.data() + id * row_stride; }
+
+public:
+    QuantizedFeatures();
+
+    /**
+     * @param storage - float32 or uint8
+     */
+    void build(const MovieCatalog& movies, FeatureStorage storage);
+
+    void prepare(const double* query, Query& prepared) const;
+
+    // Approximate dot product of a prepared query with a covered movie's features.
+    double dot(const Query& query, movie_id id) const;
+
+    // Approximate dot product of two covered movies' features.
+    double dot(movie_id a, movie_id b) const;
+
+    FeatureStorage storage() const { return mode; }
+    // Movies with ids from here on were added after the build.
+    movie_id indexed_count() const { return static_cast<movie_id>(rows); }
+    // Largest rounding error of a single uint8 feature is step / 2.
+    double quantization_step() const { return step; }
+    std::size_t memory_usage() const;
+};
+
+#endif // QUANTIZEDFEATURES_H
@@ -0,0 +1,197 @@
+#include "RatingsMatrix.h"
+#include "CatalogSnapshot.h"
+#include "SnapshotWriter.h"
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+void RatingsMatrix::write(const std::string& file_path, const std::vector<MatrixMovie>& movies,
+                          const std::vector<std::string>& users,
+                          const std::vector<std::uint64_t>& row_offsets,
+                          const std::vector<RatingEntry>& row_entries) {
+    if (row_offsets.size() != users.size() + 1 || row_offsets.back() != row_entries.size()) {
+        throw std::invalid_argument("Row offsets do not match the users and entries");
+    }
+    std::ofstream file(file_path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open file: " + file_path);
+    }
+
+    // Columns are filled by a counting sort of the rows; users stay in order.
+    std::vector<std::uint64_t> column_offsets(movies.size() + 1, 0);
+    for (const RatingEntry& entry : row_entries) {
+        if (entry.index >= movies.size()) {
+            throw std::invalid_argument("Rating column out of range");
+        }
+        ++column_offsets[entry.index + 1];
+    }
+    for (std::size_t m = 0; m < movies.size(); ++m) {
+        column_offsets[m + 1] += column_offsets[m];
+    }
+    std::vector<RatingEntry> column_entries(row_entries.size());
+    std::vector<std::uint64_t> fill(column_offsets.begin(), column_offsets.end() - 1);
+    for (std::size_t u = 0; u < users.size(); ++u) {
+        for (std::uint64_t i = row_offsets[u]; i < row_offsets[u + 1]; ++i) {
+            column_entries[fill[row_entries[i].index]++] =
+                RatingEntry{static_cast<std::uint32_t>(u), row_entries[i].rating};
+        }
+    }
+
+    RatingsHeader header{};
+    std::memcpy(header.magic, RATINGS_MAGIC, sizeof(RATINGS_MAGIC));
+    header.version = RATINGS_VERSION;
+    header.header_size = sizeof(RatingsHeader);
+    header.users = users.size();
+    header.movies = movies.size();
+    header.entries = row_entries.size();
+    header.dictionary_offset = sizeof(RatingsHeader);
+
+    // Header goes in last, once the offsets and checksum are known.
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    std::uint64_t checksum = FNV_OFFSET_BASIS;
+    std::size_t offset = sizeof(header);
+    for (const MatrixMovie& movie : movies) {
+        std::int32_t year = movie.year;
+        std::uint32_t name_length = static_cast<std::uint32_t>(movie.name.size());
+        write_bytes(file, &year, sizeof(year), checksum);
+        write_bytes(file, &name_length, sizeof(name_length), checksum);
+        write_bytes(file, movie.name.data(), movie.name.size(), checksum);
+        offset += sizeof(year) + sizeof(name_length) + movie.name.size();
+    }
+    header.names_offset = offset;
+    for (const std::string& name : users) {
+        std::uint32_t name_length = static_cast<std::uint32_t>(name.size());
+        write_bytes(file, &name_length, sizeof(name_length), checksum);
+        write_bytes(file, name.data(), name.size(), checksum);
+        offset += sizeof(name_length) + name.size();
+    }
+
+    const char padding[sizeof(std::uint64_t)] = {};
+    header.row_offsets_offset = align_up(offset, sizeof(std::uint64_t));
+    write_bytes(file, padding, header.row_offsets_offset - offset, checksum);
+    write_bytes(file, row_offsets.data(), row_offsets.size() * sizeof(std::uint64_t), checksum);
+    header.row_entries_offset = header.row_offsets_offset + row_offsets.size() * sizeof(std::uint64_t);
+    write_bytes(file, row_entries.data(), row_entries.size() * sizeof(RatingEntry), checksum);
+    header.column_offsets_offset = header.row_entries_offset + row_entries.size() * sizeof(RatingEntry);
+    write_bytes(file, column_offsets.data(), column_offsets.size() * sizeof(std::uint64_t), checksum);
+    header.column_entries_offset =
+        header.column_offsets_offset + column_offsets.size() * sizeof(std::uint64_t);
+    write_bytes(file, column_entries.data(), column_entries.size() * sizeof(RatingEntry), checksum);
+    header.file_size = header.column_entries_offset + column_entries.size() * sizeof(RatingEntry);
+    header.checksum = checksum;
+
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (!file) {
+        throw std::runtime_error("Failed to write ratings matrix: " + file_path);
+    }
+}
+
+// Offsets must start at 0, never decrease and end at the entry count.
+static bool valid_offsets(const std::uint64_t* offsets, std::size_t count, std::uint64_t entries) {
+    if (offsets[0] != 0 || offsets[count] != entries) return false;
+    for (std::size_t i = 0; i < count; ++i) {
+        if (offsets[i] > offsets[i + 1]) return false;
+    }
+    return true;
+}
+
+// Every entry must index a movie (row entries) or a user (column entries).
+static bool valid_indexes(const RatingEntry* entries, std::uint64_t count, std::uint64_t limit) {
+    for (std::uint64_t i = 0; i < count; ++i) {
+        if (entries[i].index >= limit) return false;
+    }
+    return true;
+}
+
+RatingsMatrix::RatingsMatrix(const std::string& file_path, bool verify_checksum)
+    : mapping(std::make_shared<MappedFile>(file_path)) {
+    const char* data = mapping->data();
+    std::size_t size = mapping->size();
+    if (size < sizeof(header)) {
+        throw std::runtime_error("Invalid ratings matrix file: " + file_path);
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, RATINGS_MAGIC, sizeof(RATINGS_MAGIC)) != 0) {
+        throw std::runtime_error("Invalid ratings matrix file: " + file_path);
+    }
+    if (header.version != RATINGS_VERSION || header.header_size != sizeof(header)) {
+        throw std::runtime_error("Unsupported ratings matrix version in " + file_path);
+    }
+    // Extents are computed overflow-checked: the header may hold anything.
+    const std::uint64_t offsets_size = sizeof(std::uint64_t);
+    std::uint64_t row_offsets_size, entries_size, column_offsets_size;
+    std::uint64_t row_offsets_end, row_entries_end, column_offsets_end, column_entries_end;
+    bool fits = checked_product(header.users, offsets_size, row_offsets_size) &&
+                checked_sum(row_offsets_size, offsets_size, row_offsets_size) &&
+                checked_product(header.entries, sizeof(RatingEntry), entries_size) &&
+                checked_product(header.movies, offsets_size, column_offsets_size) &&
+                checked_sum(column_offsets_size, offsets_size, column_offsets_size) &&
+                checked_sum(header.row_offsets_offset, row_offsets_size, row_offsets_end) &&
+                checked_sum(header.row_entries_offset, entries_size, row_entries_end) &&
+                checked_sum(header.column_offsets_offset, column_offsets_size,
+                            column_offsets_end) &&
+                checked_sum(header.column_entries_offset, entries_size, column_entries_end);
+    if (!fits || header.file_size != size || header.row_offsets_offset % offsets_size != 0 ||
+        header.dictionary_offset < sizeof(header) ||
+        header.dictionary_offset > header.names_offset ||
+        header.names_offset > header.row_offsets_offset ||
+        header.row_entries_offset != row_offsets_end ||
+        header.column_offsets_offset != row_entries_end ||
+        header.column_entries_offset != column_offsets_end || column_entries_end != size) {
+        throw std::runtime_error("Corrupt ratings matrix layout in " + file_path);
+    }
+    if (verify_checksum &&
+        snapshot_checksum(data + sizeof(header), size - sizeof(header)) != header.checksum) {
+        throw std::runtime_error("Ratings matrix checksum mismatch in " + file_path);
+    }
+
+    row_offsets = reinterpret_cast<const std::uint64_t*>(data + header.row_offsets_offset);
+    row_entries = reinterpret_cast<const RatingEntry*>(data + header.row_entries_offset);
+    column_offsets = reinterpret_cast<const std::uint64_t*>(data + header.column_offsets_offset);
+    column_entries = reinterpret_cast<const RatingEntry*>(data + header.column_entries_offset);
+    if (!valid_offsets(row_offsets, header.users, header.entries) ||
+        !valid_offsets(column_offsets, header.movies, header.entries)) {
+        throw std::runtime_error("Corrupt ratings matrix offsets in " + file_path);
+    }
+    // Verified opens read every page anyway; unverified ones trust the entries.
+    if (verify_checksum && (!valid_indexes(row_entries, header.entries, header.movies) ||
+                            !valid_indexes(column_entries, header.entries, header.users))) {
+        throw std::runtime_error("Corrupt ratings matrix entries in " + file_path);
+    }
+
+    const char* cursor = data + header.dictionary_offset;
+    const char* end = data + header.names_offset;
+    dictionary.reserve(header.movies);
+    for (std::uint64_t i = 0; i < header.movies; ++i) {
+        std::int32_t year;
+        std::uint32_t name_length;
+        if (end - cursor < static_cast<std::ptrdiff_t>(sizeof(year) + sizeof(name_length))) {
+            throw std::runtime_error("Corrupt ratings matrix dictionary in " + file_path);
+        }
+        std::memcpy(&year, cursor, sizeof(year));
+        std::memcpy(&name_length, cursor + sizeof(year), sizeof(name_length));
+        cursor += sizeof(year) + sizeof(name_length);
+        if (end - cursor < static_cast<std::ptrdiff_t>(name_length)) {
+            throw std::runtime_error("Corrupt ratings matrix dictionary in " + file_path);
+        }
+        dictionary.push_back(MatrixMovie{std::string(cursor, name_length), year});
+        cursor += name_length;
+    }
+
+    end = data + header.row_offsets_offset;
+    names.reserve(header.users);
+    for (std::uint64_t i = 0; i < header.users; ++i) {
+        std::uint32_t name_length;
+        if (end - cursor < static_cast<std::ptrdiff_t>(sizeof(name_length))) {
+            throw std::runtime_error("Corrupt ratings matrix user names in " + file_path);
+        }
+        std::memcpy(&name_length, cursor, sizeof(name_length));
+        cursor += sizeof(name_length);
+        if (end - cursor < static_cast<std::ptrdiff_t>(name_length)) {
+            throw std::runtime_error("Corrupt ratings matrix user names in " + file_path);
+        }
+        names.emplace_back(cursor, name_length);
+        cursor += name_length;
+    }
+}
@@ -0,0 +1,130 @@
+#ifndef RATINGSMATRIX_H
+#define RATINGSMATRIX_H
+
+#include "MappedFile.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * Binary sparse ratings matrix, native byte order:
+ *
+ *   RatingsHeader
+ *   movie dictionary: movies x { int32 year, uint32 name_length, name bytes }
+ *   user names:       users x { uint32 name_length, name bytes }
+ *   row offsets:      users + 1 uint64, 8 byte aligned        (CSR)
+ *   row entries:      entries x RatingEntry { column, rating }, by user, then column
+ *   column offsets:   movies + 1 uint64                        (CSC)
+ *   column entries:   entries x RatingEntry { user, rating }, by column, then user
+ *
+ * Only rated cells are stored. Columns index the movie dictionary, which is
+ * shared by every user. Ratings are stored as float, as in compact storage.
+ * The checksum is FNV-1a over everything after the header.
+ */
+
+#define RATINGS_MAGIC "RSRATES"
+#define RATINGS_VERSION 1
+
+struct RatingsHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t header_size;
+    std::uint64_t users;
+    std::uint64_t movies;
+    std::uint64_t entries;
+    std::uint64_t dictionary_offset;
+    std::uint64_t names_offset;
+    std::uint64_t row_offsets_offset;
+    std::uint64_t row_entries_offset;
+    std::uint64_t column_offsets_offset;
+    std::uint64_t column_entries_offset;
+    std::uint64_t file_size;
+    std::uint64_t checksum;
+};
+
+struct RatingEntry {
+    std::uint32_t index; // column in a row, user in a column
+    float rating;
+};
+
+struct MatrixMovie {
+    std::string name;
+    int year;
+};
+
+// The rated cells of one row or column.
+class RatingSpan {
+private:
+    const RatingEntry* first;
+    const RatingEntry* last;
+
+public:
+    RatingSpan(const RatingEntry* first, const RatingEntry* last) : first(first), last(last) {}
+    const RatingEntry* begin() const { return first; }
+    const RatingEntry* end() const { return last; }
+    std::size_t size() const { return last - first; }
+    bool empty() const { return first == last; }
+};
+
+/**
+ * Read-only ratings matrix served straight from a mapping of the file: rows
+ * (users) and columns (movies) are both O(1) to reach and cost nothing until
+ * their pages are touched. Only the dictionary and the user name table are
+ * decoded when the file is opened.
+ */
+class RatingsMatrix {
+private:
+    std::shared_ptr<MappedFile> mapping;
+    RatingsHeader header;
+    std::vector<MatrixMovie> dictionary;
+    std::vector<std::string_view> names;
+    const std::uint64_t* row_offsets;
+    const RatingEntry* row_entries;
+    const std::uint64_t* column_offsets;
+    const RatingEntry* column_entries;
+
+public:
+    /**
+     * Maps a file written by write(). The layout and offsets are always
+     * checked; the entries' column and user indexes only when verifying, so
+     * an unverified open trusts them.
+     * @param verify_checksum - also checksum the whole file and check every
+     * entry (reads every page)
+     * @throws std::runtime_error if the file is missing, not a ratings matrix or corrupt
+     */
+    explicit RatingsMatrix(const std::string& file_path, bool verify_checksum = false);
+
+    /**
+     * Writes a matrix given in CSR form; the CSC half is derived from it.
+     * @param row_offsets - users + 1 offsets into row_entries
+     * @param row_entries - (column, rating) cells, by user, then column
+     */
+    static void write(const std::string& file_path, const std::vector<MatrixMovie>& movies,
+                      const std::vector<std::string>& users,
+                      const std::vector<std::uint64_t>& row_offsets,
+                      const std::vector<RatingEntry>& row_entries);
+
+    std::size_t user_count() const { return header.users; }
+    std::size_t movie_count() const { return header.movies; }
+    std::size_t entry_count() const { return header.entries; }
+    std::size_t file_size() const { return header.file_size; }
+
+    const MatrixMovie& movie(std::size_t column) const { return dictionary[column]; }
+    std::string_view user_name(std::size_t user) const { return names[user]; }
+
+    // The user's ratings as (column, rating), by column.
+    RatingSpan row(std::size_t user) const {
+        return RatingSpan(row_entries + row_offsets[user], row_entries + row_offsets[user + 1]);
+    }
+
+    // The movie's ratings as (user, rating), by user.
+    RatingSpan column(std::size_t movie_column) const {
+        return RatingSpan(column_entries + column_offsets[movie_column],
+                          column_entries + column_offsets[movie_column + 1]);
+    }
+};
+
+#endif // RATINGSMATRIX_H
@@ -0,0 +1,91 @@
+#include "RecommendationClient.h"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define RS_HAVE_UNIX_SOCKETS 1
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#ifndef SOCK_CLOEXEC
+#define SOCK_CLOEXEC 0
+#endif
+
+#ifdef RS_HAVE_UNIX_SOCKETS
+
+RecommendationClient::RecommendationClient(const std::string& socket_path) : socket(-1) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socket_path.empty() || socket_path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Invalid socket path: " + socket_path);
+    }
+    std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+    socket = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (socket < 0 ||
+        ::connect(socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        std::string reason = std::strerror(errno);
+        if (socket >= 0) ::close(socket);
+        throw std::runtime_error("Failed to connect to " + socket_path + ": " + reason);
+    }
+}
+
+RecommendationClient::~RecommendationClient() {
+    ::close(socket);
+}
+
+void RecommendationClient::send(const ServerRequest& request) {
+    output.clear();
+    ServerProtocol::encode(request, output);
+    std::size_t sent = 0;
+    while (sent < output.size()) {
+        ssize_t written = ::send(socket, output.data() + sent, output.size() - sent, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) {
+            throw std::runtime_error("Connection to the server lost");
+        }
+        sent += static_cast<std::size_t>(written);
+    }
+}
+
+ServerResponse RecommendationClient::receive() {
+    std::size_t size;
+    while ((size = ServerProtocol::frame_size(input.data(), input.size())) == 0) {
+        char chunk[65536];
+        ssize_t got = ::read(socket, chunk, sizeof(chunk));
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) {
+            throw std::runtime_error("Connection to the server lost");
+        }
+        input.append(chunk, static_cast<std::size_t>(got));
+    }
+    ServerResponse response;
+    if (!ServerProtocol::decode(input.data() + sizeof(std::uint32_t), size - sizeof(std::uint32_t),
+                                response)) {
+        throw std::runtime_error("Malformed response from the server");
+    }
+    input.erase(0, size);
+    return response;
+}
+
+#else
+
+RecommendationClient::RecommendationClient(const std::string&) : socket(-1) {
+    throw std::runtime_error("The recommendation client needs Unix sockets");
+}
+
+RecommendationClient::~RecommendationClient() {}
+
+void RecommendationClient::send(const ServerRequest&) {}
+
+ServerResponse RecommendationClient::receive() {
+    return {};
+}
+
+#endif // RS_HAVE_UNIX_SOCKETS
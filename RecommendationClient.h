@@ -0,0 +1,38 @@
+#ifndef RECOMMENDATIONCLIENT_H
+#define RECOMMENDATIONCLIENT_H
+
+#include "ServerProtocol.h"
+#include <string>
+
+/**
+ * Blocking client of RecommendationServer over one connection. Requests can
+ * be pipelined: send() several, then receive() their responses in order.
+ * Not thread-safe; use one client per thread.
+ */
+class RecommendationClient {
+private:
+    int socket;
+    std::string input;
+    std::string output;
+
+public:
+    /**
+     * @throws std::runtime_error if the server cannot be reached
+     */
+    explicit RecommendationClient(const std::string& socket_path);
+    ~RecommendationClient();
+
+    RecommendationClient(const RecommendationClient&) = delete;
+    RecommendationClient& operator=(const RecommendationClient&) = delete;
+
+    // @throws std::runtime_error if the connection is lost
+    void send(const ServerRequest& request);
+    ServerResponse receive();
+
+    ServerResponse call(const ServerRequest& request) {
+        send(request);
+        return receive();
+    }
+};
+
+#endif // RECOMMENDATIONCLIENT_H
@@ -0,0 +1,27 @@
+#include "RecommendationFilter.h"
+
+CandidateFilter::CandidateFilter(const MovieCatalog& movies, const RecommendationFilter& filter)
+    : movies(movies),
+      min_year(filter.min_year),
+      max_year(filter.max_year),
+      by_year(filter.filters_year()) {
+    std::size_t words = (movies.size() + 63) / 64;
+    if (filter.allow.empty()) {
+        blocked.assign(words, 0);
+    } else {
+        // Everything is blocked but the allowed movies.
+        blocked.assign(words, ~std::uint64_t{0});
+        for (const sp_movie& movie : filter.allow) {
+            movie_id id = movies.find(movie);
+            if (id != INVALID_MOVIE_ID) {
+                blocked[id / 64] &= ~(std::uint64_t{1} << (id % 64));
+            }
+        }
+    }
+    for (const sp_movie& movie : filter.exclude) {
+        movie_id id = movies.find(movie);
+        if (id != INVALID_MOVIE_ID) {
+            block(id);
+        }
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef RECOMMENDATIONFILTER_H
+#define RECOMMENDATIONFILTER_H
+
+#include "MovieCatalog.h"
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+/**
+ * Business rules for a recommend call. A movie can be returned only if its
+ * year is in [min_year, max_year], it is not in `exclude`, and, when `allow`
+ * is not empty, it is in `allow`. Movies the user rated are never returned.
+ */
+struct RecommendationFilter {
+    int min_year = std::numeric_limits<int>::min();
+    int max_year = std::numeric_limits<int>::max();
+    std::vector<sp_movie> exclude; // e.g. titles the user has already been shown
+    std::vector<sp_movie> allow;   // empty: every movie
+
+    bool filters_year() const {
+        return min_year != std::numeric_limits<int>::min() ||
+               max_year != std::numeric_limits<int>::max();
+    }
+};
+
+/**
+ * A RecommendationFilter resolved against one catalog for one request: a
+ * bitmap over the dense movie ids with a bit set for every movie that may not
+ * be returned, plus the year range, checked only for movies the bitmap lets
+ * through. Scans walk the bitmap a word at a time, so long blocked stretches
+ * (e.g. outside a short allow list) cost one test per 64 movies.
+ */
+class CandidateFilter {
+private:
+    const MovieCatalog& movies;
+    std::vector<std::uint64_t> blocked;
+    int min_year;
+    int max_year;
+    bool by_year;
+
+    bool year_ok(movie_id id) const {
+        int year = movies.movie(id)->get_year();
+        return year >= min_year && year <= max_year;
+    }
+
+public:
+    // Keeps a reference to the catalog; it must outlive the filter.
+    CandidateFilter(const MovieCatalog& movies, const RecommendationFilter& filter);
+
+    // Also rejects this movie, e.g. because the user rated it.
+    void block(movie_id id) {
+        if (id < movies.size()) blocked[id / 64] |= std::uint64_t{1} << (id % 64);
+    }
+
+    bool accepts(movie_id id) const {
+        if (blocked[id / 64] & (std::uint64_t{1} << (id % 64))) return false;
+        return !by_year || year_ok(id);
+    }
+
+    // Calls visit(id) for every accepted id in [begin, end), in increasing order.
+    template <typename Visit>
+    void for_each_candidate(movie_id begin, movie_id end, Visit&& visit) const {
+        for (movie_id word = begin / 64; word * 64 < end; ++word) {
+            std::uint64_t open = ~blocked[word];
+            if (word == begin / 64) open &= ~std::uint64_t{0} << (begin % 64);
+            if ((word + 1) * 64 > end) open &= ~(~std::uint64_t{0} << (end % 64));
+            while (open) {
+                movie_id id = word * 64 + static_cast<movie_id>(__builtin_ctzll(open));
+                open &= open - 1;
+                if (!by_year || year_ok(id)) visit(id);
+            }
+        }
+    }
+};
+
+#endif // RECOMMENDATIONFILTER_H
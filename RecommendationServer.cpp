@@ -0,0 +1,523 @@
+#include "RecommendationServer.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef __linux__
+#define RS_HAVE_EPOLL 1
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+// epoll keys of the two non-connection descriptors; connection ids start at 1.
+#define LISTENER_KEY 0
+#define WAKEUP_KEY UINT64_MAX
+
+// Bytes read from a connection per read() call.
+#define READ_CHUNK 65536
+
+struct RecommendationServer::Connection {
+    int socket;
+    std::uint64_t id;
+    std::string input;             // bytes not yet parsed into requests
+    std::string output;            // response bytes, sent up to output_sent
+    std::size_t output_sent = 0;
+    bool backlogged = false;       // input may hold frames the queue had no room for
+    bool reading = true;           // registered for EPOLLIN
+    bool writing = false;          // registered for EPOLLOUT
+
+    std::size_t pending_output() const { return output.size() - output_sent; }
+};
+
+std::ostream& operator<<(std::ostream& os, const ServerStats& stats) {
+    os << "server: requests=" << stats.requests << " errors=" << stats.errors
+       << " batches=" << stats.batches << " mean_batch=" << stats.mean_batch()
+       << " connections=" << stats.connections << " read_pauses=" << stats.read_pauses << "\n";
+    return os;
+}
+
+RecommendationServer::RecommendationServer(std::shared_ptr<RecommendationSystem> rs,
+                                           std::vector<User> users, ServerOptions options)
+    : rs(std::move(rs)), users(std::move(users)), options(std::move(options)) {
+    for (std::size_t i = 0; i < this->users.size(); ++i) {
+        user_index.emplace(this->users[i].get_name(), i);
+    }
+    this->options.max_batch = std::max<std::size_t>(1, this->options.max_batch);
+    this->options.queue_capacity = std::max<std::size_t>(1, this->options.queue_capacity);
+}
+
+RecommendationServer::~RecommendationServer() {
+    stop();
+}
+
+ServerStats RecommendationServer::stats() const {
+    ServerStats result;
+    result.requests = request_count.load(std::memory_order_relaxed);
+    result.errors = error_count.load(std::memory_order_relaxed);
+    result.batches = batch_count.load(std::memory_order_relaxed);
+    result.connections = connection_count.load(std::memory_order_relaxed);
+    result.read_pauses = pause_count.load(std::memory_order_relaxed);
+    return result;
+}
+
+// Adds the first `wanted` movies of `best` while the response body still fits
+// in one frame; a longer list is cut short rather than sent unreadable.
+static void add_movies(ServerResponse& response, const std::vector<scored_movie>& best,
+                       std::size_t wanted) {
+    std::size_t body = RESPONSE_HEADER_BYTES;
+    for (std::size_t r = 0; r < best.size() && r < wanted; ++r) {
+        ResponseMovie entry{best[r].first->get_name(), best[r].first->get_year(), best[r].second};
+        body += ServerProtocol::encoded_size(entry);
+        if (body > MAX_FRAME_BYTES) {
+            return;
+        }
+        response.movies.push_back(std::move(entry));
+    }
+}
+
+// Content requests of the batch are scored together, for the widest n asked
+// for; a shorter list is a prefix of it because the ranking is total. If that
+// fails they are answered one by one, so only the request at fault fails.
+void RecommendationServer::answer(std::vector<Pending>& batch, std::vector<Completion>& out) {
+    std::vector<ServerResponse> responses(batch.size());
+    std::vector<const User*> content_users;
+    std::vector<std::size_t> content_slots;
+    int widest = 0;
+    for (std::size_t i = 0; i < batch.size(); ++i) {
+        const ServerRequest& request = batch[i].request;
+        responses[i].id = request.id;
+        auto user = user_index.find(request.user);
+        if (user == user_index.end()) {
+            responses[i].status = ResponseStatus::error;
+            responses[i].error = "Unknown user: " + request.user;
+        } else if (request.call == ServerCall::content) {
+            content_users.push_back(&users[user->second]);
+            content_slots.push_back(i);
+            widest = std::max(widest, request.n);
+        } else {
+            responses[i] = answer_one(request, users[user->second]);
+        }
+    }
+
+    if (!content_users.empty()) {
+        try {
+            answer_content(batch, content_users, content_slots, widest, responses);
+        } catch (const std::exception&) {
+            for (std::size_t j = 0; j < content_slots.size(); ++j) {
+                const std::size_t slot = content_slots[j];
+                try {
+                    answer_content(batch, {content_users[j]}, {slot}, batch[slot].request.n,
+                                   responses);
+                } catch (const std::exception& e) {
+                    responses[slot].movies.clear();
+                    responses[slot].status = ResponseStatus::error;
+                    responses[slot].error = e.what();
+                }
+            }
+        }
+    }
+
+    for (std::size_t i = 0; i < batch.size(); ++i) {
+        if (responses[i].status == ResponseStatus::error) {
+            error_count.fetch_add(1, std::memory_order_relaxed);
+        }
+        Completion completion{batch[i].connection, {}};
+        ServerProtocol::encode(responses[i], completion.frames);
+        out.push_back(std::move(completion));
+    }
+    request_count.fetch_add(batch.size(), std::memory_order_relaxed);
+    batch_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Fills the responses at `slots` from one batch call for `users`, at n each.
+void RecommendationServer::answer_content(const std::vector<Pending>& batch,
+                                          const std::vector<const User*>& users,
+                                          const std::vector<std::size_t>& slots, int n,
+                                          std::vector<ServerResponse>& responses) {
+    std::vector<std::vector<scored_movie>> results = rs->recommend_top_n_by_content_batch(users, n);
+    for (std::size_t j = 0; j < slots.size(); ++j) {
+        ServerResponse& response = responses[slots[j]];
+        add_movies(response, results[j],
+                   static_cast<std::size_t>(std::max(0, batch[slots[j]].request.n)));
+    }
+}
+
+ServerResponse RecommendationServer::answer_one(const ServerRequest& request, const User& user) {
+    ServerResponse response;
+    response.id = request.id;
+    try {
+        if (request.call == ServerCall::cf) {
+            std::vector<scored_movie> best = rs->recommend_top_n_by_cf(user, request.k, request.n);
+            add_movies(response, best, best.size());
+            return response;
+        }
+        sp_movie movie = rs->get_movie(request.movie, request.year);
+        if (!movie) {
+            throw std::runtime_error("Movie not found.");
+        }
+        double score = rs->predict_movie_score(user, movie, request.k);
+        response.movies.push_back({movie->get_name(), movie->get_year(), score});
+    } catch (const std::exception& e) {
+        response.status = ResponseStatus::error;
+        response.movies.clear();
+        response.error = e.what();
+    }
+    return response;
+}
+
+// Waits for a first request, then up to batch_window for more to join it.
+void RecommendationServer::run_dispatcher() {
+    for (;;) {
+        std::vector<Pending> batch;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            queue_ready.wait(lock, [&] { return stopping || !queue.empty(); });
+            auto deadline = std::chrono::steady_clock::now() + options.batch_window;
+            queue_ready.wait_until(lock, deadline,
+                                   [&] { return stopping || queue.size() >= options.max_batch; });
+            if (stopping) {
+                return;
+            }
+            std::size_t taken = std::min(queue.size(), options.max_batch);
+            batch.assign(std::make_move_iterator(queue.begin()),
+                         std::make_move_iterator(queue.begin() + taken));
+            queue.erase(queue.begin(), queue.begin() + taken);
+        }
+        wake(); // the queue has room again
+
+        std::vector<Completion> done;
+        answer(batch, done);
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            for (Completion& completion : done) {
+                completed.push_back(std::move(completion));
+            }
+        }
+        wake();
+    }
+}
+
+#ifdef RS_HAVE_EPOLL
+
+void RecommendationServer::wake() {
+    std::uint64_t one = 1;
+    ssize_t written = ::write(wakeup, &one, sizeof(one));
+    (void)written; // a full counter already means "wake up"
+}
+
+bool RecommendationServer::queue_full() {
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    return queue.size() >= options.queue_capacity;
+}
+
+void RecommendationServer::start() {
+    if (loop_thread.joinable()) {
+        throw std::logic_error("Server already started");
+    }
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (options.socket_path.empty() || options.socket_path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Invalid socket path: " + options.socket_path);
+    }
+    std::memcpy(address.sun_path, options.socket_path.c_str(), options.socket_path.size() + 1);
+
+    auto fail = [&](const std::string& what) {
+        std::string message = what + ": " + std::strerror(errno);
+        for (int* fd : {&listener, &poller, &wakeup}) {
+            if (*fd >= 0) ::close(*fd);
+            *fd = -1;
+        }
+        throw std::runtime_error(message);
+    };
+    listener = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listener < 0) fail("Failed to create socket");
+    ::unlink(options.socket_path.c_str());
+    if (::bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        fail("Failed to bind " + options.socket_path);
+    }
+    if (::listen(listener, SOMAXCONN) != 0) fail("Failed to listen on " + options.socket_path);
+    poller = ::epoll_create1(EPOLL_CLOEXEC);
+    if (poller < 0) fail("Failed to create epoll instance");
+    wakeup = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeup < 0) fail("Failed to create eventfd");
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = LISTENER_KEY;
+    ::epoll_ctl(poller, EPOLL_CTL_ADD, listener, &event);
+    event.data.u64 = WAKEUP_KEY;
+    ::epoll_ctl(poller, EPOLL_CTL_ADD, wakeup, &event);
+
+    stopping = false;
+    loop_thread = std::thread(&RecommendationServer::run_loop, this);
+    dispatcher_thread = std::thread(&RecommendationServer::run_dispatcher, this);
+}
+
+void RecommendationServer::stop() {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        if (!loop_thread.joinable()) {
+            return;
+        }
+        stopping = true;
+    }
+    queue_ready.notify_all();
+    wake();
+    loop_thread.join();
+    dispatcher_thread.join();
+
+    while (!connections.empty()) {
+        close_connection(connections.begin()->first);
+    }
+    for (int* fd : {&listener, &poller, &wakeup}) {
+        ::close(*fd);
+        *fd = -1;
+    }
+    ::unlink(options.socket_path.c_str());
+    queue.clear();
+    completed.clear();
+}
+
+void RecommendationServer::run_loop() {
+    epoll_event events[64];
+    for (;;) {
+        int ready = ::epoll_wait(poller, events, 64, -1);
+        if (ready < 0 && errno != EINTR) {
+            return;
+        }
+        for (int i = 0; i < ready; ++i) {
+            std::uint64_t key = events[i].data.u64;
+            if (key == LISTENER_KEY) {
+                accept_connections();
+                continue;
+            }
+            if (key == WAKEUP_KEY) {
+                std::uint64_t count;
+                ssize_t got = ::read(wakeup, &count, sizeof(count));
+                (void)got;
+                continue;
+            }
+            auto it = connections.find(key);
+            if (it == connections.end()) continue;
+            Connection& connection = *it->second;
+            if (events[i].events & EPOLLOUT) {
+                write_connection(connection);
+                if (connections.count(key) == 0) continue;
+            }
+            if (events[i].events & EPOLLIN) {
+                read_connection(connection);
+            } else if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+                close_connection(key);
+            }
+        }
+
+        std::vector<Completion> done;
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            if (stopping) {
+                return;
+            }
+            done.swap(completed);
+        }
+        // Responses for connections that have gone away are dropped.
+        for (Completion& completion : done) {
+            auto it = connections.find(completion.connection);
+            if (it == connections.end()) continue;
+            it->second->output += completion.frames;
+            if (!it->second->writing) write_connection(*it->second);
+        }
+
+        // Resume connections paused for a backlog, a full queue or unsent output.
+        std::vector<std::uint64_t> paused;
+        for (const auto& [id, connection] : connections) {
+            if (!connection->reading) paused.push_back(id);
+        }
+        for (std::uint64_t id : paused) {
+            auto it = connections.find(id);
+            if (it != connections.end() && parse_frames(*it->second)) {
+                update_interest(*it->second);
+            }
+        }
+    }
+}
+
+void RecommendationServer::accept_connections() {
+    for (;;) {
+        int socket = ::accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (socket < 0) {
+            return;
+        }
+        auto connection = std::make_unique<Connection>();
+        connection->socket = socket;
+        connection->id = next_connection++;
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = connection->id;
+        if (::epoll_ctl(poller, EPOLL_CTL_ADD, socket, &event) != 0) {
+            ::close(socket);
+            continue;
+        }
+        connection_count.fetch_add(1, std::memory_order_relaxed);
+        connections.emplace(connection->id, std::move(connection));
+    }
+}
+
+void RecommendationServer::read_connection(Connection& connection) {
+    char chunk[READ_CHUNK];
+    while (connection.pending_output() < options.max_pending_output && !connection.backlogged &&
+           !queue_full()) {
+        ssize_t got = ::read(connection.socket, chunk, sizeof(chunk));
+        if (got > 0) {
+            connection.input.append(chunk, static_cast<std::size_t>(got));
+            if (!parse_frames(connection)) return;
+            continue;
+        }
+        if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        close_connection(connection.id); // end of stream or error
+        return;
+    }
+    update_interest(connection);
+}
+
+// Queues the complete frames, as many as the queue has room for. A malformed
+// frame closes the connection; returns false then.
+bool RecommendationServer::parse_frames(Connection& connection) {
+    std::vector<Pending> parsed;
+    std::size_t offset = 0;
+    std::size_t room;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        room = options.queue_capacity - std::min(options.queue_capacity, queue.size());
+        while (parsed.size() < room) {
+            std::size_t size;
+            try {
+                size = ServerProtocol::frame_size(connection.input.data() + offset,
+                                                  connection.input.size() - offset);
+            } catch (const std::length_error&) {
+                size = SIZE_MAX;
+            }
+            if (size == 0) break;
+            ServerRequest request;
+            if (size == SIZE_MAX ||
+                !ServerProtocol::decode(connection.input.data() + offset + sizeof(std::uint32_t),
+                                        size - sizeof(std::uint32_t), request)) {
+                parsed.clear();
+                offset = SIZE_MAX;
+                break;
+            }
+            parsed.push_back({connection.id, std::move(request)});
+            offset += size;
+        }
+        for (Pending& pending : parsed) {
+            queue.push_back(std::move(pending));
+        }
+    }
+    if (offset == SIZE_MAX) {
+        close_connection(connection.id);
+        return false;
+    }
+    connection.input.erase(0, offset);
+    connection.backlogged = parsed.size() == room;
+    if (!parsed.empty()) {
+        queue_ready.notify_one();
+    }
+    return true;
+}
+
+void RecommendationServer::write_connection(Connection& connection) {
+    while (connection.pending_output() > 0) {
+        ssize_t sent = ::send(connection.socket, connection.output.data() + connection.output_sent,
+                              connection.pending_output(), MSG_NOSIGNAL);
+        if (sent > 0) {
+            connection.output_sent += static_cast<std::size_t>(sent);
+            continue;
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        close_connection(connection.id);
+        return;
+    }
+    if (connection.pending_output() == 0) {
+        connection.output.clear();
+        connection.output_sent = 0;
+    } else if (connection.output_sent >= READ_CHUNK) {
+        connection.output.erase(0, connection.output_sent);
+        connection.output_sent = 0;
+    }
+    update_interest(connection);
+}
+
+// Reads only while every frame read so far is queued, the queue has room and
+// the client keeps up with its responses; writes only while responses wait.
+void RecommendationServer::update_interest(Connection& connection) {
+    bool read = connection.pending_output() < options.max_pending_output &&
+                !connection.backlogged && !queue_full();
+    bool write = connection.pending_output() > 0;
+    if (read == connection.reading && write == connection.writing) {
+        return;
+    }
+    if (!read && connection.reading) {
+        pause_count.fetch_add(1, std::memory_order_relaxed);
+    }
+    connection.reading = read;
+    connection.writing = write;
+    epoll_event event{};
+    event.events = (read ? EPOLLIN : 0u) | (write ? EPOLLOUT : 0u);
+    event.data.u64 = connection.id;
+    ::epoll_ctl(poller, EPOLL_CTL_MOD, connection.socket, &event);
+}
+
+void RecommendationServer::close_connection(std::uint64_t id) {
+    auto it = connections.find(id);
+    if (it == connections.end()) {
+        return;
+    }
+    ::epoll_ctl(poller, EPOLL_CTL_DEL, it->second->socket, nullptr);
+    ::close(it->second->socket);
+    connections.erase(it);
+}
+
+#else
+
+void RecommendationServer::wake() {}
+
+bool RecommendationServer::queue_full() {
+    return false;
+}
+
+void RecommendationServer::start() {
+    throw std::runtime_error("The recommendation server needs epoll");
+}
+
+void RecommendationServer::stop() {}
+
+void RecommendationServer::run_loop() {}
+
+void RecommendationServer::accept_connections() {}
+
+void RecommendationServer::read_connection(Connection&) {}
+
+bool RecommendationServer::parse_frames(Connection&) {
+    return false;
+}
+
+void RecommendationServer::write_connection(Connection&) {}
+
+void RecommendationServer::update_interest(Connection&) {}
+
+void RecommendationServer::close_connection(std::uint64_t) {}
+
+#endif // RS_HAVE_EPOLL
@@ -0,0 +1,138 @@
+#ifndef RECOMMENDATIONSERVER_H
+#define RECOMMENDATIONSERVER_H
+
+#include "RecommendationSystem.h"
+#include "ServerProtocol.h"
+#include "User.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct ServerOptions {
+    std::string socket_path;
+    // How long the first request of a batch waits for others to join it.
+    std::chrono::microseconds batch_window{500};
+    std::size_t max_batch = 256;
+    // Requests waiting for a batch; while it is full no connection is read.
+    std::size_t queue_capacity = 4096;
+    // Unsent response bytes after which a connection is no longer read.
+    std::size_t max_pending_output = 1 << 20;
+};
+
+struct ServerStats {
+    std::uint64_t requests = 0;
+    std::uint64_t errors = 0;
+    std::uint64_t batches = 0;
+    std::uint64_t connections = 0;
+    std::uint64_t read_pauses = 0; // times reading stopped for a full queue or output
+
+    double mean_batch() const {
+        return batches == 0 ? 0.0 : static_cast<double>(requests) / batches;
+    }
+};
+
+std::ostream& operator<<(std::ostream& os, const ServerStats& stats);
+
+/**
+ * Serves recommend-by-content, recommend-by-CF and predict-score for a fixed
+ * set of users over a Unix socket, speaking ServerProtocol.
+ *
+ * One event-loop thread (epoll) accepts connections, reads frames and writes
+ * responses without blocking. Decoded requests wait in a bounded queue; a
+ * dispatcher thread takes whatever arrived within batch_window of the oldest
+ * one (at most max_batch) and answers the batch together: all content
+ * requests in one recommend_top_n_by_content_batch call, the rest one by one.
+ * When the queue is full, or a client does not read its responses, the loop
+ * stops reading the affected connections, which pushes back on the clients
+ * through their socket buffers instead of dropping requests.
+ *
+ * Responses on one connection come back in request order.
+ */
+class RecommendationServer {
+private:
+    struct Pending {
+        std::uint64_t connection;
+        ServerRequest request;
+    };
+    struct Completion {
+        std::uint64_t connection;
+        std::string frames;
+    };
+    struct Connection;
+
+    std::shared_ptr<RecommendationSystem> rs;
+    std::vector<User> users;
+    std::unordered_map<std::string, std::size_t> user_index;
+    ServerOptions options;
+
+    int listener = -1;
+    int poller = -1;
+    int wakeup = -1; // eventfd: completions are ready, queue has room, or stop
+    std::unordered_map<std::uint64_t, std::unique_ptr<Connection>> connections;
+    std::uint64_t next_connection = 1;
+
+    std::mutex queue_mutex;
+    std::condition_variable queue_ready;
+    std::deque<Pending> queue;
+    std::vector<Completion> completed; // guarded by queue_mutex
+    bool stopping = false;
+
+    std::thread loop_thread;
+    std::thread dispatcher_thread;
+
+    std::atomic<std::uint64_t> request_count{0}, error_count{0}, batch_count{0},
+        connection_count{0}, pause_count{0};
+
+    void run_loop();
+    void run_dispatcher();
+    void answer(std::vector<Pending>& batch, std::vector<Completion>& out);
+    ServerResponse answer_one(const ServerRequest& request, const User& user);
+    void answer_content(const std::vector<Pending>& batch, const std::vector<const User*>& users,
+                        const std::vector<std::size_t>& slots, int n,
+                        std::vector<ServerResponse>& responses);
+
+    void accept_connections();
+    void read_connection(Connection& connection);
+    void write_connection(Connection& connection);
+    bool parse_frames(Connection& connection);
+    void update_interest(Connection& connection);
+    void close_connection(std::uint64_t id);
+    void wake();
+    bool queue_full();
+
+public:
+    /**
+     * @param users - the users requests can name, by get_name()
+     */
+    RecommendationServer(std::shared_ptr<RecommendationSystem> rs, std::vector<User> users,
+                         ServerOptions options);
+    ~RecommendationServer();
+
+    RecommendationServer(const RecommendationServer&) = delete;
+    RecommendationServer& operator=(const RecommendationServer&) = delete;
+
+    /**
+     * Binds options.socket_path (replacing a stale socket file) and starts
+     * serving on background threads.
+     * @throws std::runtime_error if the socket cannot be set up, or on
+     * platforms without epoll
+     */
+    void start();
+
+    // Stops serving, closes every connection and removes the socket file.
+    void stop();
+
+    ServerStats stats() const;
+};
+
+#endif // RECOMMENDATIONSERVER_H
@@ -0,0 +1,222 @@
+#include "RecommendationStats.h"
+#include <sstream>
+
+static const char* const ENDPOINT_NAMES[] = {"get_movie", "add_movie", "predict", "content", "cf", "user_cf"};
+static const char* const COUNTER_NAMES[] = {
+    "candidates_scanned", "similarity_evaluations", "exclusion_hits", "catalog_lookups",
+    "index_predictions",  "movies_parsed",          "users_parsed",   "movies_parse_ns",
+    "users_parse_ns"};
+
+const char* stats_endpoint_name(StatsEndpoint endpoint) {
+    return ENDPOINT_NAMES[static_cast<std::size_t>(endpoint)];
+}
+
+const char* stats_counter_name(StatsCounter counter) {
+    return COUNTER_NAMES[static_cast<std::size_t>(counter)];
+}
+
+// 0 goes to bucket 0, v > 0 to bucket floor(log2(v)) + 1.
+static std::size_t bucket_of(std::uint64_t value) {
+    std::size_t bucket = value == 0 ? 0 : 64 - __builtin_clzll(value);
+    return bucket < STATS_BUCKETS ? bucket : STATS_BUCKETS - 1;
+}
+
+static std::uint64_t bucket_upper_bound(std::size_t bucket) {
+    return bucket == 0 ? 0 : (std::uint64_t(1) << bucket) - 1;
+}
+
+std::uint64_t EndpointStats::latency_percentile_ns(double p) const {
+    if (calls == 0) {
+        return 0;
+    }
+    std::uint64_t rank = static_cast<std::uint64_t>(p / 100.0 * (calls - 1));
+    std::uint64_t seen = 0;
+    for (std::size_t b = 0; b < STATS_BUCKETS; ++b) {
+        seen += latency_ns[b];
+        if (seen > rank) {
+            return bucket_upper_bound(b);
+        }
+    }
+    return bucket_upper_bound(STATS_BUCKETS - 1);
+}
+
+RecommendationStats::RecommendationStats() : shards(new Shard[STATS_SHARDS]) {
+    reset();
+}
+
+// Threads get shards in creation order. The first STATS_SHARDS - 1 threads own
+// theirs and update it with plain load/store; all later threads share the
+// last shard and need read-modify-write atomics.
+struct StatsThreadSlot {
+    std::size_t shard;
+    bool exclusive;
+};
+
+static StatsThreadSlot thread_slot() {
+    static std::atomic<std::size_t> next_thread{0};
+    std::size_t index = next_thread.fetch_add(1, std::memory_order_relaxed);
+    return index < STATS_SHARDS - 1 ? StatsThreadSlot{index, true}
+                                    : StatsThreadSlot{STATS_SHARDS - 1, false};
+}
+
+static thread_local const StatsThreadSlot stats_slot = thread_slot();
+
+static inline void bump(std::atomic<std::uint64_t>& counter, std::uint64_t amount) {
+    if (stats_slot.exclusive) {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    } else {
+        counter.fetch_add(amount, std::memory_order_relaxed);
+    }
+}
+
+RecommendationStats::Shard& RecommendationStats::local() {
+    return shards[stats_slot.shard];
+}
+
+void RecommendationStats::add(StatsCounter counter, std::uint64_t amount) {
+    bump(local().counters[static_cast<std::size_t>(counter)], amount);
+}
+
+void RecommendationStats::record_call(StatsEndpoint endpoint, std::uint64_t ns,
+                                      std::size_t catalog_size, std::size_t ratings,
+                                      std::size_t k) {
+    auto& e = local().endpoints[static_cast<std::size_t>(endpoint)];
+    bump(e.calls, 1);
+    bump(e.total_ns, ns);
+    bump(e.latency_ns[bucket_of(ns)], 1);
+    std::size_t b = bucket_of(catalog_size);
+    bump(e.calls_by_catalog[b], 1);
+    bump(e.ns_by_catalog[b], ns);
+    b = bucket_of(ratings);
+    bump(e.calls_by_ratings[b], 1);
+    bump(e.ns_by_ratings[b], ns);
+    b = bucket_of(k);
+    bump(e.calls_by_k[b], 1);
+    bump(e.ns_by_k[b], ns);
+}
+
+static void sum_into(stats_histogram& total, const std::atomic<std::uint64_t>* shard) {
+    for (std::size_t b = 0; b < STATS_BUCKETS; ++b) {
+        total[b] += shard[b].load(std::memory_order_relaxed);
+    }
+}
+
+StatsSnapshot RecommendationStats::snapshot() const {
+    StatsSnapshot snapshot;
+    snapshot.enabled = true;
+    for (std::size_t s = 0; s < STATS_SHARDS; ++s) {
+        const Shard& shard = shards[s];
+        for (std::size_t c = 0; c < snapshot.counters.size(); ++c) {
+            snapshot.counters[c] += shard.counters[c].load(std::memory_order_relaxed);
+        }
+        for (std::size_t i = 0; i < snapshot.endpoints.size(); ++i) {
+            const auto& from = shard.endpoints[i];
+            EndpointStats& to = snapshot.endpoints[i];
+            to.calls += from.calls.load(std::memory_order_relaxed);
+            to.total_ns += from.total_ns.load(std::memory_order_relaxed);
+            sum_into(to.latency_ns, from.latency_ns);
+            sum_into(to.calls_by_catalog, from.calls_by_catalog);
+            sum_into(to.ns_by_catalog, from.ns_by_catalog);
+            sum_into(to.calls_by_ratings, from.calls_by_ratings);
+            sum_into(to.ns_by_ratings, from.ns_by_ratings);
+            sum_into(to.calls_by_k, from.calls_by_k);
+            sum_into(to.ns_by_k, from.ns_by_k);
+        }
+    }
+    return snapshot;
+}
+
+static void clear(std::atomic<std::uint64_t>* values, std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i) {
+        values[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void RecommendationStats::reset() {
+    for (std::size_t s = 0; s < STATS_SHARDS; ++s) {
+        Shard& shard = shards[s];
+        clear(shard.counters, static_cast<std::size_t>(StatsCounter::count));
+        for (auto& e : shard.endpoints) {
+            clear(&e.calls, 1);
+            clear(&e.total_ns, 1);
+            clear(e.latency_ns, STATS_BUCKETS);
+            clear(e.calls_by_catalog, STATS_BUCKETS);
+            clear(e.ns_by_catalog, STATS_BUCKETS);
+            clear(e.calls_by_ratings, STATS_BUCKETS);
+            clear(e.ns_by_ratings, STATS_BUCKETS);
+            clear(e.calls_by_k, STATS_BUCKETS);
+            clear(e.ns_by_k, STATS_BUCKETS);
+        }
+    }
+}
+
+// "[{"up_to":N,"calls":C,"mean_ns":M}, ...]" for the non-empty buckets.
+static void breakdown_json(std::ostream& os, const stats_histogram& calls,
+                           const stats_histogram& ns) {
+    os << '[';
+    bool first = true;
+    for (std::size_t b = 0; b < STATS_BUCKETS; ++b) {
+        if (calls[b] == 0) continue;
+        os << (first ? "" : ",") << "{\"up_to\":" << bucket_upper_bound(b)
+           << ",\"calls\":" << calls[b] << ",\"mean_ns\":" << ns[b] / calls[b] << '}';
+        first = false;
+    }
+    os << ']';
+}
+
+std::string StatsSnapshot::to_json() const {
+    std::ostringstream os;
+    os << "{\"enabled\":" << (enabled ? "true" : "false") << ",\"counters\":{";
+    for (std::size_t c = 0; c < counters.size(); ++c) {
+        os << (c ? "," : "") << '"' << COUNTER_NAMES[c] << "\":" << counters[c];
+    }
+    os << "},\"endpoints\":{";
+    for (std::size_t i = 0; i < endpoints.size(); ++i) {
+        const EndpointStats& e = endpoints[i];
+        os << (i ? "," : "") << '"' << ENDPOINT_NAMES[i] << "\":{\"calls\":" << e.calls
+           << ",\"total_ns\":" << e.total_ns << ",\"p50_ns\":" << e.latency_percentile_ns(50)
+           << ",\"p90_ns\":" << e.latency_percentile_ns(90)
+           << ",\"p99_ns\":" << e.latency_percentile_ns(99) << ",\"by_catalog_size\":";
+        breakdown_json(os, e.calls_by_catalog, e.ns_by_catalog);
+        os << ",\"by_ratings\":";
+        breakdown_json(os, e.calls_by_ratings, e.ns_by_ratings);
+        os << ",\"by_k\":";
+        breakdown_json(os, e.calls_by_k, e.ns_by_k);
+        os << '}';
+    }
+    os << "}}";
+    return os.str();
+}
+
+std::ostream& operator<<(std::ostream& os, const StatsSnapshot& snapshot) {
+    if (!snapshot.enabled) {
+        return os << "stats disabled (build with RS_ENABLE_STATS)\n";
+    }
+    for (std::size_t c = 0; c < snapshot.counters.size(); ++c) {
+        os << COUNTER_NAMES[c] << ": " << snapshot.counters[c] << "\n";
+    }
+    for (std::size_t i = 0; i < snapshot.endpoints.size(); ++i) {
+        const EndpointStats& e = snapshot.endpoints[i];
+        if (e.calls == 0) continue;
+        os << ENDPOINT_NAMES[i] << ": calls=" << e.calls << " mean_ns=" << e.total_ns / e.calls
+           << " p50<=" << e.latency_percentile_ns(50) << " p90<=" << e.latency_percentile_ns(90)
+           << " p99<=" << e.latency_percentile_ns(99) << "\n";
+        os << "  mean_ns by ratings:";
+        for (std::size_t b = 0; b < STATS_BUCKETS; ++b) {
+            if (e.calls_by_ratings[b] == 0) continue;
+            os << " <=" << bucket_upper_bound(b) << ":" << e.ns_by_ratings[b] / e.calls_by_ratings[b];
+        }
+        os << "\n  mean_ns by k:";
+        for (std::size_t b = 0; b < STATS_BUCKETS; ++b) {
+            if (e.calls_by_k[b] == 0) continue;
+            os << " <=" << bucket_upper_bound(b) << ":" << e.ns_by_k[b] / e.calls_by_k[b];
+        }
+        os << "\n  mean_ns by catalog size:";
+        for (std::size_t b = 0; b < STATS_BUCKETS; ++b) {
+            if (e.calls_by_catalog[b] == 0) continue;
+            os << " <=" << bucket_upper_bound(b) << ":" << e.ns_by_catalog[b] / e.calls_by_catalog[b];
+        }
+        os << "\n";
+    }
+    return os;
+}
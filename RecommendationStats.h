@@ -0,0 +1,170 @@
+#ifndef RECOMMENDATIONSTATS_H
+#define RECOMMENDATIONSTATS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+
+// Counter shards; threads are spread over them round-robin.
+#define STATS_SHARDS 32
+// Histograms use power-of-two buckets: bucket b holds values in [2^(b-1), 2^b).
+#define STATS_BUCKETS 40
+
+enum class StatsEndpoint { get_movie, add_movie, predict, content, cf, user_cf, count };
+
+enum class StatsCounter {
+    candidates_scanned,     // movies scored by a recommend call
+    similarity_evaluations, // cosines computed
+    exclusion_hits,         // candidates skipped because the user rated them
+    catalog_lookups,        // (name, year) or movie -> id resolutions
+    index_predictions,      // predictions answered from the neighbor index
+    movies_parsed,
+    users_parsed,
+    movies_parse_ns,
+    users_parse_ns,
+    count
+};
+
+const char* stats_endpoint_name(StatsEndpoint endpoint);
+const char* stats_counter_name(StatsCounter counter);
+
+typedef std::array<std::uint64_t, STATS_BUCKETS> stats_histogram;
+
+/**
+ * Calls of one endpoint. Besides the latency distribution, the total latency
+ * is broken down by (power-of-two buckets of) catalog size, rating count and
+ * k, so that mean latency can be read against each of them.
+ */
+struct EndpointStats {
+    std::uint64_t calls = 0;
+    std::uint64_t total_ns = 0;
+    stats_histogram latency_ns{};
+    stats_histogram calls_by_catalog{}, ns_by_catalog{};
+    stats_histogram calls_by_ratings{}, ns_by_ratings{};
+    stats_histogram calls_by_k{}, ns_by_k{};
+
+    // Upper bound of the bucket holding the p-th percentile latency.
+    std::uint64_t latency_percentile_ns(double p) const;
+};
+
+/**
+ * Merged view of all shards at the time stats() was called.
+ */
+struct StatsSnapshot {
+    bool enabled = false;
+    std::array<std::uint64_t, static_cast<std::size_t>(StatsCounter::count)> counters{};
+    std::array<EndpointStats, static_cast<std::size_t>(StatsEndpoint::count)> endpoints{};
+
+    std::uint64_t counter(StatsCounter c) const { return counters[static_cast<std::size_t>(c)]; }
+    const EndpointStats& endpoint(StatsEndpoint e) const {
+        return endpoints[static_cast<std::size_t>(e)];
+    }
+
+    std::string to_json() const;
+};
+
+std::ostream& operator<<(std::ostream& os, const StatsSnapshot& snapshot);
+
+/**
+ * Hot-path counters of one RecommendationSystem. Every thread writes to its
+ * own cache-line aligned shard with relaxed atomics (threads beyond the
+ * shard count share the last one); snapshot() sums the shards, so it may
+ * miss updates in flight but never blocks writers.
+ */
+class RecommendationStats {
+private:
+    struct alignas(64) Shard {
+        std::atomic<std::uint64_t> counters[static_cast<std::size_t>(StatsCounter::count)];
+        struct Endpoint {
+            std::atomic<std::uint64_t> calls, total_ns;
+            std::atomic<std::uint64_t> latency_ns[STATS_BUCKETS];
+            std::atomic<std::uint64_t> calls_by_catalog[STATS_BUCKETS], ns_by_catalog[STATS_BUCKETS];
+            std::atomic<std::uint64_t> calls_by_ratings[STATS_BUCKETS], ns_by_ratings[STATS_BUCKETS];
+            std::atomic<std::uint64_t> calls_by_k[STATS_BUCKETS], ns_by_k[STATS_BUCKETS];
+        } endpoints[static_cast<std::size_t>(StatsEndpoint::count)];
+    };
+
+    std::unique_ptr<Shard[]> shards;
+
+    Shard& local();
+
+public:
+    RecommendationStats();
+
+    void add(StatsCounter counter, std::uint64_t amount = 1);
+    void record_call(StatsEndpoint endpoint, std::uint64_t ns, std::size_t catalog_size,
+                     std::size_t ratings, std::size_t k);
+
+    StatsSnapshot snapshot() const;
+    void reset();
+};
+
+/**
+ * Times one endpoint call from construction to destruction. The call's shape
+ * (catalog size, rating count, k) is filled in once it is known.
+ */
+class StatsCallTimer {
+private:
+    RecommendationStats& stats;
+    StatsEndpoint endpoint;
+    std::chrono::steady_clock::time_point start;
+    std::size_t catalog_size = 0, ratings = 0, k = 0;
+
+public:
+    StatsCallTimer(RecommendationStats& stats, StatsEndpoint endpoint)
+        : stats(stats), endpoint(endpoint), start(std::chrono::steady_clock::now()) {}
+    ~StatsCallTimer() {
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        stats.record_call(endpoint,
+                          std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+                          catalog_size, ratings, k);
+    }
+    StatsCallTimer(const StatsCallTimer&) = delete;
+    StatsCallTimer& operator=(const StatsCallTimer&) = delete;
+
+    void set_shape(std::size_t catalog, std::size_t rating_count, std::size_t neighbors) {
+        catalog_size = catalog;
+        ratings = rating_count;
+        k = neighbors;
+    }
+};
+
+/**
+ * Adds the time from construction to destruction to a *_ns counter.
+ */
+class StatsPhaseTimer {
+private:
+    RecommendationStats& stats;
+    StatsCounter counter;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    StatsPhaseTimer(RecommendationStats& stats, StatsCounter counter)
+        : stats(stats), counter(counter), start(std::chrono::steady_clock::now()) {}
+    ~StatsPhaseTimer() {
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        stats.add(counter, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+    StatsPhaseTimer(const StatsPhaseTimer&) = delete;
+    StatsPhaseTimer& operator=(const StatsPhaseTimer&) = delete;
+};
+
+// Instrumentation points. Without RS_ENABLE_STATS they expand to nothing.
+#ifdef RS_ENABLE_STATS
+#define RS_STATS_ADD(stats, counter, amount) (stats)->add((counter), (amount))
+#define RS_STATS_CALL(stats, endpoint) StatsCallTimer rs_stats_call(*(stats), (endpoint))
+#define RS_STATS_SHAPE(catalog, ratings, k) rs_stats_call.set_shape((catalog), (ratings), (k))
+#define RS_STATS_PHASE(stats, counter) StatsPhaseTimer rs_stats_phase(*(stats), (counter))
+#else
+#define RS_STATS_ADD(stats, counter, amount) ((void)0)
+#define RS_STATS_CALL(stats, endpoint) ((void)0)
+#define RS_STATS_SHAPE(catalog, ratings, k) ((void)0)
+#define RS_STATS_PHASE(stats, counter) ((void)0)
+#endif
+
+#endif // RECOMMENDATIONSTATS_H
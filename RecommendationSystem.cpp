@@ -1,30 +1,195 @@
 #include "RecommendationSystem.h"
+#include "ContentBatch.h"
+#include "SimdKernels.h"
 #include <cmath>
 #include <algorithm>
 #include <stdexcept>
 #include <limits>
 
+// Chunks handed to the pool per worker thread, for load balancing.
+#define CHUNKS_PER_THREAD 4
 
-// Keep this unchanged - it's mathematically correct (I hope)
-double cosine_similarity(const std::vector<double>& a, const std::vector<double>& b) {
-    double dot_product = 0.0, norm_a = 0.0, norm_b = 0.0;
-    for (size_t i = 0; i < a.size(); ++i) {
-        dot_product += a[i] * b[i];
-        norm_a += a[i] * a[i];
-        norm_b += b[i] * b[i];
+// Version numbers are unique across systems, so a number identifies a version.
+static std::atomic<std::uint64_t> next_version_number{1};
+
+// Guards every system's pinned_by list and the owner of every ReaderPin.
+static std::mutex pin_registry;
+
+/**
+ * A thread's pinned version. The owning system lists the pin, so that its
+ * destructor can release the version even if the thread never reads again.
+ */
+struct RecommendationSystem::ReaderPin {
+    std::shared_ptr<const Version> version;
+    std::atomic<std::uint64_t> number{0}; // of `version`, 0 when empty
+    const RecommendationSystem* owner = nullptr;
+    unsigned depth = 0;
+
+    ~ReaderPin() {
+        std::lock_guard<std::mutex> lock(pin_registry);
+        if (owner) unlist();
+    }
+
+    // With pin_registry held.
+    void unlist() {
+        std::vector<ReaderPin*>& pins = owner->pinned_by;
+        pins.erase(std::find(pins.begin(), pins.end(), this));
+        owner = nullptr;
     }
-    if (norm_a == 0.0 || norm_b == 0.0) return 0.0;
-    return dot_product / (std::sqrt(norm_a) * std::sqrt(norm_b));
+};
+
+/**
+ * Pins the version a read runs against. The outermost read on a thread keeps
+ * its version in a thread-local pin, so as long as no writer has published
+ * since this thread's last read, starting a read only loads two atomic
+ * numbers and touches no shared reference count. An idle thread holds on to
+ * at most one stale version until its next read, its exit, or the
+ * destruction of the system the version belongs to.
+ */
+class RecommendationSystem::Reader {
+private:
+    static thread_local ReaderPin pin;
+
+    std::shared_ptr<const Version> own; // set when a nested read needs another version
+    const Version* version;
+
+    // Moves the pin to rs's latest version. The version it held is released
+    // after the registry lock, since that may free a whole catalog.
+    static void repin(const RecommendationSystem& rs) {
+        std::shared_ptr<const Version> latest = std::atomic_load(&rs.current);
+        std::uint64_t number = latest->number;
+        {
+            std::lock_guard<std::mutex> lock(pin_registry);
+            if (pin.owner != &rs) {
+                if (pin.owner) pin.unlist();
+                rs.pinned_by.push_back(&pin);
+                pin.owner = &rs;
+            }
+            pin.version.swap(latest);
+            pin.number.store(number, std::memory_order_relaxed);
+        }
+    }
+
+public:
+    explicit Reader(const RecommendationSystem& rs) {
+        // Numbers are unique across systems, so a match also means the pin
+        // belongs to rs, whose destructor is the only other writer of it.
+        std::uint64_t number = rs.current_number.load(std::memory_order_acquire);
+        if (pin.number.load(std::memory_order_relaxed) == number) {
+            version = pin.version.get();
+        } else if (pin.depth == 0) {
+            repin(rs);
+            version = pin.version.get();
+        } else {
+            own = std::atomic_load(&rs.current);
+            version = own.get();
+        }
+        ++pin.depth;
+    }
+    ~Reader() { --pin.depth; }
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+
+    const Version& operator*() const { return *version; }
+};
+
+thread_local RecommendationSystem::ReaderPin RecommendationSystem::Reader::pin;
+
+
+// Cosine between two catalog movies, through the reduced copy when it covers
+// both and otherwise from their rows, using their cached norms.
+static double version_cosine(const MovieCatalog& movies, const QuantizedFeatures* quantized,
+                             movie_id a, const double* row_a, movie_id b, const double* row_b) {
+    if (quantized && a < quantized->indexed_count() && b < quantized->indexed_count()) {
+        return cosine_from_norms(quantized->dot(a, b), movies.norm(a), movies.norm(b));
+    }
+    double dot = dot_product(row_a, row_b, movies.stride());
+    return cosine_from_norms(dot, movies.norm(a), movies.norm(b));
+}
+
+// Looks up a rated movie, failing the same way get_movie_features does.
+static movie_id require_movie_id(const MovieCatalog& movies, const sp_movie& movie) {
+    movie_id id = movies.find(movie);
+    if (id == INVALID_MOVIE_ID) {
+        throw std::runtime_error("Movie not found in recommendation system");
+    }
+    return id;
+}
+
+RecommendationSystem::RecommendationSystem() : current_number(0) {
+    auto first = std::make_shared<Version>();
+#ifdef RS_ENABLE_STATS
+    stats_data = std::make_unique<RecommendationStats>();
+    first->stats = stats_data.get();
+#endif
+    publish(std::move(first));
+}
+
+// No read of this system is running, so the pins that hold its versions are
+// idle and can be emptied from here.
+RecommendationSystem::~RecommendationSystem() {
+    std::vector<std::shared_ptr<const Version>> released;
+    std::lock_guard<std::mutex> lock(pin_registry);
+    for (ReaderPin* pin : pinned_by) {
+        pin->number.store(0, std::memory_order_relaxed);
+        released.push_back(std::move(pin->version));
+        pin->owner = nullptr;
+    }
+}
+
+std::shared_ptr<RecommendationSystem::Version> RecommendationSystem::begin_write() const {
+    return std::make_shared<Version>(*std::atomic_load(&current));
+}
+
+// Called with the writer mutex held (or before the system is shared).
+void RecommendationSystem::publish(std::shared_ptr<Version> next) {
+    std::uint64_t number = next_version_number.fetch_add(1);
+    next->number = number;
+    std::atomic_store(&current, std::shared_ptr<const Version>(std::move(next)));
+    current_number.store(number, std::memory_order_release);
+}
+
+// Swaps in a catalog built elsewhere (e.g. a mapped snapshot); indexes are dropped.
+void RecommendationSystem::replace_movies(MovieCatalog catalog) {
+    std::lock_guard<std::mutex> lock(writer);
+    std::shared_ptr<Version> next = begin_write();
+    next->movies = std::move(catalog);
+    next->similarity_index.reset();
+    next->ann_index.reset();
+    next->ann_probes = 0;
+    next->quantized.reset();
+    next->user_cf_index.reset();
+    publish(std::move(next));
 }
 
 sp_movie RecommendationSystem::recommend_by_content(const User& user) const {
-    return recommend_by_content(user.get_rank());
+    std::vector<scored_movie> best = recommend_top_n_by_content(user, 1);
+    return best.empty() ? nullptr : best.front().first;
+}
+
+MovieCatalog RecommendationSystem::get_movies() const {
+    Reader v(*this);
+    return (*v).movies;
 }
 
-const std::unordered_map<sp_movie, std::vector<double>, decltype(&sp_movie_hash), decltype(&sp_movie_equal)>& 
-RecommendationSystem::get_movies() const {
-    return movies;
+std::uint64_t RecommendationSystem::get_version() const {
+    return current_number.load(std::memory_order_acquire);
 }
+
+StatsSnapshot RecommendationSystem::stats() const {
+#ifdef RS_ENABLE_STATS
+    return stats_data->snapshot();
+#else
+    return StatsSnapshot();
+#endif
+}
+
+void RecommendationSystem::reset_stats() {
+#ifdef RS_ENABLE_STATS
+    stats_data->reset();
+#endif
+}
+
 // Add a movie to the recommendation system with its features.
 sp_movie RecommendationSystem::add_movie_to_rs(const std::string& name, int year,
                                                const std::vector<double>& features) {
@@ -34,9 +199,16 @@ sp_movie RecommendationSystem::add_movie_to_rs(const std::string& name, int year
         throw std::invalid_argument("Features cannot be empty.");
     }
 
+    std::lock_guard<std::mutex> lock(writer);
+    std::shared_ptr<const Version> latest = std::atomic_load(&current);
+    const MovieCatalog& movies = latest->movies;
+    RS_STATS_CALL(latest->stats, StatsEndpoint::add_movie);
+    RS_STATS_SHAPE(movies.size(), 0, 0);
+
     // Enforce feature size consistency (only if movies is not empty)
     if (!movies.empty()) {
-        size_t expected_size = movies.begin()->second.size();
+        size_t expected_size =
+            latest->reduction ? latest->reduction->input_dimension() : movies.dimension();
        
 
         if (features.size() != expected_size) {
@@ -46,127 +218,937 @@ sp_movie RecommendationSystem::add_movie_to_rs(const std::string& name, int year
         }
     }
 
-    sp_movie existing_movie = get_movie(name, year);
-    if (existing_movie) {
-       
-        return existing_movie;
+    movie_id existing_id = movies.find(name, year);
+    if (existing_id != INVALID_MOVIE_ID) {
+        return movies.movie(existing_id);
     }
 
-    auto movie = std::make_shared<Movie>(name, year);
-    movies[movie] = features;
-
-   
+    // The new row goes past the end of every published catalog, so readers
+    // of the current version are not disturbed while it is written.
+    std::shared_ptr<Version> next = begin_write();
+    movie_id id;
+    if (next->reduction) {
+        if (!next->original_movies.empty()) {
+            next->original_movies.add(name, year, features);
+        }
+        id = next->movies.add(name, year, next->reduction->project(features));
+    } else {
+        id = next->movies.add(name, year, features);
+    }
+    if (next->similarity_index) {
+        auto index = std::make_shared<SimilarityIndex>(*next->similarity_index);
+        index->add_movie(next->movies, id);
+        next->similarity_index = std::move(index);
+    }
+    sp_movie movie = next->movies.movie(id);
+    publish(std::move(next));
     return movie;
 }
 
-sp_movie RecommendationSystem::get_movie(const std::string& name, int year) const {
+void RecommendationSystem::enable_similarity_index(std::size_t neighbors_per_movie,
+                                                   std::size_t memory_budget_bytes) {
+    std::lock_guard<std::mutex> lock(writer);
+    std::shared_ptr<Version> next = begin_write();
+    auto index = std::make_shared<SimilarityIndex>(neighbors_per_movie, memory_budget_bytes);
+    index->build(next->movies, next->executor.get());
+    next->similarity_index = std::move(index);
+    publish(std::move(next));
+}
+
+void RecommendationSystem::disable_similarity_index() {
+    std::lock_guard<std::mutex> lock(writer);
+    std::shared_ptr<Version> next = begin_write();
+    next->similarity_index.reset();
+    publish(std::move(next));
+}
+
+std::shared_ptr<const SimilarityIndex> RecommendationSystem::get_similarity_index() const {
+    Reader v(*this);
+    return (*v).similarity_index;
+}
+
+void RecommendationSystem::enable_ann_index(const AnnOptions& options) {
+    std::lock_guard<std::mutex> lock(writer);
+    std::shared_ptr<Version> next = begin_write();
+    auto index = std::make_shared<AnnIndex>();
+    index->build(next->movies, options);
+    next->ann_index = std::move(index);
+    next->ann_probes = std::max<std::size_t>(1, options.probes);
+    publish(std::move(next));
+}
+
+void RecommendationSystem::disable_ann_index() {
+    std::lock_guard<std::mutex> lock(writer);
+    std::shared_ptr<Version> next = begin_write();
+    next->ann_index.reset();
+    next->ann_probes = 0;
+    publish(std::move(next));
+}
+
+std::shared_ptr<const AnnIndex> RecommendationSystem::get_ann_index() const {
+    Reader v(*this);
+    return (*v).ann_index;
+}
+
+void RecommendationSystem::enable_user_cf(const std::vector<User>& users) {
+    std::lock_guard<std::mutex> lock(writer);
+    std::shared_ptr<Version> next = begin_write();
+    auto index = std::make_shared<UserCfIndex>();
+    for (const User& user : users) {
+        index->add_user(user.get_name(), ratings_of(*next, user));
+    }
+    next->user_cf_index = std::move(index);
+    publish(std::move(next));
+}
+
+void RecommendationSystem::enable_user_cf(const RatingsMatrix& matrix) {
+    std::lock_guard<std::mutex> lock(writer);
+    std::shared_ptr<Version> next = begin_write();
+    std::vector<movie_id> columns(matrix.movie_count());
+    for (std::size_t column = 0; column < columns.size(); ++column) {
+        columns[column] = next->movies.find(matrix.movie(column).name, matrix.movie(column).year);
+    }
+    auto index = std::make_shared<UserCfIndex>();
+    rated_list rated;
+    for (std::size_t user = 0; user < matrix.user_count(); ++user) {
+        rated.clear();
+        for (const RatingEntry& entry : matrix.row(user)) {
+            if (entry.index >= columns.size() || columns[entry.index] == INVALID_MOVIE_ID) {
+                throw std::runtime_error("Movie not found in recommendation system");
+            }
+            rated.emplace_back(columns[entry.index], entry.rating);
+        }
+        std::sort(rated.begin(), rated.end());
+        index->add_user(std::string(matrix.user_name(user)), rated);
+    }
+    next->user_cf_index = std::move(index);
+    publish(std::move(next));
+}
+
+void RecommendationSystem::disable_user_cf() {
+    std::lock_guard<std::mutex> lock(writer);
+    std::shared_ptr<Version> next = begin_write();
+    next->user_cf_index.reset();
+    publish(std::move(next));
+}
+
+std::shared_ptr<const UserCfIndex> RecommendationSystem::get_user_cf_index() const {
+    Reader v(*this);
+    return (*v).user_cf_index;
+}
 
-    auto temp_movie = std::make_shared<Movie>(name, year);
-    auto it = movies.find(temp_movie);
-    return (it != movies.end()) ? it->first : nullptr;
+void RecommendationSystem::enable_result_cache(std::size_t capacity) {
+    std::lock_guard<std::mutex> lock(writer);
+    std::shared_ptr<Version> next = begin_write();
+    next->result_cache = std::make_shared<ResultCache>(capacity);
+    publish(std::move(next));
 }
 
-const std::vector<double>& RecommendationSystem::get_movie_features(const sp_movie& movie) const {
-    auto it = movies.find(movie);
-    if (it == movies.end()) {
+void RecommendationSystem::disable_result_cache() {
+    std::lock_guard<std::mutex> lock(writer);
+    std::shared_ptr<Version> next = begin_write();
+    next->result_cache.reset();
+    publish(std::move(next));
+}
+
+ResultCacheStats RecommendationSystem::result_cache_stats() const {
+    Reader v(*this);
+    return (*v).result_cache ? (*v).result_cache->stats() : ResultCacheStats();
+}
+
+void RecommendationSystem::set_feature_storage(FeatureStorage storage) {
+    std::lock_guard<std::mutex> lock(writer);
+    std::shared_ptr<Version> next = begin_write();
+    if (storage == FeatureStorage::float64) {
+        next->quantized.reset();
+    } else {
+        auto quantized = std::make_shared<QuantizedFeatures>();
+        quantized->build(next->movies, storage);
+        next->quantized = std::move(quantized);
+    }
+    publish(std::move(next));
+}
+
+FeatureStorage RecommendationSystem::get_feature_storage() const {
+    Reader v(*this);
+    return (*v).quantized ? (*v).quantized->storage() : FeatureStorage::float64;
+}
+
+std::shared_ptr<const QuantizedFeatures> RecommendationSystem::get_quantized_features() const {
+    Reader v(*this);
+    return (*v).quantized;
+}
+
+void RecommendationSystem::reduce_features(std::shared_ptr<const FeatureReduction> reduction,
+                                           bool keep_original) {
+    if (!reduction) {
+        throw std::invalid_argument("No feature reduction given");
+    }
+    std::lock_guard<std::mutex> lock(writer);
+    std::shared_ptr<Version> next = begin_write();
+    if (next->reduction) {
+        throw std::logic_error("The features are already reduced");
+    }
+    MovieCatalog projected = reduction->project(next->movies);
+    next->original_movies = keep_original ? next->movies : MovieCatalog();
+    next->movies = std::move(projected);
+    next->reduction = std::move(reduction);
+    next->similarity_index.reset();
+    next->ann_index.reset();
+    next->ann_probes = 0;
+    next->quantized.reset();
+    publish(std::move(next));
+}
+
+void RecommendationSystem::restore_features() {
+    std::lock_guard<std::mutex> lock(writer);
+    std::shared_ptr<Version> next = begin_write();
+    if (!next->reduction) {
+        throw std::logic_error("The features are not reduced");
+    }
+    if (next->original_movies.size() != next->movies.size()) {
+        throw std::logic_error("The full-width features were not kept");
+    }
+    next->movies = std::move(next->original_movies);
+    next->original_movies = MovieCatalog();
+    next->reduction.reset();
+    next->similarity_index.reset();
+    next->ann_index.reset();
+    next->ann_probes = 0;
+    next->quantized.reset();
+    publish(std::move(next));
+}
+
+std::shared_ptr<const FeatureReduction> RecommendationSystem::get_feature_reduction() const {
+    Reader v(*this);
+    return (*v).reduction;
+}
+
+PagerStats RecommendationSystem::get_paging_stats() const {
+    Reader v(*this);
+    FeaturePager* pager = (*v).movies.pager();
+    return pager ? pager->stats() : PagerStats();
+}
+
+void RecommendationSystem::set_executor(std::shared_ptr<ThreadPool> pool, std::size_t threshold) {
+    std::lock_guard<std::mutex> lock(writer);
+    std::shared_ptr<Version> next = begin_write();
+    next->executor = std::move(pool);
+    next->parallel_threshold = threshold;
+    publish(std::move(next));
+}
+
+std::shared_ptr<ThreadPool> RecommendationSystem::get_executor() const {
+    Reader v(*this);
+    return (*v).executor;
+}
+
+sp_movie RecommendationSystem::get_movie(std::string_view name, int year) const {
+    Reader v(*this);
+    const MovieCatalog& movies = (*v).movies;
+    RS_STATS_CALL((*v).stats, StatsEndpoint::get_movie);
+    RS_STATS_SHAPE(movies.size(), 0, 0);
+    RS_STATS_ADD((*v).stats, StatsCounter::catalog_lookups, 1);
+    movie_id id = movies.find(name, year);
+    return (id != INVALID_MOVIE_ID) ? movies.movie(id) : nullptr;
+}
+
+FeatureView RecommendationSystem::get_movie_features(const sp_movie& movie) const {
+    Reader v(*this);
+    const MovieCatalog& movies = (*v).movies;
+    movie_id id = movies.find(movie);
+    if (id == INVALID_MOVIE_ID) {
         throw std::runtime_error("Movie not found in recommendation system");
     }
-    return it->second;
+    return movies.features_of(id);
+}
+
+RecommendationSystem::rated_list
+RecommendationSystem::resolve_ratings(const Version& v, const rank_map& user_ratings) {
+    rated_list rated;
+    rated.reserve(user_ratings.size());
+    for (const auto& [movie, rating] : user_ratings) {
+        rated.emplace_back(require_movie_id(v.movies, movie), rating);
+    }
+    RS_STATS_ADD(v.stats, StatsCounter::catalog_lookups, rated.size());
+    std::sort(rated.begin(), rated.end());
+    return rated;
+}
+
+RecommendationSystem::rated_list RecommendationSystem::ratings_of(const Version& v,
+                                                                  const User& user) {
+    if (user.get_storage() == RatingStorage::map) {
+        return resolve_ratings(v, user.get_rank());
+    }
+    // Compact ratings are already resolved and sorted.
+    rated_list rated;
+    rated.reserve(user.get_compact_ratings().size());
+    for (const CompactRating& entry : user.get_compact_ratings()) {
+        if (entry.id >= v.movies.size()) {
+            throw std::runtime_error("Movie not found in recommendation system");
+        }
+        rated.emplace_back(entry.id, entry.rating);
+    }
+    return rated;
+}
+
+static movie_id id_of(const std::pair<movie_id, double>& entry) { return entry.first; }
+static movie_id id_of(const CompactRating& entry) { return entry.id; }
+static movie_id id_of(movie_id id) { return id; }
+
+// Cursor over a range sorted by id (a rated_list, compact ratings or plain
+// ids) that answers "is this id rated?" for increasing ids in amortized O(1).
+template <typename Iterator>
+class RatedCursor {
+private:
+    Iterator next, last;
+
+public:
+    RatedCursor(Iterator first, Iterator last, movie_id first_id)
+        : next(std::lower_bound(first, last, first_id,
+                                [](const auto& entry, movie_id key) { return id_of(entry) < key; })),
+          last(last) {}
+
+    template <typename Container>
+    RatedCursor(const Container& rated, movie_id first_id)
+        : RatedCursor(rated.begin(), rated.end(), first_id) {}
+
+    bool skip(movie_id id) {
+        while (next != last && id_of(*next) < id) ++next;
+        return next != last && id_of(*next) == id;
+    }
+};
+
+template <typename Container>
+RatedCursor(const Container&, movie_id) -> RatedCursor<typename Container::const_iterator>;
+
+static const double* find_rating(const std::vector<std::pair<movie_id, double>>& rated,
+                                 movie_id id) {
+    auto it = std::lower_bound(rated.begin(), rated.end(), id,
+                               [](const auto& entry, movie_id key) { return entry.first < key; });
+    return (it != rated.end() && it->first == id) ? &it->second : nullptr;
+}
+
+// Resolves a request's filter against the catalog, with the user's rated
+// movies blocked as well; nullptr when the request has no filter.
+template <typename RatedIterator>
+static std::unique_ptr<CandidateFilter> filter_of(const MovieCatalog& movies,
+                                                  const RecommendationFilter* filter,
+                                                  RatedIterator rated_begin, RatedIterator rated_end) {
+    if (!filter) {
+        return nullptr;
+    }
+    auto candidates = std::make_unique<CandidateFilter>(movies, *filter);
+    for (RatedIterator it = rated_begin; it != rated_end; ++it) {
+        candidates->block(id_of(*it));
+    }
+    return candidates;
+}
+
+// Answers from the cache when there is one, computing and storing on a miss.
+template <typename Compute>
+static CachedResult through_cache(ResultCache* cache, const ResultKey& key, Compute&& compute) {
+    CachedResult result;
+    if (cache && cache->find(key, result)) {
+        return result;
+    }
+    result = compute();
+    if (cache) {
+        cache->insert(key, result);
+    }
+    return result;
+}
+
+std::vector<scored_movie> RecommendationSystem::to_scored_movies(const Version& v, TopN& best) {
+    std::vector<scored_movie> result;
+    for (const ScoredId& entry : best.take_sorted()) {
+        result.emplace_back(v.movies.movie(entry.id), entry.score);
+    }
+    return result;
+}
+
+// Scores every catalog id through score_range and keeps the best n. With an
+// executor and enough work the id range is cut into chunks scored in
+// parallel; merging the per-chunk selections gives the serial result
+// because TopN orders candidates by (score, id).
+TopN RecommendationSystem::scan_candidates(
+        const Version& v, std::size_t n, std::size_t work_per_candidate,
+        const std::function<void(movie_id, movie_id, TopN&)>& score_range) {
+    movie_id count = static_cast<movie_id>(v.movies.size());
+    const std::shared_ptr<ThreadPool>& executor = v.executor;
+    n = std::min<std::size_t>(n, count);
+    TopN best(n, count);
+    if (!executor || count * std::max<std::size_t>(1, work_per_candidate) < v.parallel_threshold) {
+        score_range(0, count, best);
+        return best;
+    }
+
+    // A chunk cannot contribute more candidates than it holds.
+    std::size_t chunks = std::min<std::size_t>(count, executor->size() * CHUNKS_PER_THREAD);
+    std::vector<TopN> partial;
+    partial.reserve(chunks);
+    for (std::size_t chunk = 0; chunk < chunks; ++chunk) {
+        std::size_t length = count * (chunk + 1) / chunks - count * chunk / chunks;
+        partial.emplace_back(std::min(n, length), length);
+    }
+    executor->parallel_for(chunks, [&](std::size_t chunk) {
+        movie_id begin = static_cast<movie_id>(count * chunk / chunks);
+        movie_id end = static_cast<movie_id>(count * (chunk + 1) / chunks);
+        score_range(begin, end, partial[chunk]);
+    });
+    for (const TopN& selection : partial) {
+        best.merge(selection);
+    }
+    return best;
 }
 
 sp_movie RecommendationSystem::recommend_by_content(const rank_map& user_ratings) const {
+    std::vector<scored_movie> best = recommend_top_n_by_content(user_ratings, 1);
+    return best.empty() ? nullptr : best.front().first;
+}
+
+std::vector<scored_movie> RecommendationSystem::recommend_top_n_by_content(const User& user,
+                                                                           int n) const {
+    Reader v(*this);
+    RS_STATS_CALL((*v).stats, StatsEndpoint::content);
+    RS_STATS_SHAPE((*v).movies.size(), user.get_preference().size(), n);
+    ResultKey key{user.get_uid(), user.get_rating_version(), (*v).number,
+                  static_cast<std::uint64_t>(n), 0, CachedCall::content};
+    return through_cache((*v).result_cache.get(), key, [&] {
+        CachedResult result;
+        result.movies = top_n_by_content(*v, user, n, (*v).ann_probes);
+        return result;
+    }).movies;
+}
+
+std::vector<scored_movie>
+RecommendationSystem::recommend_top_n_by_content(const User& user, int n,
+                                                 const RecommendationFilter& filter) const {
+    Reader v(*this);
+    RS_STATS_CALL((*v).stats, StatsEndpoint::content);
+    RS_STATS_SHAPE((*v).movies.size(), user.get_preference().size(), n);
+    return top_n_by_content(*v, user, n, (*v).ann_probes, &filter);
+}
+
+std::vector<scored_movie>
+RecommendationSystem::recommend_top_n_by_content(const rank_map& user_ratings, int n) const {
+    Reader v(*this);
+    RS_STATS_CALL((*v).stats, StatsEndpoint::content);
+    rated_list rated = resolve_ratings(*v, user_ratings);
+    RS_STATS_SHAPE((*v).movies.size(), rated.size(), n);
+    std::vector<double> preference_vector;
+    double preference_norm = preference_of(*v, rated, preference_vector);
+    return top_n_by_content(*v, rated.begin(), rated.end(), preference_vector.data(),
+                            preference_norm, n, (*v).ann_probes, nullptr);
+}
+
+std::vector<scored_movie>
+RecommendationSystem::recommend_top_n_by_content_exact(const User& user, int n) const {
+    Reader v(*this);
+    RS_STATS_CALL((*v).stats, StatsEndpoint::content);
+    RS_STATS_SHAPE((*v).movies.size(), user.get_preference().size(), n);
+    return top_n_by_content(*v, user, n, 0);
+}
+
+std::vector<scored_movie>
+RecommendationSystem::recommend_top_n_by_content_ann(const User& user, int n,
+                                                     std::size_t probes) const {
+    Reader v(*this);
+    if (!(*v).ann_index) {
+        throw std::logic_error("No ANN index enabled");
+    }
+    RS_STATS_CALL((*v).stats, StatsEndpoint::content);
+    RS_STATS_SHAPE((*v).movies.size(), user.get_preference().size(), n);
+    return top_n_by_content(*v, user, n, std::max<std::size_t>(1, probes));
+}
+
+std::vector<std::vector<scored_movie>>
+RecommendationSystem::recommend_top_n_by_content_batch(const std::vector<User>& users,
+                                                       int n) const {
+    std::vector<const User*> pointers;
+    pointers.reserve(users.size());
+    for (const User& user : users) pointers.push_back(&user);
+    return recommend_top_n_by_content_batch(pointers, n);
+}
+
+std::vector<std::vector<scored_movie>>
+RecommendationSystem::recommend_top_n_by_content_batch(const std::vector<const User*>& users,
+                                                       int n) const {
+    Reader v(*this);
+    const MovieCatalog& movies = (*v).movies;
+    RS_STATS_CALL((*v).stats, StatsEndpoint::content);
+    RS_STATS_SHAPE(movies.size(), users.size(), n);
+    std::vector<std::vector<scored_movie>> result(users.size());
+    if (movies.empty() || n <= 0) {
+        return result;
+    }
+
+    ContentBatch batch(movies.stride());
+    std::vector<double> preference_vector;
+    std::vector<movie_id> rated_ids;
+    for (const User* user : users) {
+        double preference_norm = content_query(*v, *user, preference_vector, rated_ids);
+        batch.add(preference_vector.data(), preference_norm, rated_ids.begin(), rated_ids.end());
+    }
+
+    RS_STATS_ADD((*v).stats, StatsCounter::similarity_evaluations, movies.size() * users.size());
+    std::vector<TopN> best = batch.score(movies, static_cast<std::size_t>(n), (*v).executor.get());
+    for (std::size_t i = 0; i < users.size(); ++i) {
+        result[i] = to_scored_movies(*v, best[i]);
+    }
+    return result;
+}
+
+// Fills the (stride padded) preference vector: the sum of the rated movies'
+// features weighted by rating minus the user's average. Returns its norm.
+double RecommendationSystem::preference_of(const Version& v, const rated_list& rated,
+                                           std::vector<double>& preference_vector) {
+    const MovieCatalog& movies = v.movies;
     double average = 0.0;
-    for (const auto& [movie, rating] : user_ratings) {
+    for (const auto& [rated_id, rating] : rated) {
         average += rating;
     }
-    average /= user_ratings.size();
+    average /= rated.size();
 
-    std::vector<double> preference_vector(movies.begin()->second.size(), 0.0);
-    for (const auto& [movie, rating] : user_ratings) {
-        const auto& features = get_movie_features(movie);
+    preference_vector.assign(movies.stride(), 0.0);
+    RowCursor rows(movies);
+    for (const auto& [rated_id, rating] : rated) {
+        const double* features = rows.row(rated_id);
         double adjusted_rating = rating - average;
-        for (size_t i = 0; i < features.size(); ++i) {
+        for (size_t i = 0; i < movies.dimension(); ++i) {
             preference_vector[i] += adjusted_rating * features[i];
         }
     }
 
-    // Find best movie
-    double max_similarity = -std::numeric_limits<double>::infinity();
-    sp_movie best_movie = nullptr;
+    return std::sqrt(dot_product(preference_vector.data(), preference_vector.data(),
+                                 movies.stride()));
+}
+
+// The preference and exclusions top_n_by_content scores the user with, as
+// plain arrays: the (stride padded) preference and the rated ids inside this
+// version's catalog, sorted. Returns the preference norm.
+double RecommendationSystem::content_query(const Version& v, const User& user,
+                                           std::vector<double>& preference_vector,
+                                           std::vector<movie_id>& rated_ids) {
+    const MovieCatalog& movies = v.movies;
+    auto take_ids = [&](auto begin, auto end) {
+        rated_ids.clear();
+        for (auto it = begin; it != end && id_of(*it) < movies.size(); ++it) {
+            rated_ids.push_back(id_of(*it));
+        }
+    };
+    const UserPreference& preference = user.get_preference();
+    double preference_norm;
+    if (projects_preference(v, preference)) {
+        preference_norm = project_preference(v, preference, preference_vector);
+    } else if (!preference.is_valid() || preference.size() == 0 ||
+               preference.dimension() != movies.dimension()) {
+        rated_list rated = ratings_of(v, user);
+        take_ids(rated.begin(), rated.end());
+        return preference_of(v, rated, preference_vector);
+    } else {
+        preference_vector.assign(preference.data(), preference.data() + movies.stride());
+        preference_norm = preference.norm();
+    }
+    if (user.get_storage() == RatingStorage::compact) {
+        const CompactRatings& rated = user.get_compact_ratings();
+        take_ids(rated.begin(), rated.end());
+    } else {
+        const std::vector<movie_id>& rated = user.get_rated_ids();
+        take_ids(rated.begin(), rated.end());
+    }
+    return preference_norm;
+}
+
+// A preference maintained over the full-width rows of a reduced catalog.
+bool RecommendationSystem::projects_preference(const Version& v,
+                                               const UserPreference& preference) {
+    return v.reduction && preference.is_valid() && preference.size() != 0 &&
+           preference.dimension() == v.reduction->input_dimension();
+}
 
-    for (const auto& [movie, features] : movies) {
-        if (user_ratings.count(movie)) continue;
+// The projection is linear, so projecting the maintained preference gives the
+// preference over the projected rows without looking up any rating.
+double RecommendationSystem::project_preference(const Version& v,
+                                                const UserPreference& preference,
+                                                std::vector<double>& preference_vector) {
+    preference_vector.assign(v.movies.stride(), 0.0);
+    v.reduction->project(preference.data(), preference_vector.data());
+    return std::sqrt(dot_product(preference_vector.data(), preference_vector.data(),
+                                 v.movies.stride()));
+}
 
-        double similarity = cosine_similarity(preference_vector, features);
-        
-        if (similarity > max_similarity) {
-            max_similarity = similarity;
-            best_movie = movie;
+// Uses the preference the user maintains when it covers this catalog (or
+// projects to it), so no rating is looked up; otherwise it is rebuilt from
+// the ratings.
+std::vector<scored_movie> RecommendationSystem::top_n_by_content(const Version& v, const User& user,
+                                                                 int n, std::size_t probes,
+                                                                 const RecommendationFilter* filter) {
+    const UserPreference& preference = user.get_preference();
+    const double* preference_data = preference.data();
+    double preference_norm = preference.norm();
+    std::vector<double> preference_vector;
+    if (projects_preference(v, preference)) {
+        preference_norm = project_preference(v, preference, preference_vector);
+        preference_data = preference_vector.data();
+    } else if (!preference.is_valid() || preference.size() == 0 ||
+               preference.dimension() != v.movies.dimension()) {
+        rated_list rated = ratings_of(v, user);
+        preference_norm = preference_of(v, rated, preference_vector);
+        return top_n_by_content(v, rated.begin(), rated.end(), preference_vector.data(),
+                                preference_norm, n, probes, filter);
+    }
+    if (user.get_storage() == RatingStorage::compact) {
+        const CompactRatings& rated = user.get_compact_ratings();
+        return top_n_by_content(v, rated.begin(), rated.end(), preference_data, preference_norm,
+                                n, probes, filter);
+    }
+    const std::vector<movie_id>& rated = user.get_rated_ids();
+    return top_n_by_content(v, rated.begin(), rated.end(), preference_data, preference_norm, n,
+                            probes, filter);
+}
+
+// probes > 0 answers from the ANN index: only the probed clusters and the
+// movies added after the index was built are scored.
+template <typename RatedIterator>
+std::vector<scored_movie> RecommendationSystem::top_n_by_content(
+    const Version& v, RatedIterator rated_begin, RatedIterator rated_end,
+    const double* preference_vector, double preference_norm, int n, std::size_t probes,
+    const RecommendationFilter* filter) {
+    const MovieCatalog& movies = v.movies;
+    const AnnIndex* ann_index = v.ann_index.get();
+    if (movies.empty() || n <= 0) {
+        return {};
+    }
+    // Ids from a newer catalog than this version's are never candidates here.
+    [[maybe_unused]] std::size_t rated_count =
+        std::lower_bound(rated_begin, rated_end, movies.size(),
+                         [](const auto& entry, std::size_t key) { return id_of(entry) < key; }) -
+        rated_begin;
+    std::unique_ptr<CandidateFilter> candidates = filter_of(movies, filter, rated_begin, rated_end);
+
+    const QuantizedFeatures* quantized = v.quantized.get();
+    QuantizedFeatures::Query query;
+    movie_id quantized_end = 0;
+    if (quantized) {
+        quantized->prepare(preference_vector, query);
+        quantized_end = quantized->indexed_count();
+    }
+
+    // One RowCursor per scanning thread.
+    auto score = [&](RowCursor& rows, movie_id id, TopN& selection) {
+        double dot = (id < quantized_end)
+            ? quantized->dot(query, id)
+            : dot_product(preference_vector, rows.row(id), movies.stride());
+        selection.push(cosine_from_norms(dot, preference_norm, movies.norm(id)), id);
+    };
+
+    if (probes > 0 && ann_index) {
+        TopN best(static_cast<size_t>(n), movies.size());
+        RowCursor rows(movies);
+        std::size_t visited = 0, scored = 0;
+        auto visit = [&](RatedCursor<RatedIterator>& is_rated, movie_id id) {
+            ++visited;
+            if (candidates ? candidates->accepts(id) : !is_rated.skip(id)) {
+                score(rows, id, best);
+                ++scored;
+            }
+        };
+        for (const std::vector<movie_id>* list : ann_index->probe(preference_vector, probes)) {
+            RatedCursor is_rated(rated_begin, rated_end, 0);
+            for (movie_id id : *list) visit(is_rated, id);
         }
+        RatedCursor is_rated(rated_begin, rated_end, ann_index->indexed_count());
+        for (movie_id id = ann_index->indexed_count(); id < movies.size(); ++id) visit(is_rated, id);
+
+        RS_STATS_ADD(v.stats, StatsCounter::candidates_scanned, scored);
+        RS_STATS_ADD(v.stats, StatsCounter::similarity_evaluations, scored);
+        RS_STATS_ADD(v.stats, StatsCounter::exclusion_hits, visited - scored);
+        return to_scored_movies(v, best);
+    }
+
+    if (candidates) {
+        TopN best = scan_candidates(v, static_cast<size_t>(n), 1,
+                                    [&](movie_id begin, movie_id end, TopN& selection) {
+            RowCursor rows(movies);
+            [[maybe_unused]] std::size_t scored = 0;
+            candidates->for_each_candidate(begin, end, [&](movie_id id) {
+                score(rows, id, selection);
+                ++scored;
+            });
+            RS_STATS_ADD(v.stats, StatsCounter::candidates_scanned, scored);
+            RS_STATS_ADD(v.stats, StatsCounter::similarity_evaluations, scored);
+            RS_STATS_ADD(v.stats, StatsCounter::exclusion_hits, end - begin - scored);
+        });
+        return to_scored_movies(v, best);
     }
 
-    return best_movie;
+    // Every rated movie is in the catalog, so the full scan skips exactly those.
+    RS_STATS_ADD(v.stats, StatsCounter::candidates_scanned, movies.size() - rated_count);
+    RS_STATS_ADD(v.stats, StatsCounter::similarity_evaluations, movies.size() - rated_count);
+    RS_STATS_ADD(v.stats, StatsCounter::exclusion_hits, rated_count);
+
+    // Find best movies
+    TopN best = scan_candidates(v, static_cast<size_t>(n), 1,
+                                [&](movie_id begin, movie_id end, TopN& selection) {
+        RowCursor rows(movies);
+        RatedCursor is_rated(rated_begin, rated_end, begin);
+        for (movie_id id = begin; id < end; ++id) {
+            if (!is_rated.skip(id)) score(rows, id, selection);
+        }
+    });
+
+    return to_scored_movies(v, best);
 }
 
 double RecommendationSystem::predict_movie_score(const User& user,
                                                 const sp_movie& movie, int k) const {
+    Reader v(*this);
+    RS_STATS_CALL((*v).stats, StatsEndpoint::predict);
+    RS_STATS_SHAPE((*v).movies.size(), user.get_preference().size(), k);
+    ResultCache* cache = (*v).result_cache.get();
+    // A movie outside the catalog is not cached; predict_for_user reports it.
+    movie_id target_id = cache ? (*v).movies.find(movie) : INVALID_MOVIE_ID;
+    ResultKey key{user.get_uid(), user.get_rating_version(), (*v).number, target_id, k,
+                  CachedCall::predict};
+    return through_cache(target_id != INVALID_MOVIE_ID ? cache : nullptr, key, [&] {
+        CachedResult result;
+        result.score = predict_for_user(*v, user, movie, k);
+        return result;
+    }).score;
+}
+
+double RecommendationSystem::predict_for_user(const Version& v, const User& user,
+                                              const sp_movie& movie, int k) {
     // Get the user's ratings from the User object
-    const auto& user_ratings = user.get_rank();
-    if (user_ratings.empty()) {
-    throw std::invalid_argument("User has no ratings");
+    rated_list rated = ratings_of(v, user);
+    if (rated.empty()) {
+        throw std::invalid_argument("User has no ratings");
+    }
+    movie_id target_id = require_movie_id(v.movies, movie);
+    RS_STATS_ADD(v.stats, StatsCounter::catalog_lookups, 1);
+    const double* own_rating = find_rating(rated, target_id);
+    if (own_rating) {
+        return *own_rating;
+    }
+
+    similarity_list similarities;
+    RowCursor rows(v.movies);
+    return predict_by_id(v, rated, pin_rated(v, rated), target_id, rows, k, similarities);
 }
-    if (user_ratings.find(movie) != user_ratings.end()) {
-        return user_ratings.at(movie);
+
+// The rows of the rated movies, read once per query rather than per candidate.
+PinnedRows RecommendationSystem::pin_rated(const Version& v, const rated_list& rated) {
+    PinnedRows rows(v.movies);
+    rows.reserve(rated.size());
+    for (const auto& entry : rated) {
+        rows.push_back(entry.first);
     }
+    return rows;
+}
 
-    const auto& target_features = get_movie_features(movie);
-    std::vector<std::pair<double, sp_movie>> similarities;
+// Weighted average of the user's ratings over the k rated movies most similar
+// to the (unrated) target. Only the top k are selected, not the whole list sorted.
+double RecommendationSystem::predict_by_id(const Version& v, const rated_list& rated,
+                                           const PinnedRows& rated_rows, movie_id target_id,
+                                           RowCursor& rows, int k,
+                                           similarity_list& similarities) {
+    if (k < 0) {
+        throw std::invalid_argument("k must not be negative");
+    }
+    double indexed_score;
+    if (v.similarity_index && predict_from_index(v, rated, target_id, k, indexed_score)) {
+        RS_STATS_ADD(v.stats, StatsCounter::index_predictions, 1);
+        return indexed_score;
+    }
+    RS_STATS_ADD(v.stats, StatsCounter::similarity_evaluations, rated.size());
 
     //similarities
-    for (const auto& [rated_movie, rating] : user_ratings) {
-        const auto& rated_features = get_movie_features(rated_movie);
-        double similarity = cosine_similarity(target_features, rated_features);
-        similarities.emplace_back(similarity, rated_movie);
+    similarities.clear();
+    const double* target_row = rows.row(target_id);
+    for (std::size_t i = 0; i < rated.size(); ++i) {
+        similarities.emplace_back(version_cosine(v.movies, v.quantized.get(), target_id,
+                                                 target_row, rated[i].first, rated_rows[i]),
+                                  rated[i].second);
     }
 
-    std::sort(similarities.begin(), similarities.end(),
-              [](const auto& a, const auto& b) { return a.first > b.first; });
+    return top_k_average(similarities, k);
+}
 
-    k = std::min(k, static_cast<int>(similarities.size()));
-    similarities.resize(k);
+// The ratings of the k most similar movies averaged with their similarities
+// as weights, 0 when those similarities sum to 0. Reorders `similarities`.
+double RecommendationSystem::top_k_average(similarity_list& similarities, int k) {
+    auto top_end = similarities.begin() + std::min<size_t>(k, similarities.size());
+    std::partial_sort(similarities.begin(), top_end, similarities.end(),
+                      [](const auto& a, const auto& b) { return a.first > b.first; });
 
     double numerator = 0.0, denominator = 0.0;
-    for (const auto& [similarity, rated_movie] : similarities) {
-        numerator += similarity * user_ratings.at(rated_movie);
-        denominator += similarity;
+    for (auto it = similarities.begin(); it != top_end; ++it) {
+        numerator += it->first * it->second;
+        denominator += it->first;
     }
 
     return (denominator == 0.0) ? 0.0 : numerator / denominator;
 }
 
+// Walks the target's neighbor list, most similar first, picking the movies the
+// user rated. The pick is the exact top-k when k rated movies are found, or
+// when the list covers the whole catalog; otherwise the caller falls back.
+bool RecommendationSystem::predict_from_index(const Version& v, const rated_list& rated,
+                                              movie_id target_id, int k, double& score) {
+    if (k <= 0) {
+        return false;
+    }
+    const auto& neighbors = v.similarity_index->neighbors_of(target_id);
+    double numerator = 0.0, denominator = 0.0;
+    int found = 0;
+    for (const Neighbor& neighbor : neighbors) {
+        const double* rating = find_rating(rated, neighbor.id);
+        if (!rating) continue;
+        numerator += neighbor.similarity * *rating;
+        denominator += neighbor.similarity;
+        if (++found == k) break;
+    }
+    if (found < k && neighbors.size() + 1 < v.movies.size()) {
+        return false;
+    }
+    score = (denominator == 0.0) ? 0.0 : numerator / denominator;
+    return true;
+}
+
 sp_movie RecommendationSystem::recommend_by_cf(const User& user, int k) const {
-    const auto& user_ratings = user.get_rank(); // Get ratings from User
-    double max_score = -std::numeric_limits<double>::infinity();
-    sp_movie best_movie = nullptr;
-
-    for (const auto& [movie, features] : movies) {
-        if (user_ratings.find(movie) == user_ratings.end()) { 
-            double score = predict_movie_score(user, movie, k); 
-            if (score > max_score) {
-                max_score = score;
-                best_movie = movie;
-            }
+    std::vector<scored_movie> best = recommend_top_n_by_cf(user, k, 1);
+    return best.empty() ? nullptr : best.front().first;
+}
+
+std::vector<scored_movie> RecommendationSystem::recommend_top_n_by_cf(const User& user, int k,
+                                                                      int n) const {
+    Reader v(*this);
+    RS_STATS_CALL((*v).stats, StatsEndpoint::cf);
+    RS_STATS_SHAPE((*v).movies.size(), user.get_preference().size(), k);
+    ResultKey key{user.get_uid(), user.get_rating_version(), (*v).number,
+                  static_cast<std::uint64_t>(n), k, CachedCall::cf};
+    return through_cache((*v).result_cache.get(), key, [&] {
+        CachedResult result;
+        result.movies = top_n_by_cf(*v, user, k, n);
+        return result;
+    }).movies;
+}
+
+std::vector<scored_movie> RecommendationSystem::recommend_top_n_by_cf(
+    const User& user, int k, int n, const RecommendationFilter& filter) const {
+    Reader v(*this);
+    RS_STATS_CALL((*v).stats, StatsEndpoint::cf);
+    RS_STATS_SHAPE((*v).movies.size(), user.get_preference().size(), k);
+    return top_n_by_cf(*v, user, k, n, &filter);
+}
+
+std::vector<scored_movie> RecommendationSystem::top_n_by_cf(const Version& v, const User& user,
+                                                            int k, int n,
+                                                            const RecommendationFilter* filter) {
+    rated_list rated = ratings_of(v, user); // Get ratings from User
+    if (n <= 0 || rated.size() >= v.movies.size()) {
+        return {};
+    }
+    if (rated.empty()) {
+        throw std::invalid_argument("User has no ratings");
+    }
+    std::unique_ptr<CandidateFilter> candidates = filter_of(v.movies, filter, rated.begin(), rated.end());
+    PinnedRows rated_rows = pin_rated(v, rated);
+    if (candidates) {
+        TopN best = scan_candidates(v, static_cast<size_t>(n), rated.size(),
+                                    [&](movie_id begin, movie_id end, TopN& selection) {
+            similarity_list similarities;
+            similarities.reserve(rated.size());
+            RowCursor rows(v.movies);
+            [[maybe_unused]] std::size_t scored = 0;
+            candidates->for_each_candidate(begin, end, [&](movie_id id) {
+                selection.push(predict_by_id(v, rated, rated_rows, id, rows, k, similarities),
+                               id);
+                ++scored;
+            });
+            RS_STATS_ADD(v.stats, StatsCounter::candidates_scanned, scored);
+            RS_STATS_ADD(v.stats, StatsCounter::exclusion_hits, end - begin - scored);
+        });
+        return to_scored_movies(v, best);
+    }
+    RS_STATS_ADD(v.stats, StatsCounter::candidates_scanned, v.movies.size() - rated.size());
+    RS_STATS_ADD(v.stats, StatsCounter::exclusion_hits, rated.size());
+
+    TopN best = scan_candidates(v, static_cast<size_t>(n), rated.size(),
+                                [&](movie_id begin, movie_id end, TopN& selection) {
+        similarity_list similarities;
+        similarities.reserve(rated.size());
+        RowCursor rows(v.movies);
+        RatedCursor is_rated(rated, begin);
+        for (movie_id id = begin; id < end; ++id) {
+            if (is_rated.skip(id)) continue;
+            selection.push(predict_by_id(v, rated, rated_rows, id, rows, k, similarities), id);
         }
+    });
+    return to_scored_movies(v, best);
+}
+
+const UserCfIndex& RecommendationSystem::require_user_cf_index(const Version& v) {
+    if (!v.user_cf_index) {
+        throw std::logic_error("No user CF index enabled");
+    }
+    return *v.user_cf_index;
+}
+
+sp_movie RecommendationSystem::recommend_by_user_cf(const User& user, int k) const {
+    std::vector<scored_movie> best = recommend_top_n_by_user_cf(user, k, 1);
+    return best.empty() ? nullptr : best.front().first;
+}
+
+std::vector<scored_movie> RecommendationSystem::recommend_top_n_by_user_cf(const User& user, int k,
+                                                                           int n) const {
+    Reader v(*this);
+    RS_STATS_CALL((*v).stats, StatsEndpoint::user_cf);
+    const UserCfIndex& index = require_user_cf_index(*v);
+    rated_list rated = ratings_of(*v, user);
+    RS_STATS_SHAPE((*v).movies.size(), rated.size(), k);
+    if (k < 0) {
+        throw std::invalid_argument("k must not be negative");
+    }
+    if (rated.empty()) {
+        throw std::invalid_argument("User has no ratings");
     }
-    return best_movie;
+    if (n <= 0) {
+        return {};
+    }
+    std::vector<UserNeighbor> neighbors = index.nearest_users(rated, user.get_name(), k);
+    TopN best(static_cast<std::size_t>(n), (*v).movies.size());
+    index.recommend(rated, neighbors, best);
+    return to_scored_movies(*v, best);
+}
+
+double RecommendationSystem::predict_movie_score_by_user_cf(const User& user,
+                                                            const sp_movie& movie, int k) const {
+    Reader v(*this);
+    RS_STATS_CALL((*v).stats, StatsEndpoint::user_cf);
+    const UserCfIndex& index = require_user_cf_index(*v);
+    rated_list rated = ratings_of(*v, user);
+    RS_STATS_SHAPE((*v).movies.size(), rated.size(), k);
+    if (k < 0) {
+        throw std::invalid_argument("k must not be negative");
+    }
+    if (rated.empty()) {
+        throw std::invalid_argument("User has no ratings");
+    }
+    movie_id target_id = require_movie_id((*v).movies, movie);
+    RS_STATS_ADD((*v).stats, StatsCounter::catalog_lookups, 1);
+    const double* own_rating = find_rating(rated, target_id);
+    if (own_rating) {
+        return *own_rating;
+    }
+    return index.predict(rated, index.nearest_users(rated, user.get_name(), k), target_id);
 }
 
 // Overload the stream insertion operator to print the recommendation system's movies.
 std::ostream& operator<<(std::ostream& os, const RecommendationSystem& rs) {
-    std::vector<sp_movie> sorted_movies;
-    for (const auto& [movie, features] : rs.movies) {
-        sorted_movies.push_back(movie);
-    }
+    MovieCatalog movies = rs.get_movies();
+    std::vector<sp_movie> sorted_movies(movies.begin(), movies.end());
 
     std::sort(sorted_movies.begin(), sorted_movies.end(), 
               [](const sp_movie& a, const sp_movie& b) {
@@ -3,30 +3,301 @@
 
 #include "Movie.h"
 #include "User.h"
-#include <unordered_map>
+#include "MovieCatalog.h"
+#include "SimilarityIndex.h"
+#include "AnnIndex.h"
+#include "QuantizedFeatures.h"
+#include "FeatureReduction.h"
+#include "FeaturePager.h"
+#include "UserCfIndex.h"
+#include "ResultCache.h"
+#include "RecommendationFilter.h"
+#include "RatingsMatrix.h"
+#include "TopN.h"
+#include "ThreadPool.h"
+#include "RecommendationStats.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <utility>
 #include <vector>
 #include <memory>
 #include <ostream>
 
+// Below this many similarity evaluations a recommend call stays on the calling thread.
+#define DEFAULT_PARALLEL_THRESHOLD 65536
+
 class RecommendationSystem {
 private:
-    std::unordered_map<sp_movie, std::vector<double>, decltype(&sp_movie_hash), decltype(&sp_movie_equal)> movies;
+    friend class RecommendationSystemLoader;
+    friend class UsersLoader;
+    friend class ShardedRecommender;
+
+    /**
+     * Everything a read needs, published as one immutable unit. Writers copy
+     * the latest version, change the copy and publish it; readers keep using
+     * whatever version they started with.
+     */
+    struct Version {
+        std::uint64_t number = 0; // unique across all systems
+        MovieCatalog movies;
+        std::shared_ptr<const SimilarityIndex> similarity_index;
+        std::shared_ptr<const AnnIndex> ann_index;
+        std::size_t ann_probes = 0;
+        std::shared_ptr<const QuantizedFeatures> quantized;
+        std::shared_ptr<const FeatureReduction> reduction; // `movies` holds projected rows
+        MovieCatalog original_movies; // full-width rows while reduced, if kept
+        std::shared_ptr<const UserCfIndex> user_cf_index;
+        std::shared_ptr<ResultCache> result_cache; // shared by the versions it was enabled in
+        std::shared_ptr<ThreadPool> executor;
+        std::size_t parallel_threshold = DEFAULT_PARALLEL_THRESHOLD;
+#ifdef RS_ENABLE_STATS
+        RecommendationStats* stats = nullptr; // owned by the system
+#endif
+    };
+    class Reader;
+    struct ReaderPin;
+
+    std::shared_ptr<const Version> current; // only accessed through std::atomic_load/store
+    std::atomic<std::uint64_t> current_number;
+    std::mutex writer; // serializes writers; readers never take it
+    // Threads whose read pin holds one of this system's versions, released on
+    // destruction. Guarded by a process-wide mutex in the .cpp.
+    mutable std::vector<ReaderPin*> pinned_by;
+#ifdef RS_ENABLE_STATS
+    std::unique_ptr<RecommendationStats> stats_data;
+#endif
+
+    std::shared_ptr<Version> begin_write() const;
+    void publish(std::shared_ptr<Version> next);
+    void replace_movies(MovieCatalog catalog);
+
+    // A user's ratings resolved to catalog ids, (id, rating) sorted by id.
+    typedef std::vector<std::pair<movie_id, double>> rated_list;
+    // Scratch buffer of (similarity, rating) pairs reused across predictions.
+    typedef std::vector<std::pair<double, double>> similarity_list;
+
+    static rated_list resolve_ratings(const Version& v, const rank_map& user_ratings);
+    static rated_list ratings_of(const Version& v, const User& user);
+    static double preference_of(const Version& v, const rated_list& rated,
+                                std::vector<double>& preference_vector);
+    static bool projects_preference(const Version& v, const UserPreference& preference);
+    static double project_preference(const Version& v, const UserPreference& preference,
+                                     std::vector<double>& preference_vector);
+    static double content_query(const Version& v, const User& user,
+                                std::vector<double>& preference_vector,
+                                std::vector<movie_id>& rated_ids);
+    static std::vector<scored_movie> top_n_by_content(const Version& v, const User& user,
+                                                      int n, std::size_t probes,
+                                                      const RecommendationFilter* filter = nullptr);
+    // Scores every movie not in [rated_begin, rated_end), a range sorted by id,
+    // or, with a filter, every movie the filter accepts.
+    template <typename RatedIterator>
+    static std::vector<scored_movie> top_n_by_content(const Version& v, RatedIterator rated_begin,
+                                                      RatedIterator rated_end,
+                                                      const double* preference_vector,
+                                                      double preference_norm, int n,
+                                                      std::size_t probes,
+                                                      const RecommendationFilter* filter);
+    static std::vector<scored_movie> top_n_by_cf(const Version& v, const User& user, int k, int n,
+                                                 const RecommendationFilter* filter = nullptr);
+    static double predict_for_user(const Version& v, const User& user, const sp_movie& movie,
+                                   int k);
+    static PinnedRows pin_rated(const Version& v, const rated_list& rated);
+    static double predict_by_id(const Version& v, const rated_list& rated,
+                                const PinnedRows& rated_rows, movie_id target_id, RowCursor& rows,
+                                int k, similarity_list& similarities);
+    static double top_k_average(similarity_list& similarities, int k);
+    static std::vector<scored_movie> to_scored_movies(const Version& v, TopN& best);
+    static TopN scan_candidates(const Version& v, std::size_t n, std::size_t work_per_candidate,
+                                const std::function<void(movie_id, movie_id, TopN&)>& score_range);
+    static bool predict_from_index(const Version& v, const rated_list& rated,
+                                   movie_id target_id, int k, double& score);
+    static const UserCfIndex& require_user_cf_index(const Version& v);
 
 public:
-    RecommendationSystem() : movies(0, &sp_movie_hash, &sp_movie_equal) {}
+    RecommendationSystem();
+    ~RecommendationSystem();
+    RecommendationSystem(const RecommendationSystem&) = delete;
+    RecommendationSystem& operator=(const RecommendationSystem&) = delete;
+
+    /**
+     * Adds a movie and publishes a new version. Safe to call while other
+     * threads run any of the const methods; concurrent writers are serialized.
+     */
     sp_movie add_movie_to_rs(const std::string& name, int year, const std::vector<double>& features);
-    sp_movie get_movie(const std::string& name, int year) const;
-    const std::vector<double>& get_movie_features(const sp_movie& movie) const;
+    // Allocation-free: the title is looked up in the interned title table.
+    sp_movie get_movie(std::string_view name, int year) const;
+    FeatureView get_movie_features(const sp_movie& movie) const;
 
     // Overloaded functions
     sp_movie recommend_by_content(const rank_map& user_ratings) const;
     sp_movie recommend_by_content(const User& user) const; 
-    
+
+    /**
+     * The n unrated movies most similar to the user's preference vector, best first.
+     * Equal scores are ordered by catalog insertion order. Goes through the
+     * ANN index when one is enabled.
+     */
+    std::vector<scored_movie> recommend_top_n_by_content(const rank_map& user_ratings, int n) const;
+    std::vector<scored_movie> recommend_top_n_by_content(const User& user, int n) const;
+
+    /**
+     * Only movies the filter accepts are scored; the filter is applied inside
+     * the scan, so n results are returned whenever n movies pass it. Filtered
+     * calls bypass the result cache.
+     */
+    std::vector<scored_movie> recommend_top_n_by_content(const User& user, int n,
+                                                         const RecommendationFilter& filter) const;
+
+    // Always the exhaustive scan, even with an ANN index enabled.
+    std::vector<scored_movie> recommend_top_n_by_content_exact(const User& user, int n) const;
+
+    /**
+     * Content recommendation through the ANN index with an explicit probe count.
+     * @throws std::logic_error if no ANN index is enabled
+     */
+    std::vector<scored_movie> recommend_top_n_by_content_ann(const User& user, int n,
+                                                             std::size_t probes) const;
+
+    /**
+     * recommend_top_n_by_content_exact for many users at once, one result per
+     * user in the same order. The users' preferences are scored together
+     * against the catalog with a tiled matrix multiplication (see
+     * ContentBatch), in parallel on the executor when one is set. Scores match
+     * the per-user call up to rounding; the result cache is not used.
+     */
+    std::vector<std::vector<scored_movie>>
+    recommend_top_n_by_content_batch(const std::vector<User>& users, int n) const;
+    std::vector<std::vector<scored_movie>>
+    recommend_top_n_by_content_batch(const std::vector<const User*>& users, int n) const;
 
     sp_movie recommend_by_cf(const User& user, int k) const;
+
+    /**
+     * The n unrated movies with the highest predicted score (see
+     * predict_movie_score), best first.
+     */
+    std::vector<scored_movie> recommend_top_n_by_cf(const User& user, int k, int n) const;
+    std::vector<scored_movie> recommend_top_n_by_cf(const User& user, int k, int n,
+                                                    const RecommendationFilter& filter) const;
+
     double predict_movie_score(const User& user, const sp_movie& movie, int k) const;
 
-    const std::unordered_map<sp_movie, std::vector<double>, decltype(&sp_movie_hash), decltype(&sp_movie_equal)>& get_movies() const;
+    /**
+     * Builds an item-item neighbor index that predict_movie_score reads from.
+     * It is kept up to date by add_movie_to_rs and built on the executor, if one is set.
+     * @param neighbors_per_movie - K, the number of neighbors kept per movie
+     * @param memory_budget_bytes - K is lowered so that the lists fit in this budget
+     */
+    void enable_similarity_index(std::size_t neighbors_per_movie,
+                                 std::size_t memory_budget_bytes = DEFAULT_SIMILARITY_BUDGET);
+    void disable_similarity_index();
+    std::shared_ptr<const SimilarityIndex> get_similarity_index() const;
+
+    /**
+     * Builds an IVF index over the catalog that content recommendations then
+     * query with options.probes probes. Movies added later are scanned exactly.
+     */
+    void enable_ann_index(const AnnOptions& options = AnnOptions());
+    void disable_ann_index();
+    std::shared_ptr<const AnnIndex> get_ann_index() const;
+
+    /**
+     * Builds the user-user index (movie -> raters posting lists) from these
+     * users' current ratings. Later rating changes of the indexed users are not
+     * seen until it is enabled again; the querying user's ratings always are.
+     */
+    void enable_user_cf(const std::vector<User>& users);
+    // Same, reading the ratings straight from a mapped matrix, without building Users.
+    void enable_user_cf(const RatingsMatrix& matrix);
+    void disable_user_cf();
+    std::shared_ptr<const UserCfIndex> get_user_cf_index() const;
+
+    /**
+     * User-user collaborative filtering: the k indexed users whose centered
+     * ratings are most similar to this user's vote on the movies this user
+     * has not rated. An indexed user with the same name is skipped.
+     * @throws std::logic_error if the user CF index is not enabled
+     */
+    sp_movie recommend_by_user_cf(const User& user, int k) const;
+    std::vector<scored_movie> recommend_top_n_by_user_cf(const User& user, int k, int n) const;
+    double predict_movie_score_by_user_cf(const User& user, const sp_movie& movie, int k) const;
+
+    /**
+     * Caches the User overloads of recommend_top_n_by_content and
+     * recommend_top_n_by_cf (and so recommend_by_content / recommend_by_cf)
+     * and of predict_movie_score. Entries are keyed by the user's rating
+     * version and the system version, so a rating change or any write to the
+     * system is seen by the next call; stale entries just age out.
+     * @param capacity - maximum number of cached results
+     */
+    void enable_result_cache(std::size_t capacity = DEFAULT_RESULT_CACHE_CAPACITY);
+    void disable_result_cache();
+    ResultCacheStats result_cache_stats() const;
+
+    /**
+     * Chooses the precision of the features read by content scans and by
+     * predictions that are not answered from the neighbor index. float32 and
+     * uint8 build a reduced copy of the current catalog; float64 drops it.
+     * Movies added later are always scored in double.
+     */
+    void set_feature_storage(FeatureStorage storage);
+    FeatureStorage get_feature_storage() const;
+    std::shared_ptr<const QuantizedFeatures> get_quantized_features() const;
+
+    /**
+     * Replaces every movie's features by their projection through `reduction`
+     * (see FeatureReduction::fit), so all scoring, get_movie_features
+     * included, runs in the reduced width. Movies added later are projected on
+     * the way in. The similarity and ANN indexes and the reduced-precision copy
+     * are dropped; enable them again to build them over the projected rows.
+     * Meant as a load-time step: a preference users maintained under another
+     * reduction of the same width is not told apart from a current one.
+     * @param keep_original - keep the full-width rows for restore_features()
+     * @throws std::logic_error if a reduction is already applied
+     * @throws std::invalid_argument if it was fitted to another feature width
+     */
+    void reduce_features(std::shared_ptr<const FeatureReduction> reduction,
+                         bool keep_original = true);
+
+    /**
+     * Goes back to the full-width rows kept by reduce_features.
+     * @throws std::logic_error if no reduction is applied or its rows were not kept
+     */
+    void restore_features();
+    std::shared_ptr<const FeatureReduction> get_feature_reduction() const;
+
+    /**
+     * Block cache counters of a catalog loaded with
+     * RecommendationSystemLoader::load_snapshot_paged; all zero otherwise.
+     */
+    PagerStats get_paging_stats() const;
+
+    /**
+     * Lets recommend calls split their candidate scan over a thread pool.
+     * Results are identical to the serial path, ties included.
+     * @param pool - executor to use, nullptr to go back to serial scans
+     * @param threshold - minimum number of similarity evaluations worth parallelizing
+     */
+    void set_executor(std::shared_ptr<ThreadPool> pool,
+                      std::size_t threshold = DEFAULT_PARALLEL_THRESHOLD);
+    std::shared_ptr<ThreadPool> get_executor() const;
+
+    // Snapshot of the catalog; it does not see movies added afterwards.
+    MovieCatalog get_movies() const;
+
+    // Number of the published version; changes with every write.
+    std::uint64_t get_version() const;
+
+    /**
+     * Merged hot-path counters and latency histograms since construction or
+     * the last reset_stats(). Empty (enabled == false) unless the library is
+     * built with RS_ENABLE_STATS.
+     */
+    StatsSnapshot stats() const;
+    void reset_stats();
 
     friend std::ostream& operator<<(std::ostream& os, const RecommendationSystem& rs);
 };
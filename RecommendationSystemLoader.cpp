@@ -1,73 +1,321 @@
 #include "RecommendationSystemLoader.h"
 #include "RecommendationSystem.h"
+#include "CatalogSnapshot.h"
+#include "MappedFile.h"
+#include "SnapshotWriter.h"
+#include "TextParser.h"
+#include <cstdint>
+#include <cstring>
+#include <exception>
 #include <fstream>
-#include <sstream>
 #include <stdexcept>
+#include <string_view>
 #include <vector>
 #include <iostream>
 #include <algorithm>
 
+// Bytes read at a time when a paged snapshot is checksummed.
+#define SNAPSHOT_CHECK_BYTES (1 << 20)
+
 // Helper function to trim whitespace from both ends of a string
-static inline std::string trim_whitespace(const std::string& str) {
+static inline std::string_view trim_whitespace(std::string_view str) {
     size_t first = str.find_first_not_of(" \t");
-    if (std::string::npos == first) return "";
+    if (std::string_view::npos == first) return "";
     size_t last = str.find_last_not_of(" \t");
     return str.substr(first, (last - first + 1));
 }
 
-std::shared_ptr<RecommendationSystem> RecommendationSystemLoader::create_rs_from_movies(const std::string& file_path) {
-    std::ifstream file(file_path);
-    if (!file.is_open()) {
-        throw std::runtime_error("Failed to open file: " + file_path);
+namespace {
+
+struct MovieRecord {
+    size_t line;
+    std::string name;
+    int year;
+    std::vector<double> features;
+};
+
+// Output of one parser thread. Parsing stops at the first bad line.
+struct MovieChunk {
+    std::vector<MovieRecord> records;
+    size_t lines = 0;
+    std::exception_ptr error;
+};
+
+} // namespace
+
+static void parse_movie_line(std::string_view line, MovieRecord& record) {
+    // Parse movie name and year
+    std::string_view movie_with_year;
+    if (!next_token(line, movie_with_year)) {
+        throw std::runtime_error("Invalid file format: missing movie name and year.");
     }
 
-    std::shared_ptr<RecommendationSystem> rs = std::make_shared<RecommendationSystem>();
-    std::string line;
+    size_t dash_pos = movie_with_year.find('-');
+    if (dash_pos == std::string_view::npos) {
+        throw std::runtime_error("Invalid format: movie name and year must be separated by a dash '-'.");
+    }
 
-    while (std::getline(file, line)) {
-        std::istringstream line_stream(line);
+    // Extract and clean movie name
+    record.name = std::string(trim_whitespace(movie_with_year.substr(0, dash_pos)));
+    record.year = parse_int(movie_with_year.substr(dash_pos + 1));
 
-        // Parse movie name and year
-        std::string movie_with_year;
-        if (!(line_stream >> movie_with_year)) {
-            throw std::runtime_error("Invalid file format: missing movie name and year.");
+    // Parse features
+    double feature_value;
+    while (read_double(line, feature_value)) {
+        if (feature_value < 1.0 || feature_value > 10.0) {
+            throw std::runtime_error("Feature value out of range [1-10] for movie: " + record.name);
         }
+        record.features.push_back(feature_value);
+    }
+}
 
-        size_t dash_pos = movie_with_year.find('-');
-        if (dash_pos == std::string::npos) {
-            throw std::runtime_error("Invalid format: movie name and year must be separated by a dash '-'.");
+static void parse_movie_chunk(LineChunk chunk, MovieChunk& out) {
+    std::string_view line;
+    while (next_line(chunk, line)) {
+        MovieRecord record;
+        record.line = out.lines++;
+        try {
+            parse_movie_line(line, record);
+        } catch (...) {
+            out.error = std::current_exception();
+            return;
         }
+        out.records.push_back(std::move(record));
+    }
+}
+
+static void report_line(const std::string& file_path, size_t line) {
+    std::cerr << "[ERROR] at line " << line << " of " << file_path << "\n";
+}
+
+std::shared_ptr<RecommendationSystem> RecommendationSystemLoader::create_rs_from_movies(const std::string& file_path) {
+    MappedFile file(file_path);
+    file.advise_sequential();
 
-        // Extract and clean movie name
-        std::string movie_name = trim_whitespace(movie_with_year.substr(0, dash_pos));
-        int year = std::stoi(movie_with_year.substr(dash_pos + 1));
+    // Lines are parsed on several threads, then added in file order.
+    std::vector<LineChunk> chunks = split_line_chunks(file.data(), file.size(),
+                                                      parse_chunk_count(file.size()));
+    std::vector<MovieChunk> parsed(chunks.size());
+    std::shared_ptr<RecommendationSystem> rs = std::make_shared<RecommendationSystem>();
+    {
+        RS_STATS_PHASE(rs->stats_data, StatsCounter::movies_parse_ns);
+        run_chunks(chunks.size(), [&](size_t i) { parse_movie_chunk(chunks[i], parsed[i]); });
+    }
 
-        // Parse features
-        std::vector<double> features;
-        double feature_value;
-        while (line_stream >> feature_value) {
-            if (feature_value < 1.0 || feature_value > 10.0) {
-                throw std::runtime_error("Feature value out of range [1-10] for movie: " + movie_name);
+    size_t first_line = 1;
+    for (MovieChunk& chunk : parsed) {
+        RS_STATS_ADD(rs->stats_data, StatsCounter::movies_parsed, chunk.records.size());
+        for (MovieRecord& record : chunk.records) {
+            const std::string& movie_name = record.name;
+            int year = record.year;
+
+            if (rs->get_movie(movie_name, year)) {
+                std::cerr << "[WARNING] Skipping duplicate movie: " 
+                          << movie_name << " (" << year << ")\n";
+                continue;
             }
-            features.push_back(feature_value);
+
+            // Add movie to the recommendation system
+            try {
+                rs->add_movie_to_rs(movie_name, year, record.features);
+            } catch (const std::exception& e) {
+                std::cerr << "[ERROR] Failed to add movie " << movie_name 
+                          << " (" << year << "): " << e.what() << "\n";
+                report_line(file_path, first_line + record.line);
+                throw;
+            }
+        }
+        if (chunk.error) {
+            // The failing line is the one after the last line the chunk counted.
+            report_line(file_path, first_line + chunk.lines - 1);
+            std::rethrow_exception(chunk.error);
         }
+        first_line += chunk.lines;
+    }
+
+    return rs;
+}
 
-        if (rs->get_movie(movie_name, year)) {
-            std::cerr << "[WARNING] Skipping duplicate movie: " 
-                      << movie_name << " (" << year << ")\n";
-            continue;
+void RecommendationSystemLoader::save_snapshot(const RecommendationSystem& rs,
+                                               const std::string& file_path) {
+    std::ofstream file(file_path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open file: " + file_path);
+    }
+
+    const MovieCatalog movies = rs.get_movies();
+    SnapshotHeader header{};
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = SNAPSHOT_VERSION;
+    header.header_size = sizeof(SnapshotHeader);
+    header.dimension = movies.dimension();
+    header.stride = movies.stride();
+    header.count = movies.size();
+    header.strings_offset = sizeof(SnapshotHeader);
+
+    // Header goes in last, once the offsets and checksum are known.
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    std::uint64_t checksum = FNV_OFFSET_BASIS;
+    size_t offset = sizeof(header);
+
+    for (const sp_movie& movie : movies) {
+        const std::string& name = movie->get_name();
+        std::int32_t year = movie->get_year();
+        std::uint32_t name_length = static_cast<std::uint32_t>(name.size());
+        write_bytes(file, &year, sizeof(year), checksum);
+        write_bytes(file, &name_length, sizeof(name_length), checksum);
+        write_bytes(file, name.data(), name.size(), checksum);
+        offset += sizeof(year) + sizeof(name_length) + name.size();
+    }
+    header.strings_size = offset - header.strings_offset;
+
+    const char padding[FEATURE_ALIGNMENT] = {};
+    header.features_offset = align_up(offset, FEATURE_ALIGNMENT);
+    write_bytes(file, padding, header.features_offset - offset, checksum);
+    size_t row_bytes = movies.stride() * sizeof(double);
+    RowCursor rows(movies);
+    for (movie_id id = 0; id < movies.size(); ++id) {
+        write_bytes(file, rows.row(id), row_bytes, checksum);
+    }
+
+    header.norms_offset = header.features_offset + movies.size() * row_bytes;
+    for (movie_id id = 0; id < movies.size(); ++id) {
+        double norm = movies.norm(id);
+        write_bytes(file, &norm, sizeof(norm), checksum);
+    }
+    header.file_size = header.norms_offset + movies.size() * sizeof(double);
+    header.checksum = checksum;
+
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (!file) {
+        throw std::runtime_error("Failed to write snapshot: " + file_path);
+    }
+}
+
+// Rejects a header that does not describe a well-formed snapshot of `size`
+// bytes, without trusting any field: every extent is computed overflow-checked
+// and must lie inside the file, and the rows must be aligned like a catalog's.
+static void check_header(const SnapshotHeader& header, size_t size, const std::string& file_path) {
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+        throw std::runtime_error("Invalid snapshot file: " + file_path);
+    }
+    if (header.version != SNAPSHOT_VERSION || header.header_size != sizeof(header)) {
+        throw std::runtime_error("Unsupported snapshot version in " + file_path);
+    }
+    std::uint64_t row_bytes, features_size, norms_size, strings_end, features_end, norms_end;
+    bool fits = checked_product(header.stride, sizeof(double), row_bytes) &&
+                checked_product(header.count, row_bytes, features_size) &&
+                checked_product(header.count, sizeof(double), norms_size) &&
+                checked_sum(header.strings_offset, header.strings_size, strings_end) &&
+                checked_sum(header.features_offset, features_size, features_end) &&
+                checked_sum(header.norms_offset, norms_size, norms_end);
+    if (!fits || header.file_size != size || header.stride < header.dimension ||
+        row_bytes % FEATURE_ALIGNMENT != 0 ||
+        header.strings_offset < sizeof(header) || strings_end > header.features_offset ||
+        header.features_offset % FEATURE_ALIGNMENT != 0 ||
+        header.norms_offset != features_end || norms_end != size) {
+        throw std::runtime_error("Corrupt snapshot layout in " + file_path);
+    }
+}
+
+// Registers the titles of the string table [cursor, strings_end) in id order.
+static void read_titles(MovieCatalog& movies, const char* cursor, const char* strings_end,
+                        std::uint64_t count, const std::string& file_path) {
+    for (std::uint64_t i = 0; i < count; ++i) {
+        std::int32_t year;
+        std::uint32_t name_length;
+        if (strings_end - cursor < static_cast<std::ptrdiff_t>(sizeof(year) + sizeof(name_length))) {
+            throw std::runtime_error("Corrupt snapshot string table in " + file_path);
+        }
+        std::memcpy(&year, cursor, sizeof(year));
+        std::memcpy(&name_length, cursor + sizeof(year), sizeof(name_length));
+        cursor += sizeof(year) + sizeof(name_length);
+        if (strings_end - cursor < static_cast<std::ptrdiff_t>(name_length)) {
+            throw std::runtime_error("Corrupt snapshot string table in " + file_path);
         }
+        movies.add_external(std::string_view(cursor, name_length), year);
+        cursor += name_length;
+    }
+}
 
-        // Add movie to the recommendation system
-        try {
-            rs->add_movie_to_rs(movie_name, year, features);
-        } catch (const std::exception& e) {
-            std::cerr << "[ERROR] Failed to add movie " << movie_name 
-                      << " (" << year << "): " << e.what() << "\n";
-            throw;
+std::shared_ptr<RecommendationSystem> RecommendationSystemLoader::load_snapshot(
+        const std::string& file_path, bool verify_checksum) {
+    auto mapping = std::make_shared<MappedFile>(file_path);
+    const char* data = mapping->data();
+    size_t size = mapping->size();
+
+    SnapshotHeader header;
+    if (size < sizeof(header)) {
+        throw std::runtime_error("Invalid snapshot file: " + file_path);
+    }
+    std::memcpy(&header, data, sizeof(header));
+    check_header(header, size, file_path);
+    if (verify_checksum &&
+        snapshot_checksum(data + sizeof(header), size - sizeof(header)) != header.checksum) {
+        throw std::runtime_error("Snapshot checksum mismatch in " + file_path);
+    }
+
+    MovieCatalog movies;
+    movies.attach_external(header.dimension, header.stride, header.count,
+                           reinterpret_cast<const double*>(data + header.features_offset),
+                           reinterpret_cast<const double*>(data + header.norms_offset),
+                           mapping);
+    const char* strings = data + header.strings_offset;
+    read_titles(movies, strings, strings + header.strings_size, header.count, file_path);
+
+    auto rs = std::make_shared<RecommendationSystem>();
+    rs->replace_movies(std::move(movies));
+    return rs;
+}
+
+std::shared_ptr<RecommendationSystem> RecommendationSystemLoader::load_snapshot_paged(
+        const std::string& file_path, const PagerOptions& options, bool verify_checksum) {
+    std::ifstream file(file_path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open file: " + file_path);
+    }
+    size_t size = static_cast<size_t>(file.tellg());
+    file.seekg(0);
+
+    SnapshotHeader header;
+    if (size < sizeof(header) || !file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        throw std::runtime_error("Invalid snapshot file: " + file_path);
+    }
+    check_header(header, size, file_path);
+    if (verify_checksum) {
+        // Streamed, so the rows are read once but never held.
+        std::vector<char> block(SNAPSHOT_CHECK_BYTES);
+        std::uint64_t checksum = FNV_OFFSET_BASIS;
+        while (file.read(block.data(), static_cast<std::streamsize>(block.size())) ||
+               file.gcount() > 0) {
+            checksum = snapshot_checksum(block.data(), static_cast<size_t>(file.gcount()), checksum);
+        }
+        if (checksum != header.checksum) {
+            throw std::runtime_error("Snapshot checksum mismatch in " + file_path);
         }
+        file.clear();
     }
 
-    file.close();
+    // Only the string table and the norms are read; the rows stay on disk.
+    std::vector<char> strings(header.strings_size);
+    std::vector<double> norms(header.count);
+    file.seekg(static_cast<std::streamoff>(header.strings_offset));
+    file.read(strings.data(), static_cast<std::streamsize>(strings.size()));
+    file.seekg(static_cast<std::streamoff>(header.norms_offset));
+    file.read(reinterpret_cast<char*>(norms.data()),
+              static_cast<std::streamsize>(norms.size() * sizeof(double)));
+    if (!file) {
+        throw std::runtime_error("Failed to read snapshot: " + file_path);
+    }
+
+    auto pager = std::make_shared<FeaturePager>(file_path, header.features_offset, header.stride,
+                                                header.count, options);
+    MovieCatalog movies;
+    movies.attach_paged(header.dimension, std::move(norms), std::move(pager));
+    read_titles(movies, strings.data(), strings.data() + strings.size(), header.count, file_path);
+
+    auto rs = std::make_shared<RecommendationSystem>();
+    rs->replace_movies(std::move(movies));
     return rs;
-}
\ No newline at end of file
+}
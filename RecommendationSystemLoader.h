@@ -8,6 +8,31 @@
 class RecommendationSystemLoader {
 public:
     static std::shared_ptr<RecommendationSystem> create_rs_from_movies(const std::string& file_path);
+
+    /**
+     * Writes the catalog of rs to a binary snapshot (see CatalogSnapshot.h).
+     */
+    static void save_snapshot(const RecommendationSystem& rs, const std::string& file_path);
+
+    /**
+     * Maps a snapshot written by save_snapshot. Features and norms are served
+     * straight from the mapping without copying.
+     * @param verify_checksum - also checksum the whole file (reads every page)
+     */
+    static std::shared_ptr<RecommendationSystem> load_snapshot(const std::string& file_path,
+                                                               bool verify_checksum = false);
+
+    /**
+     * Opens a snapshot written by save_snapshot keeping only titles, ids and
+     * norms in memory. Feature rows are paged in from the file on demand
+     * through a FeaturePager bounded by options.cache_bytes, so the catalog
+     * may be larger than memory. The catalog is read-only: add_movie_to_rs
+     * throws std::logic_error.
+     * @param verify_checksum - also checksum the whole file (streams it once)
+     */
+    static std::shared_ptr<RecommendationSystem> load_snapshot_paged(
+        const std::string& file_path, const PagerOptions& options = PagerOptions(),
+        bool verify_checksum = false);
 };
 
 #endif // RECOMMENDATIONSYSTEMLOADER_H
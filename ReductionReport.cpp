@@ -0,0 +1,103 @@
+#include "ReductionReport.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <stdexcept>
+
+typedef std::chrono::steady_clock rs_clock;
+
+static double micros_since(rs_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(rs_clock::now() - start).count();
+}
+
+// Content lists and predictions of every user at the current width.
+struct WidthSample {
+    std::vector<std::vector<scored_movie>> content;
+    std::vector<double> predictions;
+    double content_micros = 0.0;
+};
+
+static WidthSample sample_scores(const RecommendationSystem& rs, const std::vector<User>& users,
+                                 int n, int k, std::size_t targets_per_user) {
+    WidthSample sample;
+    rs_clock::time_point start = rs_clock::now();
+    for (const User& user : users) {
+        sample.content.push_back(rs.recommend_top_n_by_content_exact(user, n));
+    }
+    sample.content_micros = users.empty() ? 0.0 : micros_since(start) / users.size();
+
+    MovieCatalog movies = rs.get_movies();
+    std::size_t targets = std::min(targets_per_user, movies.size());
+    for (const User& user : users) {
+        for (std::size_t t = 0; t < targets; ++t) {
+            movie_id target = static_cast<movie_id>(t * movies.size() / targets);
+            sample.predictions.push_back(rs.predict_movie_score(user, movies.movie(target), k));
+        }
+    }
+    return sample;
+}
+
+ReductionReport measure_reduction(RecommendationSystem& rs, const std::vector<User>& users,
+                                  const ReductionOptions& options, int n, int k,
+                                  std::size_t targets_per_user) {
+    if (rs.get_feature_reduction()) {
+        throw std::logic_error("The features are already reduced");
+    }
+    WidthSample full = sample_scores(rs, users, n, k, targets_per_user);
+
+    rs_clock::time_point start = rs_clock::now();
+    std::shared_ptr<const FeatureReduction> reduction = FeatureReduction::fit(rs.get_movies(),
+                                                                              options);
+    rs.reduce_features(reduction);
+    double fit_millis = micros_since(start) / 1000.0;
+    WidthSample reduced = sample_scores(rs, users, n, k, targets_per_user);
+
+    ReductionReport report{options.method, users.size(), reduction->input_dimension(),
+                           reduction->output_dimension(), reduction->explained_variance(),
+                           fit_millis, 0.0, 0.0, 0.0, full.content_micros,
+                           reduced.content_micros};
+
+    // The reduced catalog shares the sp_movie objects, so pointers compare.
+    std::size_t compared_users = 0;
+    for (std::size_t u = 0; u < users.size(); ++u) {
+        const auto& a = full.content[u];
+        const auto& b = reduced.content[u];
+        if (a.empty()) {
+            continue;
+        }
+        report.top1_change_rate += (b.empty() || a.front().first != b.front().first);
+        std::size_t kept = 0;
+        for (const scored_movie& entry : a) {
+            kept += std::any_of(b.begin(), b.end(), [&](const scored_movie& other) {
+                return other.first == entry.first;
+            });
+        }
+        report.top_n_overlap += static_cast<double>(kept) / a.size();
+        compared_users++;
+    }
+    if (compared_users > 0) {
+        report.top1_change_rate /= compared_users;
+        report.top_n_overlap /= compared_users;
+    }
+    for (std::size_t i = 0; i < full.predictions.size(); ++i) {
+        report.max_predict_deviation = std::max(
+            report.max_predict_deviation, std::fabs(full.predictions[i] - reduced.predictions[i]));
+    }
+    return report;
+}
+
+std::ostream& operator<<(std::ostream& os, const ReductionReport& report) {
+    os << (report.method == ReductionMethod::pca ? "pca" : "random projection") << " "
+       << report.input_dimension << " -> " << report.output_dimension << " dimensions over "
+       << report.users << " users\n";
+    os << std::fixed << std::setprecision(4)
+       << "explained variance " << report.explained_variance << "\n"
+       << "top-1 change rate " << report.top1_change_rate << "\n"
+       << "top-n overlap " << report.top_n_overlap << "\n"
+       << std::scientific << std::setprecision(3)
+       << "max predicted score deviation " << report.max_predict_deviation << "\n"
+       << std::fixed << std::setprecision(1) << "fit ms " << report.fit_millis << "\n"
+       << "content us/query " << report.full_micros << " -> " << report.reduced_micros << "\n";
+    return os;
+}
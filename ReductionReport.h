@@ -0,0 +1,41 @@
+#ifndef REDUCTIONREPORT_H
+#define REDUCTIONREPORT_H
+
+#include "FeatureReduction.h"
+#include "RecommendationSystem.h"
+#include "User.h"
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+struct ReductionReport {
+    ReductionMethod method;
+    std::size_t users;
+    std::size_t input_dimension;
+    std::size_t output_dimension;
+    double explained_variance;    // see FeatureReduction::explained_variance
+    double fit_millis;            // fitting the reduction and projecting the catalog
+    double top1_change_rate;      // fraction of users whose best content movie changed
+    double top_n_overlap;         // mean fraction of the full-width top n still recommended
+    double max_predict_deviation; // largest |predict_movie_score difference|
+    double full_micros;           // mean content query latency at full width
+    double reduced_micros;        // mean content query latency after the reduction
+};
+
+/**
+ * Runs content recommendations and predictions for every user at full width,
+ * then fits a reduction with `options`, applies it (keeping the full-width
+ * rows) and runs them again. Leaves rs reduced; restore_features() undoes it.
+ * Meant to be run before the system starts serving.
+ * @param n - length of the content lists compared
+ * @param k - k of the compared predictions
+ * @param targets_per_user - movies predicted per user, spread over the catalog
+ * @throws std::logic_error if rs is already reduced
+ */
+ReductionReport measure_reduction(RecommendationSystem& rs, const std::vector<User>& users,
+                                  const ReductionOptions& options, int n = 10, int k = 5,
+                                  std::size_t targets_per_user = 10);
+
+std::ostream& operator<<(std::ostream& os, const ReductionReport& report);
+
+#endif // REDUCTIONREPORT_H
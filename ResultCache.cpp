@@ -0,0 +1,91 @@
+#include "ResultCache.h"
+#include <algorithm>
+
+static std::uint64_t mix(std::uint64_t hash, std::uint64_t value) {
+    hash ^= value + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+    return hash;
+}
+
+std::size_t ResultKeyHash::operator()(const ResultKey& key) const {
+    std::uint64_t hash = mix(key.user, key.user_version);
+    hash = mix(hash, key.system_version);
+    hash = mix(hash, key.argument);
+    hash = mix(hash, (static_cast<std::uint64_t>(static_cast<std::uint32_t>(key.k)) << 8) |
+                         static_cast<std::uint8_t>(key.call));
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return static_cast<std::size_t>(hash);
+}
+
+ResultCache::ResultCache(std::size_t capacity)
+    : shard_capacity(std::max<std::size_t>(1, capacity / RESULT_CACHE_SHARDS)),
+      shards(new Shard[RESULT_CACHE_SHARDS]) {}
+
+ResultCache::Shard& ResultCache::shard_of(const ResultKey& key) const {
+    // The high bits pick the shard; the map inside uses the whole hash.
+    return shards[(ResultKeyHash()(key) >> 56) % RESULT_CACHE_SHARDS];
+}
+
+bool ResultCache::find(const ResultKey& key, CachedResult& result) const {
+    Shard& shard = shard_of(key);
+    std::lock_guard<std::mutex> lock(shard.lock);
+    auto it = shard.entries.find(key);
+    if (it == shard.entries.end()) {
+        ++shard.misses;
+        return false;
+    }
+    ++shard.hits;
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    result = it->second->second;
+    return true;
+}
+
+void ResultCache::insert(const ResultKey& key, CachedResult result) {
+    Shard& shard = shard_of(key);
+    std::lock_guard<std::mutex> lock(shard.lock);
+    auto it = shard.entries.find(key);
+    if (it != shard.entries.end()) {
+        // Another thread computed the same result first; it is identical.
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        return;
+    }
+    if (shard.entries.size() >= shard_capacity) {
+        shard.entries.erase(shard.lru.back().first);
+        shard.lru.pop_back();
+        ++shard.evictions;
+    }
+    shard.lru.emplace_front(key, std::move(result));
+    shard.entries.emplace(key, shard.lru.begin());
+    ++shard.insertions;
+}
+
+void ResultCache::clear() {
+    for (std::size_t i = 0; i < RESULT_CACHE_SHARDS; ++i) {
+        std::lock_guard<std::mutex> lock(shards[i].lock);
+        shards[i].entries.clear();
+        shards[i].lru.clear();
+    }
+}
+
+ResultCacheStats ResultCache::stats() const {
+    ResultCacheStats total;
+    total.capacity = shard_capacity * RESULT_CACHE_SHARDS;
+    for (std::size_t i = 0; i < RESULT_CACHE_SHARDS; ++i) {
+        std::lock_guard<std::mutex> lock(shards[i].lock);
+        total.hits += shards[i].hits;
+        total.misses += shards[i].misses;
+        total.insertions += shards[i].insertions;
+        total.evictions += shards[i].evictions;
+        total.entries += shards[i].entries.size();
+    }
+    return total;
+}
+
+std::ostream& operator<<(std::ostream& os, const ResultCacheStats& stats) {
+    os << "result cache: hits=" << stats.hits << " misses=" << stats.misses
+       << " hit_rate=" << stats.hit_rate() << " insertions=" << stats.insertions
+       << " evictions=" << stats.evictions << " entries=" << stats.entries << "/"
+       << stats.capacity << "\n";
+    return os;
+}
@@ -0,0 +1,98 @@
+#ifndef RESULTCACHE_H
+#define RESULTCACHE_H
+
+#include "TopN.h"
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+// Independent LRU shards; a key always lands in the same one.
+#define RESULT_CACHE_SHARDS 16
+#define DEFAULT_RESULT_CACHE_CAPACITY 65536
+
+enum class CachedCall : std::uint8_t { content, cf, predict };
+
+/**
+ * Identifies one result. The versions make every entry immutable: a rating
+ * change or a published system version produces different keys, so a stale
+ * result can never be found, only evicted.
+ */
+struct ResultKey {
+    std::uint64_t user;           // User::get_uid()
+    std::uint64_t user_version;   // User::get_rating_version()
+    std::uint64_t system_version; // RecommendationSystem version the result was computed on
+    std::uint64_t argument;       // n for recommendations, the target movie id for predictions
+    std::int32_t k;
+    CachedCall call;
+
+    bool operator==(const ResultKey& other) const {
+        return user == other.user && user_version == other.user_version &&
+               system_version == other.system_version && argument == other.argument &&
+               k == other.k && call == other.call;
+    }
+};
+
+struct ResultKeyHash {
+    std::size_t operator()(const ResultKey& key) const;
+};
+
+struct CachedResult {
+    std::vector<scored_movie> movies;
+    double score = 0.0;
+};
+
+struct ResultCacheStats {
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
+    std::uint64_t insertions = 0;
+    std::uint64_t evictions = 0;
+    std::size_t entries = 0;
+    std::size_t capacity = 0;
+
+    double hit_rate() const {
+        return (hits + misses) ? static_cast<double>(hits) / (hits + misses) : 0.0;
+    }
+};
+
+std::ostream& operator<<(std::ostream& os, const ResultCacheStats& stats);
+
+/**
+ * Bounded, thread-safe cache of recommendation results. Entries are spread
+ * over RESULT_CACHE_SHARDS shards, each a mutex-protected LRU list, so
+ * concurrent readers rarely contend on the same lock.
+ */
+class ResultCache {
+private:
+    struct alignas(64) Shard {
+        std::mutex lock;
+        std::list<std::pair<ResultKey, CachedResult>> lru; // most recent first
+        std::unordered_map<ResultKey, decltype(lru)::iterator, ResultKeyHash> entries;
+        std::uint64_t hits = 0;
+        std::uint64_t misses = 0;
+        std::uint64_t insertions = 0;
+        std::uint64_t evictions = 0;
+    };
+
+    std::size_t shard_capacity;
+    std::unique_ptr<Shard[]> shards;
+
+    Shard& shard_of(const ResultKey& key) const;
+
+public:
+    // @param capacity - total number of entries, split evenly over the shards
+    explicit ResultCache(std::size_t capacity = DEFAULT_RESULT_CACHE_CAPACITY);
+
+    // @return true and fills `result` if the key is cached
+    bool find(const ResultKey& key, CachedResult& result) const;
+    void insert(const ResultKey& key, CachedResult result);
+    void clear();
+
+    ResultCacheStats stats() const;
+};
+
+#endif // RESULTCACHE_H
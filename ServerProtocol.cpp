@@ -0,0 +1,162 @@
+#include "ServerProtocol.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+// Writes the body behind a length prefix that is filled in by finish().
+class FrameWriter {
+private:
+    std::string& out;
+    std::size_t start;
+
+public:
+    explicit FrameWriter(std::string& out) : out(out), start(out.size()) {
+        out.append(sizeof(std::uint32_t), '\0');
+    }
+
+    template <typename T>
+    void put(T value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    void put_string(const std::string& text) {
+        std::size_t length = std::min<std::size_t>(text.size(), UINT16_MAX);
+        put(static_cast<std::uint16_t>(length));
+        out.append(text, 0, length);
+    }
+
+    void finish() {
+        std::uint32_t length =
+            static_cast<std::uint32_t>(out.size() - start - sizeof(std::uint32_t));
+        std::memcpy(&out[start], &length, sizeof(length));
+    }
+};
+
+// Bounds-checked reads; a read past the end marks the body malformed.
+class FrameReader {
+private:
+    const char* data;
+    std::size_t left;
+    bool valid = true;
+
+public:
+    FrameReader(const char* data, std::size_t length) : data(data), left(length) {}
+
+    template <typename T>
+    T get() {
+        T value{};
+        if (left < sizeof(T)) {
+            valid = false;
+            return value;
+        }
+        std::memcpy(&value, data, sizeof(T));
+        data += sizeof(T);
+        left -= sizeof(T);
+        return value;
+    }
+
+    std::string get_string() {
+        std::size_t length = get<std::uint16_t>();
+        if (!valid || left < length) {
+            valid = false;
+            return {};
+        }
+        std::string text(data, length);
+        data += length;
+        left -= length;
+        return text;
+    }
+
+    bool ok() const { return valid; }
+
+    // Everything was read, and nothing is left over.
+    bool complete() const { return valid && left == 0; }
+};
+
+void ServerProtocol::encode(const ServerRequest& request, std::string& out) {
+    FrameWriter frame(out);
+    frame.put(request.id);
+    frame.put(static_cast<std::uint8_t>(request.call));
+    frame.put(request.k);
+    frame.put(request.n);
+    frame.put(request.year);
+    frame.put_string(request.user);
+    frame.put_string(request.movie);
+    frame.finish();
+}
+
+void ServerProtocol::encode(const ServerResponse& response, std::string& out) {
+    FrameWriter frame(out);
+    frame.put(response.id);
+    frame.put(static_cast<std::uint8_t>(response.status));
+    if (response.status == ResponseStatus::ok) {
+        frame.put(static_cast<std::uint32_t>(response.movies.size()));
+        for (const ResponseMovie& movie : response.movies) {
+            frame.put(movie.score);
+            frame.put(movie.year);
+            frame.put_string(movie.name);
+        }
+    } else {
+        frame.put_string(response.error);
+    }
+    frame.finish();
+}
+
+std::size_t ServerProtocol::encoded_size(const ResponseMovie& movie) {
+    return RESPONSE_MOVIE_BYTES + std::min<std::size_t>(movie.name.size(), UINT16_MAX);
+}
+
+bool ServerProtocol::decode(const char* body, std::size_t length, ServerRequest& request) {
+    FrameReader reader(body, length);
+    request.id = reader.get<std::uint32_t>();
+    std::uint8_t call = reader.get<std::uint8_t>();
+    request.k = reader.get<std::int32_t>();
+    request.n = std::min<std::int32_t>(reader.get<std::int32_t>(), MAX_RESPONSE_MOVIES);
+    request.year = reader.get<std::int32_t>();
+    request.user = reader.get_string();
+    request.movie = reader.get_string();
+    if (call < static_cast<std::uint8_t>(ServerCall::content) ||
+        call > static_cast<std::uint8_t>(ServerCall::predict)) {
+        return false;
+    }
+    request.call = static_cast<ServerCall>(call);
+    return reader.complete();
+}
+
+bool ServerProtocol::decode(const char* body, std::size_t length, ServerResponse& response) {
+    FrameReader reader(body, length);
+    response.id = reader.get<std::uint32_t>();
+    std::uint8_t status = reader.get<std::uint8_t>();
+    response.movies.clear();
+    response.error.clear();
+    if (status == static_cast<std::uint8_t>(ResponseStatus::ok)) {
+        response.status = ResponseStatus::ok;
+        std::uint32_t count = reader.get<std::uint32_t>();
+        for (std::uint32_t i = 0; i < count && reader.ok(); ++i) {
+            ResponseMovie movie;
+            movie.score = reader.get<double>();
+            movie.year = reader.get<std::int32_t>();
+            movie.name = reader.get_string();
+            response.movies.push_back(std::move(movie));
+        }
+    } else if (status == static_cast<std::uint8_t>(ResponseStatus::error)) {
+        response.status = ResponseStatus::error;
+        response.error = reader.get_string();
+    } else {
+        return false;
+    }
+    return reader.complete();
+}
+
+std::size_t ServerProtocol::frame_size(const char* data, std::size_t available) {
+    std::uint32_t length;
+    if (available < sizeof(length)) {
+        return 0;
+    }
+    std::memcpy(&length, data, sizeof(length));
+    if (length > MAX_FRAME_BYTES) {
+        throw std::length_error("Frame of " + std::to_string(length) + " bytes is too long");
+    }
+    std::size_t total = sizeof(length) + length;
+    return available < total ? 0 : total;
+}
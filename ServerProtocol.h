@@ -0,0 +1,91 @@
+#ifndef SERVERPROTOCOL_H
+#define SERVERPROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Largest frame body either side accepts; a peer sending more is disconnected.
+#define MAX_FRAME_BYTES (1 << 20)
+
+// Bytes of an ok response body before its movies.
+#define RESPONSE_HEADER_BYTES 9
+
+// Bytes a movie takes in a response body besides its name.
+#define RESPONSE_MOVIE_BYTES 14
+
+// Most movies a response frame can hold, with empty names.
+#define MAX_RESPONSE_MOVIES ((MAX_FRAME_BYTES - RESPONSE_HEADER_BYTES) / RESPONSE_MOVIE_BYTES)
+
+enum class ServerCall : std::uint8_t { content = 1, cf = 2, predict = 3 };
+enum class ResponseStatus : std::uint8_t { ok = 0, error = 1 };
+
+/**
+ * One call to RecommendationServer. `movie` and `year` name the movie to
+ * predict; k is the CF neighbor count and n the number of movies wanted,
+ * which decoding caps at MAX_RESPONSE_MOVIES. The server sends fewer when
+ * their names would take the response past MAX_FRAME_BYTES.
+ */
+struct ServerRequest {
+    std::uint32_t id = 0; // echoed in the response
+    ServerCall call = ServerCall::content;
+    std::int32_t k = 0;
+    std::int32_t n = 1;
+    std::int32_t year = 0;
+    std::string user;
+    std::string movie;
+};
+
+struct ResponseMovie {
+    std::string name;
+    std::int32_t year;
+    double score;
+};
+
+/**
+ * Recommendations best first; a prediction is a single entry holding the
+ * predicted score.
+ */
+struct ServerResponse {
+    std::uint32_t id = 0;
+    ResponseStatus status = ResponseStatus::ok;
+    std::vector<ResponseMovie> movies;
+    std::string error;
+};
+
+/**
+ * Framing of the server protocol. A frame is a uint32 body length followed by
+ * the body. Both ends run on one host, so integers are in host byte order.
+ *
+ *   request:  id u32, call u8, k i32, n i32, year i32,
+ *             user length u16, user, movie length u16, movie
+ *   response: id u32, status u8, then for ok a u32 count and per movie
+ *             score f64, year i32, name length u16, name;
+ *             for an error a u16 length and the message
+ */
+class ServerProtocol {
+public:
+    // Appends the whole frame to `out`.
+    static void encode(const ServerRequest& request, std::string& out);
+    static void encode(const ServerResponse& response, std::string& out);
+
+    /**
+     * Decodes a frame body.
+     * @return false if the body is malformed
+     */
+    static bool decode(const char* body, std::size_t length, ServerRequest& request);
+    static bool decode(const char* body, std::size_t length, ServerResponse& response);
+
+    // Bytes the movie adds to a response body.
+    static std::size_t encoded_size(const ResponseMovie& movie);
+
+    /**
+     * Size of the first frame in [data, data + available) including its
+     * length prefix, or 0 while it is incomplete.
+     * @throws std::length_error if the frame is longer than MAX_FRAME_BYTES
+     */
+    static std::size_t frame_size(const char* data, std::size_t available);
+};
+
+#endif // SERVERPROTOCOL_H
@@ -0,0 +1,596 @@
+#include "ShardedRecommender.h"
+#include "FeaturePager.h"
+#include "FeatureReduction.h"
+#include "SimdKernels.h"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define RS_HAVE_PROCESSES 1
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+extern char** environ;
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// Descriptor a worker finds its socket on.
+#define SHARD_WORKER_FD 3
+
+// Set by the build to the rs_shard_worker it builds; otherwise looked up on PATH.
+#ifndef RS_SHARD_WORKER_PATH
+#define RS_SHARD_WORKER_PATH "rs_shard_worker"
+#endif
+
+// Rows are streamed to a worker in blocks of about this many bytes.
+#define SHARD_SEND_BYTES (1 << 20)
+
+// Wire format, native byte order (both ends are built together for one host).
+// A worker first reads a ShardInit followed by `count` movie ids, `count`
+// norms and `count` feature rows of `stride` doubles.
+// A request is a ShardRequest followed by `rated` movie ids and then:
+//   content: the preference norm and `stride` preference doubles
+//   cf:      `rated` ratings, `rated` norms and `rated` feature rows of `stride` doubles
+//   rows:    nothing
+// The answer to content and cf is a count followed by that many scores and
+// then as many ids; to rows, a count followed by that many of the requested
+// ids the shard holds, their norms and their rows.
+enum ShardCall : std::uint32_t { shutdown_call = 0, content_call = 1, cf_call = 2, rows_call = 3 };
+
+struct ShardInit {
+    std::uint64_t stride;
+    std::uint64_t count;
+};
+
+struct ShardRequest {
+    std::uint32_t call;
+    std::int32_t n;
+    std::int32_t k;
+    std::uint32_t rated;
+};
+
+typedef std::vector<double, AlignedAllocator<double, FEATURE_ALIGNMENT>> aligned_rows;
+
+template <typename T>
+static void append(std::vector<char>& buffer, const T* values, std::size_t count) {
+    const char* bytes = reinterpret_cast<const char*>(values);
+    buffer.insert(buffer.end(), bytes, bytes + count * sizeof(T));
+}
+
+#ifdef RS_HAVE_PROCESSES
+
+static bool write_all(int socket, const void* data, std::size_t length) {
+    const char* bytes = static_cast<const char*>(data);
+    while (length > 0) {
+        ssize_t written = ::send(socket, bytes, length, MSG_NOSIGNAL);
+        if (written <= 0) return false;
+        bytes += written;
+        length -= static_cast<std::size_t>(written);
+    }
+    return true;
+}
+
+// False on end of stream or error.
+static bool read_all(int socket, void* data, std::size_t length) {
+    char* bytes = static_cast<char*>(data);
+    while (length > 0) {
+        ssize_t got = ::read(socket, bytes, length);
+        if (got <= 0) return false;
+        bytes += got;
+        length -= static_cast<std::size_t>(got);
+    }
+    return true;
+}
+
+#ifndef SOCK_CLOEXEC
+static void close_on_exec(int fd) {
+    ::fcntl(fd, F_SETFD, ::fcntl(fd, F_GETFD) | FD_CLOEXEC);
+}
+#endif
+
+// Starts the worker binary with `socket` as its SHARD_WORKER_FD and no other
+// descriptor beyond the standard ones that is not already close-on-exec.
+static pid_t spawn_worker(const std::string& path, int socket) {
+    int child = socket;
+    if (child == SHARD_WORKER_FD) {
+        // dup2 onto itself would keep close-on-exec set.
+        child = ::fcntl(socket, F_DUPFD_CLOEXEC, SHARD_WORKER_FD + 1);
+        if (child < 0) {
+            throw std::runtime_error("Failed to start a shard worker: " +
+                                     std::string(std::strerror(errno)));
+        }
+    }
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, child, SHARD_WORKER_FD);
+    char* argv[] = {const_cast<char*>(path.c_str()), nullptr};
+    pid_t pid = 0;
+    int error = path.find('/') == std::string::npos
+                    ? ::posix_spawnp(&pid, path.c_str(), &actions, nullptr, argv, environ)
+                    : ::posix_spawn(&pid, path.c_str(), &actions, nullptr, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if (child != socket) ::close(child);
+    if (error != 0) {
+        throw std::runtime_error("Failed to start shard worker " + path + ": " +
+                                 std::string(std::strerror(error)));
+    }
+    return pid;
+}
+
+// Everything a worker needs of its shard: ids, norms and then the rows, read
+// through a RowCursor so a paged catalog is never loaded whole.
+static bool send_shard(int socket, const MovieCatalog& movies, const std::vector<movie_id>& ids) {
+    const std::size_t stride = movies.stride();
+    ShardInit init{stride, ids.size()};
+    std::vector<char> buffer;
+    append(buffer, &init, 1);
+    append(buffer, ids.data(), ids.size());
+    for (movie_id id : ids) {
+        double norm = movies.norm(id);
+        append(buffer, &norm, 1);
+    }
+    RowCursor cursor(movies);
+    for (movie_id id : ids) {
+        append(buffer, cursor.row(id), stride);
+        if (buffer.size() >= SHARD_SEND_BYTES) {
+            if (!write_all(socket, buffer.data(), buffer.size())) return false;
+            buffer.clear();
+        }
+    }
+    return write_all(socket, buffer.data(), buffer.size());
+}
+
+#endif // RS_HAVE_PROCESSES
+
+std::size_t ShardedRecommender::shard_of(movie_id id, std::size_t shard_count) {
+    std::uint64_t key = id;
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return static_cast<std::size_t>(key % shard_count);
+}
+
+ShardedRecommender::ShardedRecommender(std::shared_ptr<const RecommendationSystem> rs,
+                                       std::size_t shard_count, const std::string& worker) {
+    if (shard_count == 0) {
+        throw std::invalid_argument("A sharded recommender needs at least one shard");
+    }
+    // Pinned only while the workers are loaded.
+    std::shared_ptr<const RecommendationSystem::Version> version = std::atomic_load(&rs->current);
+    const MovieCatalog& movies = version->movies;
+    titles = movies.with_features(0, {});
+    reduction = version->reduction;
+    dimension = movies.dimension();
+    stride = movies.stride();
+    try {
+        start(movies, shard_count, worker);
+    } catch (...) {
+        stop();
+        throw;
+    }
+}
+
+ShardedRecommender::~ShardedRecommender() {
+    stop();
+}
+
+#ifdef RS_HAVE_PROCESSES
+
+void ShardedRecommender::start(const MovieCatalog& movies, std::size_t shard_count,
+                               const std::string& worker) {
+    std::string path = worker;
+    if (path.empty()) {
+        const char* configured = std::getenv("RS_SHARD_WORKER");
+        path = configured && *configured ? configured : RS_SHARD_WORKER_PATH;
+    }
+    std::vector<std::vector<movie_id>> held(shard_count);
+    for (movie_id id = 0; id < movies.size(); ++id) {
+        held[shard_of(id, shard_count)].push_back(id);
+    }
+
+    for (std::size_t shard = 0; shard < shard_count; ++shard) {
+        int ends[2];
+#ifdef SOCK_CLOEXEC
+        int made = ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, ends);
+#else
+        int made = ::socketpair(AF_UNIX, SOCK_STREAM, 0, ends);
+#endif
+        if (made != 0) {
+            throw std::runtime_error("Failed to create a shard socket: " +
+                                     std::string(std::strerror(errno)));
+        }
+#ifndef SOCK_CLOEXEC
+        close_on_exec(ends[0]);
+        close_on_exec(ends[1]);
+#endif
+        pid_t pid;
+        try {
+            pid = spawn_worker(path, ends[1]);
+        } catch (...) {
+            ::close(ends[0]);
+            ::close(ends[1]);
+            throw;
+        }
+        ::close(ends[1]);
+        sockets.push_back(ends[0]);
+        workers.push_back(pid);
+        sizes.push_back(held[shard].size());
+        if (!send_shard(ends[0], movies, held[shard])) {
+            throw std::runtime_error("Shard worker " + std::to_string(shard) + " is gone");
+        }
+    }
+}
+
+void ShardedRecommender::stop() {
+    ShardRequest request{shutdown_call, 0, 0, 0};
+    for (int socket : sockets) {
+        write_all(socket, &request, sizeof(request));
+        ::close(socket);
+    }
+    for (long pid : workers) {
+        ::waitpid(static_cast<pid_t>(pid), nullptr, 0);
+    }
+    sockets.clear();
+    workers.clear();
+}
+
+int ShardedRecommender::run_worker() {
+    // Anything not marked close-on-exec by whoever started us.
+#if defined(__linux__) && defined(SYS_close_range)
+    bool closed = ::syscall(SYS_close_range, SHARD_WORKER_FD + 1, ~0U, 0) == 0;
+#else
+    bool closed = false;
+#endif
+    if (!closed) {
+        long limit = ::sysconf(_SC_OPEN_MAX);
+        for (long fd = SHARD_WORKER_FD + 1; fd < limit; ++fd) ::close(static_cast<int>(fd));
+    }
+    try {
+        serve(SHARD_WORKER_FD);
+    } catch (...) {
+        return 1;
+    }
+    return 0;
+}
+
+// Worker loop: reads the shard's ids, norms and rows, then answers requests
+// until shutdown or until the coordinator goes away.
+void ShardedRecommender::serve(int socket) {
+    ShardInit init;
+    if (!read_all(socket, &init, sizeof(init))) {
+        return;
+    }
+    const std::size_t stride = init.stride;
+    std::vector<movie_id> ids(init.count);
+    std::vector<double> norms(init.count);
+    aligned_rows rows(init.count * stride);
+    if (!read_all(socket, ids.data(), ids.size() * sizeof(movie_id)) ||
+        !read_all(socket, norms.data(), norms.size() * sizeof(double)) ||
+        !read_all(socket, rows.data(), rows.size() * sizeof(double))) {
+        return;
+    }
+
+    ShardRequest request;
+    std::vector<movie_id> rated_ids;
+    std::vector<double> ratings, rated_norms;
+    aligned_rows vectors;
+    std::vector<std::pair<double, double>> similarities;
+    std::vector<std::size_t> found;
+    while (read_all(socket, &request, sizeof(request)) && request.call != shutdown_call) {
+        const std::size_t rated = request.rated;
+        const bool cf = request.call == cf_call, content = request.call == content_call;
+        rated_ids.resize(rated);
+        ratings.assign(cf ? rated : 0, 0.0);
+        rated_norms.assign(cf ? rated : content ? 1 : 0, 0.0);
+        vectors.resize((cf ? rated : content ? 1 : 0) * stride);
+        if (!read_all(socket, rated_ids.data(), rated * sizeof(movie_id)) ||
+            !read_all(socket, ratings.data(), ratings.size() * sizeof(double)) ||
+            !read_all(socket, rated_norms.data(), rated_norms.size() * sizeof(double)) ||
+            !read_all(socket, vectors.data(), vectors.size() * sizeof(double))) {
+            return;
+        }
+
+        std::vector<char> answer;
+        if (request.call == rows_call) {
+            found.clear();
+            for (movie_id id : rated_ids) {
+                auto it = std::lower_bound(ids.begin(), ids.end(), id);
+                if (it != ids.end() && *it == id) found.push_back(it - ids.begin());
+            }
+            std::uint32_t count = static_cast<std::uint32_t>(found.size());
+            append(answer, &count, 1);
+            for (std::size_t i : found) append(answer, &ids[i], 1);
+            for (std::size_t i : found) append(answer, &norms[i], 1);
+            for (std::size_t i : found) append(answer, rows.data() + i * stride, stride);
+            if (!write_all(socket, answer.data(), answer.size())) {
+                return;
+            }
+            continue;
+        }
+
+        // Same arithmetic as the unsharded scans, so the same bits.
+        TopN best(static_cast<std::size_t>(request.n), ids.size());
+        std::size_t next_rated = 0;
+        for (std::size_t i = 0; i < ids.size(); ++i) {
+            while (next_rated < rated && rated_ids[next_rated] < ids[i]) ++next_rated;
+            if (next_rated < rated && rated_ids[next_rated] == ids[i]) continue;
+            const double* row = rows.data() + i * stride;
+            if (content) {
+                double dot = dot_product(vectors.data(), row, stride);
+                best.push(cosine_from_norms(dot, rated_norms[0], norms[i]), ids[i]);
+                continue;
+            }
+            similarities.clear();
+            for (std::size_t r = 0; r < rated; ++r) {
+                double dot = dot_product(row, vectors.data() + r * stride, stride);
+                similarities.emplace_back(cosine_from_norms(dot, norms[i], rated_norms[r]), ratings[r]);
+            }
+            best.push(RecommendationSystem::top_k_average(similarities, request.k), ids[i]);
+        }
+
+        std::vector<ScoredId> kept = best.take_sorted();
+        std::uint32_t count = static_cast<std::uint32_t>(kept.size());
+        append(answer, &count, 1);
+        for (const ScoredId& entry : kept) append(answer, &entry.score, 1);
+        for (const ScoredId& entry : kept) append(answer, &entry.id, 1);
+        if (!write_all(socket, answer.data(), answer.size())) {
+            return;
+        }
+    }
+}
+
+// Call with `calls` held.
+void ShardedRecommender::send(const std::vector<char>& request) {
+    if (failed) {
+        throw std::runtime_error("A shard worker is gone");
+    }
+    for (std::size_t shard = 0; shard < sockets.size(); ++shard) {
+        if (!write_all(sockets[shard], request.data(), request.size())) {
+            failed = true;
+            throw std::runtime_error("Shard worker " + std::to_string(shard) + " is gone");
+        }
+    }
+}
+
+// Norms and rows of the sorted `ids`, in that order, from the shards holding them.
+void ShardedRecommender::fetch_rows(const std::vector<movie_id>& ids, std::vector<double>& norms,
+                                    aligned_rows& rows) {
+    ShardRequest header{rows_call, 0, 0, static_cast<std::uint32_t>(ids.size())};
+    std::vector<char> request;
+    append(request, &header, 1);
+    append(request, ids.data(), ids.size());
+
+    std::lock_guard<std::mutex> lock(calls);
+    send(request);
+    norms.assign(ids.size(), 0.0);
+    rows.assign(ids.size() * stride, 0.0);
+    std::vector<movie_id> held;
+    std::vector<double> held_norms;
+    aligned_rows held_rows;
+    for (std::size_t shard = 0; shard < sockets.size(); ++shard) {
+        std::uint32_t count = 0;
+        bool ok = read_all(sockets[shard], &count, sizeof(count));
+        held.resize(count);
+        held_norms.resize(count);
+        held_rows.resize(count * stride);
+        ok = ok && read_all(sockets[shard], held.data(), count * sizeof(movie_id)) &&
+             read_all(sockets[shard], held_norms.data(), count * sizeof(double)) &&
+             read_all(sockets[shard], held_rows.data(), held_rows.size() * sizeof(double));
+        if (!ok) {
+            failed = true;
+            throw std::runtime_error("Shard worker " + std::to_string(shard) + " is gone");
+        }
+        for (std::uint32_t i = 0; i < count; ++i) {
+            std::size_t at = std::lower_bound(ids.begin(), ids.end(), held[i]) - ids.begin();
+            norms[at] = held_norms[i];
+            std::copy(held_rows.begin() + i * stride, held_rows.begin() + (i + 1) * stride,
+                      rows.begin() + at * stride);
+        }
+    }
+}
+
+// Sends the request to every shard before reading any answer, so the shards
+// scan concurrently, then merges the partial selections.
+std::vector<scored_movie> ShardedRecommender::scatter_gather(const std::vector<char>& request,
+                                                             int n) {
+    std::lock_guard<std::mutex> lock(calls);
+    send(request);
+
+    TopN best(static_cast<std::size_t>(n), titles.size());
+    std::vector<double> scores;
+    std::vector<movie_id> ids;
+    for (std::size_t shard = 0; shard < sockets.size(); ++shard) {
+        std::uint32_t count = 0;
+        bool ok = read_all(sockets[shard], &count, sizeof(count));
+        scores.resize(count);
+        ids.resize(count);
+        ok = ok && read_all(sockets[shard], scores.data(), count * sizeof(double)) &&
+             read_all(sockets[shard], ids.data(), count * sizeof(movie_id));
+        if (!ok) {
+            failed = true;
+            throw std::runtime_error("Shard worker " + std::to_string(shard) + " is gone");
+        }
+        for (std::uint32_t i = 0; i < count; ++i) {
+            best.push(scores[i], ids[i]);
+        }
+    }
+    std::vector<scored_movie> result;
+    for (const ScoredId& entry : best.take_sorted()) {
+        result.emplace_back(titles.movie(entry.id), entry.score);
+    }
+    return result;
+}
+
+#else
+
+void ShardedRecommender::start(const MovieCatalog&, std::size_t, const std::string&) {
+    throw std::runtime_error("Sharded recommendations need posix_spawn and Unix sockets");
+}
+
+void ShardedRecommender::stop() {}
+
+int ShardedRecommender::run_worker() {
+    return 1;
+}
+
+void ShardedRecommender::serve(int) {}
+
+void ShardedRecommender::send(const std::vector<char>&) {}
+
+void ShardedRecommender::fetch_rows(const std::vector<movie_id>&, std::vector<double>&,
+                                    aligned_rows&) {
+    throw std::runtime_error("Sharded recommendations need posix_spawn and Unix sockets");
+}
+
+std::vector<scored_movie> ShardedRecommender::scatter_gather(const std::vector<char>&, int) {
+    throw std::runtime_error("Sharded recommendations need posix_spawn and Unix sockets");
+}
+
+#endif // RS_HAVE_PROCESSES
+
+// RecommendationSystem::ratings_of against the titles: fails the same way on
+// a rated movie outside the catalog.
+RecommendationSystem::rated_list ShardedRecommender::ratings_of(const User& user) const {
+    RecommendationSystem::rated_list rated;
+    if (user.get_storage() == RatingStorage::map) {
+        rated.reserve(user.get_rank().size());
+        for (const auto& [movie, rating] : user.get_rank()) {
+            movie_id id = titles.find(movie);
+            if (id == INVALID_MOVIE_ID) {
+                throw std::runtime_error("Movie not found in recommendation system");
+            }
+            rated.emplace_back(id, rating);
+        }
+        std::sort(rated.begin(), rated.end());
+        return rated;
+    }
+    rated.reserve(user.get_compact_ratings().size());
+    for (const CompactRating& entry : user.get_compact_ratings()) {
+        if (entry.id >= titles.size()) {
+            throw std::runtime_error("Movie not found in recommendation system");
+        }
+        rated.emplace_back(entry.id, entry.rating);
+    }
+    return rated;
+}
+
+sp_movie ShardedRecommender::recommend_by_content(const User& user) {
+    std::vector<scored_movie> best = recommend_top_n_by_content(user, 1);
+    return best.empty() ? nullptr : best.front().first;
+}
+
+// The query RecommendationSystem::content_query builds; a preference that has
+// to be rebuilt from the ratings reads the rated rows from the shards.
+std::vector<scored_movie> ShardedRecommender::recommend_top_n_by_content(const User& user, int n) {
+    if (titles.empty() || n <= 0) {
+        return {};
+    }
+    std::vector<movie_id> rated;
+    auto take_ids = [&](const auto& list, auto id_of) {
+        for (const auto& entry : list) {
+            if (id_of(entry) >= titles.size()) break;
+            rated.push_back(id_of(entry));
+        }
+    };
+    const UserPreference& maintained = user.get_preference();
+    const bool usable = maintained.is_valid() && maintained.size() != 0;
+    std::vector<double> preference;
+    double norm;
+    bool rebuilt = false;
+    if (usable && reduction && maintained.dimension() == reduction->input_dimension()) {
+        preference.assign(stride, 0.0);
+        reduction->project(maintained.data(), preference.data());
+        norm = std::sqrt(dot_product(preference.data(), preference.data(), stride));
+    } else if (usable && maintained.dimension() == dimension) {
+        preference.assign(maintained.data(), maintained.data() + stride);
+        norm = maintained.norm();
+    } else {
+        RecommendationSystem::rated_list ratings = ratings_of(user);
+        for (const auto& entry : ratings) rated.push_back(entry.first);
+        rebuilt = true;
+        std::vector<double> norms;
+        aligned_rows features;
+        fetch_rows(rated, norms, features);
+        // RecommendationSystem::preference_of, term for term.
+        double average = 0.0;
+        for (const auto& entry : ratings) {
+            average += entry.second;
+        }
+        average /= ratings.size();
+        preference.assign(stride, 0.0);
+        for (std::size_t r = 0; r < ratings.size(); ++r) {
+            const double* row = features.data() + r * stride;
+            double adjusted_rating = ratings[r].second - average;
+            for (std::size_t i = 0; i < dimension; ++i) {
+                preference[i] += adjusted_rating * row[i];
+            }
+        }
+        norm = std::sqrt(dot_product(preference.data(), preference.data(), stride));
+    }
+    if (!rebuilt) {
+        if (user.get_storage() == RatingStorage::compact) {
+            take_ids(user.get_compact_ratings(), [](const CompactRating& entry) { return entry.id; });
+        } else {
+            take_ids(user.get_rated_ids(), [](movie_id id) { return id; });
+        }
+    }
+
+    ShardRequest header{content_call, n, 0, static_cast<std::uint32_t>(rated.size())};
+    std::vector<char> request;
+    append(request, &header, 1);
+    append(request, rated.data(), rated.size());
+    append(request, &norm, 1);
+    append(request, preference.data(), stride);
+    return scatter_gather(request, n);
+}
+
+sp_movie ShardedRecommender::recommend_by_cf(const User& user, int k) {
+    std::vector<scored_movie> best = recommend_top_n_by_cf(user, k, 1);
+    return best.empty() ? nullptr : best.front().first;
+}
+
+// Fails like the unsharded top_n_by_cf: rated movies must be in the catalog,
+// the user needs a rating and k must not be negative.
+std::vector<scored_movie> ShardedRecommender::recommend_top_n_by_cf(const User& user, int k,
+                                                                    int n) {
+    RecommendationSystem::rated_list rated = ratings_of(user);
+    if (n <= 0 || rated.size() >= titles.size()) {
+        return {};
+    }
+    if (rated.empty()) {
+        throw std::invalid_argument("User has no ratings");
+    }
+    if (k < 0) {
+        throw std::invalid_argument("k must not be negative");
+    }
+
+    std::vector<movie_id> ids;
+    for (const auto& entry : rated) ids.push_back(entry.first);
+    std::vector<double> norms;
+    aligned_rows features;
+    fetch_rows(ids, norms, features);
+
+    ShardRequest header{cf_call, n, k, static_cast<std::uint32_t>(rated.size())};
+    std::vector<char> request;
+    append(request, &header, 1);
+    append(request, ids.data(), ids.size());
+    for (const auto& entry : rated) append(request, &entry.second, 1);
+    append(request, norms.data(), norms.size());
+    append(request, features.data(), features.size());
+    return scatter_gather(request, n);
+}
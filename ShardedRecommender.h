@@ -0,0 +1,90 @@
+#ifndef SHARDEDRECOMMENDER_H
+#define SHARDEDRECOMMENDER_H
+
+#include "RecommendationSystem.h"
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Scatter-gather recommender over a catalog split across local worker
+ * processes. Movie ids are spread over the shards by hash; each worker is an
+ * rs_shard_worker process that receives the feature rows and norms of its
+ * movies over a Unix socket and keeps them. A call sends the user's preference
+ * (content) or rated movies' features (cf) to every shard, each shard returns
+ * the top n of its own movies, and the partial selections are merged by
+ * (score, id).
+ *
+ * The coordinator keeps only the catalog's ids and titles (and the feature
+ * reduction, if any): rated rows it needs are fetched from the shards.
+ * Workers are started with posix_spawn, so they share no lock or thread with
+ * the caller, and they inherit only their socket.
+ *
+ * Answers are for the system's catalog as it was when the workers were
+ * started. They equal recommend_top_n_by_content_exact and
+ * recommend_top_n_by_cf of that catalog without a similarity index or
+ * quantized features: the workers run the same kernels on the same bits.
+ *
+ * Calls are serialized. A worker that dies or stops answering makes the call
+ * and every later one throw std::runtime_error.
+ */
+class ShardedRecommender {
+private:
+    MovieCatalog titles; // ids and titles, without features
+    std::shared_ptr<const FeatureReduction> reduction;
+    std::size_t dimension = 0, stride = 0;
+    std::vector<int> sockets;          // coordinator end, one per shard
+    std::vector<long> workers;         // worker process ids
+    std::vector<std::size_t> sizes;    // movies held by each shard
+    std::mutex calls;
+    bool failed = false;
+
+    static std::size_t shard_of(movie_id id, std::size_t shard_count);
+    static void serve(int socket);
+    void start(const MovieCatalog& movies, std::size_t shard_count, const std::string& worker);
+    void stop();
+    void send(const std::vector<char>& request);
+    RecommendationSystem::rated_list ratings_of(const User& user) const;
+    void fetch_rows(const std::vector<movie_id>& ids, std::vector<double>& norms,
+                    std::vector<double, AlignedAllocator<double, FEATURE_ALIGNMENT>>& rows);
+    std::vector<scored_movie> scatter_gather(const std::vector<char>& request, int n);
+
+public:
+    /**
+     * Starts `shard_count` workers over the system's current catalog. The
+     * system is not kept.
+     * @param worker - path of the rs_shard_worker binary; by default the
+     * RS_SHARD_WORKER environment variable, else the one built with this library
+     * @throws std::invalid_argument if shard_count is 0
+     * @throws std::runtime_error if a worker cannot be started, or on
+     * platforms without posix_spawn and Unix sockets
+     */
+    ShardedRecommender(std::shared_ptr<const RecommendationSystem> rs, std::size_t shard_count,
+                       const std::string& worker = "");
+
+    // Shuts the workers down and waits for them.
+    ~ShardedRecommender();
+
+    ShardedRecommender(const ShardedRecommender&) = delete;
+    ShardedRecommender& operator=(const ShardedRecommender&) = delete;
+
+    sp_movie recommend_by_content(const User& user);
+    std::vector<scored_movie> recommend_top_n_by_content(const User& user, int n);
+    sp_movie recommend_by_cf(const User& user, int k);
+    std::vector<scored_movie> recommend_top_n_by_cf(const User& user, int k, int n);
+
+    std::size_t shard_count() const { return sockets.size(); }
+    std::size_t shard_size(std::size_t shard) const { return sizes[shard]; }
+
+    /**
+     * Body of rs_shard_worker: closes every descriptor but the standard ones
+     * and the socket it was started with, then answers the coordinator until
+     * it shuts the worker down or goes away.
+     * @return the process exit status
+     */
+    static int run_worker();
+};
+
+#endif // SHARDEDRECOMMENDER_H
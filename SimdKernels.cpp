@@ -0,0 +1,405 @@
+#include "SimdKernels.h"
+#include <algorithm>
+#include <atomic>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define RS_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+double dot_product_scalar(const double* a, const double* b, std::size_t n) {
+    double sum = 0.0;
+    for (std::size_t i = 0; i < n; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+double dot_product_f32_scalar(const float* a, const float* b, std::size_t n) {
+    float sum = 0.0f;
+    for (std::size_t i = 0; i < n; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+std::uint64_t dot_product_u8_scalar(const std::uint8_t* a, const std::uint8_t* b, std::size_t n) {
+    std::uint64_t sum = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        sum += static_cast<std::uint32_t>(a[i]) * b[i];
+    }
+    return sum;
+}
+
+double dot_product_f32_u8_scalar(const float* a, const std::uint8_t* b, std::size_t n) {
+    float sum = 0.0f;
+    for (std::size_t i = 0; i < n; ++i) {
+        sum += a[i] * static_cast<float>(b[i]);
+    }
+    return sum;
+}
+
+void dot_panel_scalar(const double* rows, std::size_t row_count, std::size_t row_stride,
+                      const double* panel, std::size_t dim, std::size_t width,
+                      double* out, std::size_t out_stride) {
+    for (std::size_t r = 0; r < row_count; ++r) {
+        double* sums = out + r * out_stride;
+        std::fill(sums, sums + width, 0.0);
+        for (std::size_t k = 0; k < dim; ++k) {
+            double value = rows[r * row_stride + k];
+            const double* column = panel + k * width;
+            for (std::size_t c = 0; c < width; ++c) {
+                sums[c] += value * column[c];
+            }
+        }
+    }
+}
+
+#ifdef RS_X86_KERNELS
+
+__attribute__((target("avx2")))
+static double horizontal_sum(__m256 acc) {
+    float lanes[8];
+    _mm256_storeu_ps(lanes, acc);
+    return ((static_cast<double>(lanes[0]) + lanes[1]) + (static_cast<double>(lanes[2]) + lanes[3])) +
+           ((static_cast<double>(lanes[4]) + lanes[5]) + (static_cast<double>(lanes[6]) + lanes[7]));
+}
+
+__attribute__((target("avx2,fma")))
+double dot_product_f32_avx2(const float* a, const float* b, std::size_t n) {
+    __m256 acc = _mm256_setzero_ps();
+    for (std::size_t i = 0; i < n; i += 8) {
+        acc = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc);
+    }
+    return horizontal_sum(acc);
+}
+
+// Each 32-byte step adds at most 2 * 2 * 255 * 255 to an int32 lane, so the
+// lanes are flushed to 64 bits well before they could overflow.
+#define U8_FLUSH_STEPS 4096
+
+__attribute__((target("avx2")))
+std::uint64_t dot_product_u8_avx2(const std::uint8_t* a, const std::uint8_t* b, std::size_t n) {
+    const __m256i zero = _mm256_setzero_si256();
+    std::uint64_t total = 0;
+    std::size_t i = 0;
+    while (i < n) {
+        __m256i acc = _mm256_setzero_si256();
+        std::size_t block_end = std::min(n, i + U8_FLUSH_STEPS * 32);
+        for (; i < block_end; i += 32) {
+            __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_unpacklo_epi8(va, zero),
+                                                          _mm256_unpacklo_epi8(vb, zero)));
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_unpackhi_epi8(va, zero),
+                                                          _mm256_unpackhi_epi8(vb, zero)));
+        }
+        std::uint32_t lanes[8];
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+        for (std::uint32_t lane : lanes) {
+            total += lane;
+        }
+    }
+    return total;
+}
+
+__attribute__((target("avx2,fma")))
+double dot_product_f32_u8_avx2(const float* a, const std::uint8_t* b, std::size_t n) {
+    __m256 acc = _mm256_setzero_ps();
+    for (std::size_t i = 0; i < n; i += 8) {
+        __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(b + i));
+        __m256 values = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes));
+        acc = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), values, acc);
+    }
+    return horizontal_sum(acc);
+}
+
+static QuantizedKernels select_quantized_kernels() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return {&dot_product_f32_avx2, &dot_product_u8_avx2, &dot_product_f32_u8_avx2, "avx2"};
+    }
+    return {&dot_product_f32_scalar, &dot_product_u8_scalar, &dot_product_f32_u8_scalar, "scalar"};
+}
+
+__attribute__((target("sse2")))
+double dot_product_sse2(const double* a, const double* b, std::size_t n) {
+    __m128d acc0 = _mm_setzero_pd();
+    __m128d acc1 = _mm_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+        acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+    }
+    acc0 = _mm_add_pd(acc0, acc1);
+    double lanes[2];
+    _mm_storeu_pd(lanes, acc0);
+    double sum = lanes[0] + lanes[1];
+    for (; i < n; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+__attribute__((target("avx2,fma")))
+double dot_product_avx2(const double* a, const double* b, std::size_t n) {
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), acc0);
+        acc1 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4), acc1);
+    }
+    for (; i + 4 <= n; i += 4) {
+        acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), acc0);
+    }
+    acc0 = _mm256_add_pd(acc0, acc1);
+    __m128d half = _mm_add_pd(_mm256_castpd256_pd128(acc0), _mm256_extractf128_pd(acc0, 1));
+    double lanes[2];
+    _mm_storeu_pd(lanes, half);
+    double sum = lanes[0] + lanes[1];
+    for (; i < n; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+__attribute__((target("avx512f")))
+double dot_product_avx512(const double* a, const double* b, std::size_t n) {
+    __m512d acc0 = _mm512_setzero_pd();
+    __m512d acc1 = _mm512_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i), acc0);
+        acc1 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i + 8), _mm512_loadu_pd(b + i + 8), acc1);
+    }
+    acc0 = _mm512_add_pd(acc0, acc1);
+    if (i + 8 <= n) {
+        acc0 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i), acc0);
+        i += 8;
+    }
+    if (i < n) {
+        // Masked tail: lanes past n load as zero.
+        __mmask8 mask = static_cast<__mmask8>((1u << (n - i)) - 1u);
+        acc0 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, a + i),
+                               _mm512_maskz_loadu_pd(mask, b + i), acc0);
+    }
+    double lanes[8];
+    _mm512_storeu_pd(lanes, acc0);
+    return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) +
+           ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+}
+
+dot_func select_dot_kernel() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return &dot_product_avx512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return &dot_product_avx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return &dot_product_sse2;
+    }
+    return &dot_product_scalar;
+}
+
+// 4 rows x 8 columns per step: 8 accumulators, each row value broadcast once
+// per dimension.
+__attribute__((target("avx2,fma")))
+void dot_panel_avx2(const double* rows, std::size_t row_count, std::size_t row_stride,
+                    const double* panel, std::size_t dim, std::size_t width,
+                    double* out, std::size_t out_stride) {
+    std::size_t r = 0;
+    for (; r + 4 <= row_count; r += 4) {
+        const double* row0 = rows + r * row_stride;
+        for (std::size_t c = 0; c < width; c += 8) {
+            __m256d acc[4][2];
+            for (auto& lanes : acc) lanes[0] = lanes[1] = _mm256_setzero_pd();
+            for (std::size_t k = 0; k < dim; ++k) {
+                __m256d low = _mm256_loadu_pd(panel + k * width + c);
+                __m256d high = _mm256_loadu_pd(panel + k * width + c + 4);
+                for (std::size_t i = 0; i < 4; ++i) {
+                    __m256d value = _mm256_broadcast_sd(row0 + i * row_stride + k);
+                    acc[i][0] = _mm256_fmadd_pd(value, low, acc[i][0]);
+                    acc[i][1] = _mm256_fmadd_pd(value, high, acc[i][1]);
+                }
+            }
+            for (std::size_t i = 0; i < 4; ++i) {
+                _mm256_storeu_pd(out + (r + i) * out_stride + c, acc[i][0]);
+                _mm256_storeu_pd(out + (r + i) * out_stride + c + 4, acc[i][1]);
+            }
+        }
+    }
+    for (; r < row_count; ++r) {
+        const double* row = rows + r * row_stride;
+        for (std::size_t c = 0; c < width; c += 8) {
+            __m256d low = _mm256_setzero_pd(), high = _mm256_setzero_pd();
+            for (std::size_t k = 0; k < dim; ++k) {
+                __m256d value = _mm256_broadcast_sd(row + k);
+                low = _mm256_fmadd_pd(value, _mm256_loadu_pd(panel + k * width + c), low);
+                high = _mm256_fmadd_pd(value, _mm256_loadu_pd(panel + k * width + c + 4), high);
+            }
+            _mm256_storeu_pd(out + r * out_stride + c, low);
+            _mm256_storeu_pd(out + r * out_stride + c + 4, high);
+        }
+    }
+}
+
+// 4 rows x 16 columns per step, 8 columns for a trailing half step.
+__attribute__((target("avx512f")))
+void dot_panel_avx512(const double* rows, std::size_t row_count, std::size_t row_stride,
+                      const double* panel, std::size_t dim, std::size_t width,
+                      double* out, std::size_t out_stride) {
+    std::size_t r = 0;
+    for (; r + 4 <= row_count; r += 4) {
+        const double* row0 = rows + r * row_stride;
+        std::size_t c = 0;
+        for (; c + 16 <= width; c += 16) {
+            __m512d acc[4][2];
+            for (auto& lanes : acc) lanes[0] = lanes[1] = _mm512_setzero_pd();
+            for (std::size_t k = 0; k < dim; ++k) {
+                __m512d low = _mm512_loadu_pd(panel + k * width + c);
+                __m512d high = _mm512_loadu_pd(panel + k * width + c + 8);
+                for (std::size_t i = 0; i < 4; ++i) {
+                    __m512d value = _mm512_set1_pd(row0[i * row_stride + k]);
+                    acc[i][0] = _mm512_fmadd_pd(value, low, acc[i][0]);
+                    acc[i][1] = _mm512_fmadd_pd(value, high, acc[i][1]);
+                }
+            }
+            for (std::size_t i = 0; i < 4; ++i) {
+                _mm512_storeu_pd(out + (r + i) * out_stride + c, acc[i][0]);
+                _mm512_storeu_pd(out + (r + i) * out_stride + c + 8, acc[i][1]);
+            }
+        }
+        if (c < width) {
+            __m512d acc[4];
+            for (auto& lanes : acc) lanes = _mm512_setzero_pd();
+            for (std::size_t k = 0; k < dim; ++k) {
+                __m512d columns = _mm512_loadu_pd(panel + k * width + c);
+                for (std::size_t i = 0; i < 4; ++i) {
+                    acc[i] = _mm512_fmadd_pd(_mm512_set1_pd(row0[i * row_stride + k]), columns, acc[i]);
+                }
+            }
+            for (std::size_t i = 0; i < 4; ++i) {
+                _mm512_storeu_pd(out + (r + i) * out_stride + c, acc[i]);
+            }
+        }
+    }
+    for (; r < row_count; ++r) {
+        const double* row = rows + r * row_stride;
+        for (std::size_t c = 0; c < width; c += 8) {
+            __m512d acc = _mm512_setzero_pd();
+            for (std::size_t k = 0; k < dim; ++k) {
+                acc = _mm512_fmadd_pd(_mm512_set1_pd(row[k]), _mm512_loadu_pd(panel + k * width + c), acc);
+            }
+            _mm512_storeu_pd(out + r * out_stride + c, acc);
+        }
+    }
+}
+
+static dot_panel_func select_dot_panel_kernel() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return &dot_panel_avx512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return &dot_panel_avx2;
+    }
+    return &dot_panel_scalar;
+}
+
+#else
+
+double dot_product_sse2(const double* a, const double* b, std::size_t n) {
+    return dot_product_scalar(a, b, n);
+}
+
+double dot_product_avx2(const double* a, const double* b, std::size_t n) {
+    return dot_product_scalar(a, b, n);
+}
+
+double dot_product_avx512(const double* a, const double* b, std::size_t n) {
+    return dot_product_scalar(a, b, n);
+}
+
+dot_func select_dot_kernel() {
+    return &dot_product_scalar;
+}
+
+double dot_product_f32_avx2(const float* a, const float* b, std::size_t n) {
+    return dot_product_f32_scalar(a, b, n);
+}
+
+std::uint64_t dot_product_u8_avx2(const std::uint8_t* a, const std::uint8_t* b, std::size_t n) {
+    return dot_product_u8_scalar(a, b, n);
+}
+
+double dot_product_f32_u8_avx2(const float* a, const std::uint8_t* b, std::size_t n) {
+    return dot_product_f32_u8_scalar(a, b, n);
+}
+
+static QuantizedKernels select_quantized_kernels() {
+    return {&dot_product_f32_scalar, &dot_product_u8_scalar, &dot_product_f32_u8_scalar, "scalar"};
+}
+
+void dot_panel_avx2(const double* rows, std::size_t row_count, std::size_t row_stride,
+                    const double* panel, std::size_t dim, std::size_t width,
+                    double* out, std::size_t out_stride) {
+    dot_panel_scalar(rows, row_count, row_stride, panel, dim, width, out, out_stride);
+}
+
+void dot_panel_avx512(const double* rows, std::size_t row_count, std::size_t row_stride,
+                      const double* panel, std::size_t dim, std::size_t width,
+                      double* out, std::size_t out_stride) {
+    dot_panel_scalar(rows, row_count, row_stride, panel, dim, width, out, out_stride);
+}
+
+static dot_panel_func select_dot_panel_kernel() {
+    return &dot_panel_scalar;
+}
+
+#endif // RS_X86_KERNELS
+
+const QuantizedKernels& quantized_kernels() {
+    static const QuantizedKernels kernels = select_quantized_kernels();
+    return kernels;
+}
+
+dot_panel_func dot_panel_kernel() {
+    static const dot_panel_func kernel = select_dot_panel_kernel();
+    return kernel;
+}
+
+static double dot_product_resolve(const double* a, const double* b, std::size_t n);
+
+// Constant-initialized so calls made during static initialization are safe.
+static std::atomic<dot_func> active_dot_kernel(&dot_product_resolve);
+
+static dot_func resolve_dot_kernel() {
+    dot_func kernel = active_dot_kernel.load(std::memory_order_relaxed);
+    if (kernel == &dot_product_resolve) {
+        kernel = select_dot_kernel();
+        active_dot_kernel.store(kernel, std::memory_order_relaxed);
+    }
+    return kernel;
+}
+
+static double dot_product_resolve(const double* a, const double* b, std::size_t n) {
+    return resolve_dot_kernel()(a, b, n);
+}
+
+// Resolve once at startup instead of on the first request.
+[[maybe_unused]] static const dot_func startup_dot_kernel = resolve_dot_kernel();
+
+const char* dot_kernel_name() {
+    dot_func kernel = resolve_dot_kernel();
+    if (kernel == &dot_product_avx512) return "avx512";
+    if (kernel == &dot_product_avx2) return "avx2";
+    if (kernel == &dot_product_sse2) return "sse2";
+    return "scalar";
+}
+
+double dot_product(const double* a, const double* b, std::size_t n) {
+    return active_dot_kernel.load(std::memory_order_relaxed)(a, b, n);
+}
@@ -0,0 +1,101 @@
+#ifndef SIMDKERNELS_H
+#define SIMDKERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+typedef double (*dot_func)(const double* a, const double* b, std::size_t n);
+
+/**
+ * Reference dot product. All vectorized kernels must match it up to
+ * floating point reassociation.
+ */
+double dot_product_scalar(const double* a, const double* b, std::size_t n);
+
+// Vectorized variants. Only call these when the CPU supports the instruction set.
+double dot_product_sse2(const double* a, const double* b, std::size_t n);
+double dot_product_avx2(const double* a, const double* b, std::size_t n);
+double dot_product_avx512(const double* a, const double* b, std::size_t n);
+
+/**
+ * Picks the widest kernel supported by the running CPU (cpuid).
+ */
+dot_func select_dot_kernel();
+
+/**
+ * @return name of the kernel picked at startup ("scalar", "sse2", "avx2" or "avx512")
+ */
+const char* dot_kernel_name();
+
+/**
+ * Dot product through the kernel selected at startup.
+ */
+double dot_product(const double* a, const double* b, std::size_t n);
+
+typedef double (*dot_f32_func)(const float* a, const float* b, std::size_t n);
+typedef std::uint64_t (*dot_u8_func)(const std::uint8_t* a, const std::uint8_t* b, std::size_t n);
+typedef double (*dot_f32_u8_func)(const float* a, const std::uint8_t* b, std::size_t n);
+
+/**
+ * Kernels over the reduced-precision feature copies (see QuantizedFeatures).
+ * Float kernels accumulate in float and return the sum as double; the uint8
+ * kernel is exact. The vectorized variants expect n to be a multiple of 32
+ * (bytes) or 8 (floats), which the padded rows guarantee.
+ */
+double dot_product_f32_scalar(const float* a, const float* b, std::size_t n);
+std::uint64_t dot_product_u8_scalar(const std::uint8_t* a, const std::uint8_t* b, std::size_t n);
+double dot_product_f32_u8_scalar(const float* a, const std::uint8_t* b, std::size_t n);
+double dot_product_f32_avx2(const float* a, const float* b, std::size_t n);
+std::uint64_t dot_product_u8_avx2(const std::uint8_t* a, const std::uint8_t* b, std::size_t n);
+double dot_product_f32_u8_avx2(const float* a, const std::uint8_t* b, std::size_t n);
+
+struct QuantizedKernels {
+    dot_f32_func f32;
+    dot_u8_func u8;
+    dot_f32_u8_func f32_u8;
+    const char* name;
+};
+
+/**
+ * The quantized kernels for the running CPU, picked on first use.
+ */
+const QuantizedKernels& quantized_kernels();
+
+typedef void (*dot_panel_func)(const double* rows, std::size_t row_count, std::size_t row_stride,
+                               const double* panel, std::size_t dim, std::size_t width,
+                               double* out, std::size_t out_stride);
+
+/**
+ * Dot products of row_count rows with the `width` vectors of a packed panel:
+ *
+ *     out[r * out_stride + c] = sum over k of rows[r * row_stride + k] * panel[k * width + c]
+ *
+ * The panel holds the vectors transposed (dimension-major), so each step
+ * broadcasts one row value across contiguous columns, as in a GEMM
+ * micro-kernel. width must be a multiple of 8.
+ */
+void dot_panel_scalar(const double* rows, std::size_t row_count, std::size_t row_stride,
+                      const double* panel, std::size_t dim, std::size_t width,
+                      double* out, std::size_t out_stride);
+void dot_panel_avx2(const double* rows, std::size_t row_count, std::size_t row_stride,
+                    const double* panel, std::size_t dim, std::size_t width,
+                    double* out, std::size_t out_stride);
+void dot_panel_avx512(const double* rows, std::size_t row_count, std::size_t row_stride,
+                      const double* panel, std::size_t dim, std::size_t width,
+                      double* out, std::size_t out_stride);
+
+/**
+ * The panel kernel for the running CPU, picked on first use.
+ */
+dot_panel_func dot_panel_kernel();
+
+/**
+ * Cosine of two vectors whose Euclidean norms are already known.
+ * Returns 0 when either norm is 0.
+ */
+inline double cosine_from_norms(double dot, double norm_a, double norm_b) {
+    if (norm_a == 0.0 || norm_b == 0.0) return 0.0;
+    return dot / (norm_a * norm_b);
+}
+
+#endif // SIMDKERNELS_H
@@ -0,0 +1,119 @@
+#include "SimilarityIndex.h"
+#include "FeaturePager.h"
+#include "SimdKernels.h"
+#include <algorithm>
+
+// Orders neighbors most similar first, lower id first on ties.
+static bool neighbor_before(const Neighbor& a, const Neighbor& b) {
+    if (a.similarity != b.similarity) {
+        return a.similarity > b.similarity;
+    }
+    return a.id < b.id;
+}
+
+static double catalog_cosine(const MovieCatalog& movies, movie_id a, const double* row_a,
+                             movie_id b, const double* row_b) {
+    double dot = dot_product(row_a, row_b, movies.stride());
+    return cosine_from_norms(dot, movies.norm(a), movies.norm(b));
+}
+
+// Full scan of one movie against the catalog, keeping the best `limit` neighbors.
+static std::shared_ptr<const neighbor_list> top_neighbors(const MovieCatalog& movies,
+                                                          movie_id id, std::size_t limit) {
+    neighbor_list best;
+    if (limit == 0) {
+        return std::make_shared<const neighbor_list>();
+    }
+    best.reserve(limit + 1);
+    FeatureView features = movies.features_of(id);
+    RowCursor rows(movies);
+    for (movie_id other = 0; other < movies.size(); ++other) {
+        if (other == id) continue;
+        Neighbor candidate{catalog_cosine(movies, id, features.data(), other, rows.row(other)),
+                           other};
+        if (best.size() < limit) {
+            best.push_back(candidate);
+            std::push_heap(best.begin(), best.end(), neighbor_before);
+        } else if (neighbor_before(candidate, best.front())) {
+            std::pop_heap(best.begin(), best.end(), neighbor_before);
+            best.back() = candidate;
+            std::push_heap(best.begin(), best.end(), neighbor_before);
+        }
+    }
+    std::sort_heap(best.begin(), best.end(), neighbor_before);
+    return std::make_shared<const neighbor_list>(std::move(best));
+}
+
+SimilarityIndex::SimilarityIndex(std::size_t neighbors_per_movie, std::size_t memory_budget_bytes)
+    : requested_neighbors(neighbors_per_movie),
+      memory_budget(memory_budget_bytes),
+      max_neighbors(neighbors_per_movie) {}
+
+void SimilarityIndex::fit_budget(std::size_t movie_count) {
+    std::size_t affordable = movie_count == 0
+        ? requested_neighbors
+        : memory_budget / (movie_count * sizeof(Neighbor));
+    std::size_t fitted = std::min(requested_neighbors, affordable);
+    if (fitted < max_neighbors) {
+        // Dropping the tail keeps every list an exact top-K for the smaller K.
+        for (auto& list : neighbors) {
+            if (list && list->size() > fitted) {
+                list = std::make_shared<const neighbor_list>(list->begin(), list->begin() + fitted);
+            }
+        }
+    }
+    max_neighbors = fitted;
+}
+
+void SimilarityIndex::build(const MovieCatalog& movies, ThreadPool* executor) {
+    neighbors.clear();
+    max_neighbors = requested_neighbors;
+    fit_budget(movies.size());
+    neighbors.resize(movies.size());
+
+    auto work = [&](std::size_t id) {
+        neighbors[id] = top_neighbors(movies, static_cast<movie_id>(id), max_neighbors);
+    };
+    if (executor) {
+        executor->parallel_for(movies.size(), work);
+    } else {
+        for (std::size_t id = 0; id < movies.size(); ++id) {
+            work(id);
+        }
+    }
+}
+
+void SimilarityIndex::add_movie(const MovieCatalog& movies, movie_id id) {
+    fit_budget(movies.size());
+    neighbors.resize(movies.size());
+    neighbors[id] = top_neighbors(movies, id, max_neighbors);
+    if (max_neighbors == 0) {
+        return;
+    }
+
+    FeatureView features = movies.features_of(id);
+    RowCursor rows(movies);
+    for (movie_id other = 0; other < movies.size(); ++other) {
+        if (other == id) continue;
+        const neighbor_list& list = *neighbors[other];
+        Neighbor candidate{catalog_cosine(movies, other, rows.row(other), id, features.data()), id};
+        bool full = list.size() == max_neighbors;
+        if (full && !neighbor_before(candidate, list.back())) continue;
+
+        auto position = std::upper_bound(list.begin(), list.end(), candidate, neighbor_before);
+        auto updated = std::make_shared<neighbor_list>();
+        updated->reserve(list.size() + (full ? 0 : 1));
+        updated->insert(updated->end(), list.begin(), position);
+        updated->push_back(candidate);
+        updated->insert(updated->end(), position, full ? list.end() - 1 : list.end());
+        neighbors[other] = std::move(updated);
+    }
+}
+
+std::size_t SimilarityIndex::memory_usage() const {
+    std::size_t bytes = neighbors.capacity() * sizeof(neighbors[0]);
+    for (const auto& list : neighbors) {
+        bytes += sizeof(neighbor_list) + list->capacity() * sizeof(Neighbor);
+    }
+    return bytes;
+}
@@ -0,0 +1,62 @@
+#ifndef SIMILARITYINDEX_H
+#define SIMILARITYINDEX_H
+
+#include "MovieCatalog.h"
+#include "ThreadPool.h"
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Default cap on the memory held by the neighbor lists (256 MiB).
+#define DEFAULT_SIMILARITY_BUDGET (std::size_t(256) << 20)
+
+struct Neighbor {
+    double similarity;
+    movie_id id;
+};
+
+typedef std::vector<Neighbor> neighbor_list;
+
+/**
+ * Item-item neighbor index: for every movie in a catalog keeps the K most
+ * cosine-similar other movies, most similar first (ties by lower id).
+ * K is lowered when the lists would not fit in the memory budget.
+ *
+ * Lists are immutable and shared between copies of the index, so a copy costs
+ * one pointer per movie and add_movie on it replaces only the lists it changes.
+ */
+class SimilarityIndex {
+private:
+    std::size_t requested_neighbors;
+    std::size_t memory_budget;
+    std::size_t max_neighbors;
+    std::vector<std::shared_ptr<const neighbor_list>> neighbors;
+
+    void fit_budget(std::size_t movie_count);
+
+public:
+    SimilarityIndex(std::size_t neighbors_per_movie,
+                    std::size_t memory_budget_bytes = DEFAULT_SIMILARITY_BUDGET);
+
+    /**
+     * Computes the neighbor lists of all movies in the catalog.
+     * @param executor - pool the per-movie scans run on, nullptr to run them
+     * on the calling thread
+     */
+    void build(const MovieCatalog& movies, ThreadPool* executor = nullptr);
+
+    /**
+     * Adds the lists for a movie that was just appended to the catalog and
+     * inserts it into the lists of the existing movies where it ranks.
+     */
+    void add_movie(const MovieCatalog& movies, movie_id id);
+
+    const neighbor_list& neighbors_of(movie_id id) const { return *neighbors[id]; }
+
+    // Effective K after applying the memory budget.
+    std::size_t neighbors_per_movie() const { return max_neighbors; }
+    std::size_t size() const { return neighbors.size(); }
+    std::size_t memory_usage() const;
+};
+
+#endif // SIMILARITYINDEX_H
@@ -0,0 +1,25 @@
+#ifndef SNAPSHOTWRITER_H
+#define SNAPSHOTWRITER_H
+
+#include "CatalogSnapshot.h"
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+
+/*
+ * Helpers shared by the writers of the checksummed binary formats
+ * (catalog snapshots and ratings matrices).
+ */
+
+// Appends raw bytes to the payload and keeps the running checksum.
+inline void write_bytes(std::ofstream& file, const void* data, std::size_t size,
+                        std::uint64_t& checksum) {
+    file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    checksum = snapshot_checksum(static_cast<const char*>(data), size, checksum);
+}
+
+inline std::size_t align_up(std::size_t offset, std::size_t alignment) {
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+#endif // SNAPSHOTWRITER_H
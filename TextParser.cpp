@@ -0,0 +1,188 @@
+#include "TextParser.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+static std::atomic<std::size_t> chunk_bytes_limit{MIN_PARSE_CHUNK_BYTES};
+static std::atomic<std::size_t> thread_limit{0};
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+static void skip_spaces(std::string_view& rest) {
+    std::size_t i = 0;
+    while (i < rest.size() && is_space(rest[i])) {
+        ++i;
+    }
+    rest.remove_prefix(i);
+}
+
+std::vector<LineChunk> split_line_chunks(const char* data, std::size_t size, std::size_t max_chunks) {
+    std::vector<LineChunk> chunks;
+    const char* end = data + size;
+    const char* begin = data;
+    max_chunks = std::max<std::size_t>(1, max_chunks);
+    for (std::size_t i = 1; i < max_chunks && begin < end; ++i) {
+        const char* cut = data + size * i / max_chunks;
+        if (cut <= begin) continue;
+        const char* newline = static_cast<const char*>(std::memchr(cut, '\n', end - cut));
+        if (!newline) break;
+        chunks.push_back(LineChunk{begin, newline + 1});
+        begin = newline + 1;
+    }
+    if (begin < end || chunks.empty()) {
+        chunks.push_back(LineChunk{begin, end});
+    }
+    return chunks;
+}
+
+LineChunk take_line_window(LineChunk& rest, std::size_t max_bytes) {
+    std::size_t available = rest.end - rest.begin;
+    if (available <= max_bytes) {
+        LineChunk window = rest;
+        rest.begin = rest.end;
+        return window;
+    }
+    const char* cut = rest.begin + max_bytes;
+    const char* newline = static_cast<const char*>(std::memchr(cut, '\n', rest.end - cut));
+    const char* window_end = newline ? newline + 1 : rest.end;
+    LineChunk window{rest.begin, window_end};
+    rest.begin = window_end;
+    return window;
+}
+
+std::size_t parse_thread_count() {
+    std::size_t threads = thread_limit.load(std::memory_order_relaxed);
+    return threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+}
+
+std::size_t parse_chunk_bytes() {
+    return chunk_bytes_limit.load(std::memory_order_relaxed);
+}
+
+void set_parse_limits(std::size_t min_chunk_bytes, std::size_t threads) {
+    chunk_bytes_limit.store(std::max<std::size_t>(1, min_chunk_bytes), std::memory_order_relaxed);
+    thread_limit.store(threads, std::memory_order_relaxed);
+}
+
+std::size_t parse_chunk_count(std::size_t size) {
+    return std::max<std::size_t>(1, std::min(parse_thread_count(), size / parse_chunk_bytes()));
+}
+
+bool next_line(LineChunk& chunk, std::string_view& line) {
+    if (chunk.begin >= chunk.end) {
+        return false;
+    }
+    const char* newline = static_cast<const char*>(
+        std::memchr(chunk.begin, '\n', chunk.end - chunk.begin));
+    const char* line_end = newline ? newline : chunk.end;
+    line = std::string_view(chunk.begin, line_end - chunk.begin);
+    chunk.begin = newline ? newline + 1 : chunk.end;
+    return true;
+}
+
+bool next_token(std::string_view& rest, std::string_view& token) {
+    skip_spaces(rest);
+    if (rest.empty()) {
+        return false;
+    }
+    std::size_t length = 0;
+    while (length < rest.size() && !is_space(rest[length])) {
+        ++length;
+    }
+    token = rest.substr(0, length);
+    rest.remove_prefix(length);
+    return true;
+}
+
+// from_chars rejects a leading '+' and accepts inf/nan words; streams do the opposite.
+static bool parse_double_prefix(std::string_view text, double& value, const char*& stop,
+                                bool& out_of_range) {
+    out_of_range = false;
+    const char* first = text.data();
+    const char* last = first + text.size();
+    bool negate = false;
+    if (first < last && (*first == '+' || *first == '-')) {
+        negate = (*first == '-');
+        ++first;
+    }
+    if (first == last || !(std::isdigit(static_cast<unsigned char>(*first)) || *first == '.')) {
+        return false;
+    }
+    auto result = std::from_chars(first, last, value, std::chars_format::general);
+    if (result.ec == std::errc::invalid_argument) {
+        return false;
+    }
+    out_of_range = (result.ec == std::errc::result_out_of_range);
+    if (negate) {
+        value = -value;
+    }
+    stop = result.ptr;
+    return true;
+}
+
+bool read_double(std::string_view& rest, double& value) {
+    skip_spaces(rest);
+    const char* stop;
+    bool out_of_range;
+    if (!parse_double_prefix(rest, value, stop, out_of_range) || out_of_range) {
+        return false;
+    }
+    rest.remove_prefix(stop - rest.data());
+    return true;
+}
+
+int parse_int(std::string_view text) {
+    skip_spaces(text);
+    if (!text.empty() && text.front() == '+') {
+        text.remove_prefix(1);
+        if (!text.empty() && text.front() == '-') {
+            throw std::invalid_argument("stoi");
+        }
+    }
+    int value = 0;
+    auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (result.ec == std::errc::invalid_argument) {
+        throw std::invalid_argument("stoi");
+    }
+    if (result.ec == std::errc::result_out_of_range) {
+        throw std::out_of_range("stoi");
+    }
+    return value;
+}
+
+// Hex values and inf/nan words, which stod reads and the stream rules do not.
+static bool is_strtod_only(std::string_view text) {
+    if (!text.empty() && (text.front() == '+' || text.front() == '-')) {
+        text.remove_prefix(1);
+    }
+    if (text.empty()) {
+        return false;
+    }
+    if (std::isalpha(static_cast<unsigned char>(text.front()))) {
+        return true;
+    }
+    return text.size() > 1 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X');
+}
+
+double parse_double(std::string_view text) {
+    skip_spaces(text);
+    if (is_strtod_only(text)) {
+        return std::stod(std::string(text));
+    }
+    double value = 0.0;
+    const char* stop;
+    bool out_of_range;
+    if (!parse_double_prefix(text, value, stop, out_of_range)) {
+        throw std::invalid_argument("stod");
+    }
+    if (out_of_range) {
+        throw std::out_of_range("stod");
+    }
+    return value;
+}
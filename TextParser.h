@@ -0,0 +1,131 @@
+#ifndef TEXTPARSER_H
+#define TEXTPARSER_H
+
+#include <cstddef>
+#include <exception>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Files smaller than this per thread are parsed on fewer threads.
+#define MIN_PARSE_CHUNK_BYTES (std::size_t(1) << 20)
+
+/**
+ * Helpers for the loaders' text formats. Tokenizing follows operator>> on
+ * streams (any of " \t\n\v\f\r" separates tokens) and number conversion
+ * follows std::stoi / std::stod, without their allocations or locale lookups.
+ */
+
+struct LineChunk {
+    const char* begin;
+    const char* end;
+};
+
+/**
+ * Cuts [data, data + size) into at most max_chunks pieces that start and end on
+ * line boundaries. Chunks are returned in file order.
+ */
+std::vector<LineChunk> split_line_chunks(const char* data, std::size_t size, std::size_t max_chunks);
+
+/**
+ * Pops a prefix of about max_bytes from rest, extended to the end of the line
+ * it cuts into. Returns an empty chunk once rest is exhausted.
+ */
+LineChunk take_line_window(LineChunk& rest, std::size_t max_bytes);
+
+/**
+ * Number of chunks worth using for a file of the given size.
+ */
+std::size_t parse_chunk_count(std::size_t size);
+
+/**
+ * Number of threads available for parsing: one per hardware thread unless
+ * set_parse_limits says otherwise.
+ */
+std::size_t parse_thread_count();
+
+/**
+ * Smallest piece of a file worth a thread of its own, MIN_PARSE_CHUNK_BYTES
+ * unless set_parse_limits says otherwise.
+ */
+std::size_t parse_chunk_bytes();
+
+/**
+ * Overrides the parse granularity for every later load, e.g. so that small
+ * files still go through several chunks. threads = 0 means one per hardware
+ * thread. Not meant to change while a load is running.
+ */
+void set_parse_limits(std::size_t min_chunk_bytes, std::size_t threads = 0);
+
+/**
+ * Pops the next line of a chunk, without its '\n' (as std::getline).
+ * @return false when the chunk is exhausted
+ */
+bool next_line(LineChunk& chunk, std::string_view& line);
+
+/**
+ * Pops the next whitespace separated token from rest.
+ * @return false if only whitespace is left
+ */
+bool next_token(std::string_view& rest, std::string_view& token);
+
+/**
+ * Reads one double from the front of rest like `stream >> value`: leading
+ * whitespace is skipped and parsing stops at the first character that cannot
+ * continue the number.
+ * @return false if no number could be read
+ */
+bool read_double(std::string_view& rest, double& value);
+
+/**
+ * Converts like std::stoi, throwing std::invalid_argument("stoi") or
+ * std::out_of_range("stoi") in the same cases.
+ */
+int parse_int(std::string_view text);
+
+/**
+ * Converts like std::stod, throwing std::invalid_argument("stod") or
+ * std::out_of_range("stod") in the same cases. Hexadecimal values and the
+ * inf/nan words are accepted as std::stod accepts them.
+ */
+double parse_double(std::string_view text);
+
+/**
+ * Runs fn(0) .. fn(count - 1) on count threads (the caller runs fn(0)). Every
+ * thread is joined before this returns or throws; an exception from any fn is
+ * rethrown afterwards, the one of the lowest index if several threw.
+ */
+template <typename Fn>
+void run_chunks(std::size_t count, Fn fn) {
+    std::vector<std::exception_ptr> errors(count);
+    auto run = [&fn, &errors](std::size_t i) {
+        try {
+            fn(i);
+        } catch (...) {
+            errors[i] = std::current_exception();
+        }
+    };
+    {
+        // Joins on every way out, including a failed thread start.
+        struct JoinAll {
+            std::vector<std::thread> threads;
+            ~JoinAll() {
+                for (auto& thread : threads) thread.join();
+            }
+        } started;
+        for (std::size_t i = 1; i < count; ++i) {
+            started.threads.emplace_back(run, i);
+        }
+        if (count > 0) {
+            run(0);
+        }
+    }
+    for (const std::exception_ptr& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+#endif // TEXTPARSER_H
@@ -0,0 +1,117 @@
+#include "ThreadPool.h"
+#include <algorithm>
+#include <exception>
+
+ThreadPool::ThreadPool(std::size_t threads)
+    : pending(0), next_queue(0), stopping(false) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (std::size_t i = 0; i < threads; ++i) {
+        queues.push_back(std::make_unique<TaskQueue>());
+    }
+    for (std::size_t i = 0; i < threads; ++i) {
+        workers.emplace_back(&ThreadPool::worker_loop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+bool ThreadPool::try_run_one(std::size_t first_queue) {
+    for (std::size_t i = 0; i < queues.size(); ++i) {
+        std::size_t index = (first_queue + i) % queues.size();
+        TaskQueue& queue = *queues[index];
+        std::function<void()> task;
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.tasks.empty()) continue;
+            if (i == 0) {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+            } else {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+            }
+        }
+        pending.fetch_sub(1);
+        task();
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::worker_loop(std::size_t index) {
+    while (true) {
+        if (try_run_one(index)) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(wake_mutex);
+        wake.wait(lock, [this] { return stopping || pending.load() > 0; });
+        if (stopping && pending.load() == 0) {
+            return;
+        }
+    }
+}
+
+void ThreadPool::parallel_for(std::size_t count, const std::function<void(std::size_t)>& body) {
+    if (count == 0) {
+        return;
+    }
+
+    struct Batch {
+        std::atomic<std::size_t> remaining;
+        std::mutex mutex;
+        std::condition_variable done;
+        std::exception_ptr error;
+    } batch;
+    batch.remaining = count;
+
+    auto run = [&batch, &body](std::size_t i) {
+        try {
+            body(i);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(batch.mutex);
+            if (!batch.error) {
+                batch.error = std::current_exception();
+            }
+        }
+        // Under the mutex: the caller cannot see the batch finish, and
+        // destroy it, until the last task is done touching it.
+        std::lock_guard<std::mutex> lock(batch.mutex);
+        if (batch.remaining.fetch_sub(1) == 1) {
+            batch.done.notify_all();
+        }
+    };
+
+    // Spread the tasks over the worker deques, then wake everyone.
+    std::size_t start = next_queue.fetch_add(1);
+    for (std::size_t i = 0; i < count; ++i) {
+        TaskQueue& queue = *queues[(start + i) % queues.size()];
+        pending.fetch_add(1);
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.emplace_back([run, i] { run(i); });
+    }
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex);
+    }
+    wake.notify_all();
+
+    // Help out instead of blocking while tasks are still queued.
+    while (batch.remaining.load() > 0 && try_run_one(start)) {
+    }
+
+    std::unique_lock<std::mutex> lock(batch.mutex);
+    batch.done.wait(lock, [&batch] { return batch.remaining.load() == 0; });
+    if (batch.error) {
+        std::rethrow_exception(batch.error);
+    }
+}
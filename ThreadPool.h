@@ -0,0 +1,57 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Work-stealing thread pool. Every worker owns a task deque: it pops its own
+ * tasks from the back and steals from the front of the others. A thread
+ * waiting in parallel_for runs pending tasks itself, so nested calls from
+ * inside a task cannot deadlock.
+ */
+class ThreadPool {
+private:
+    struct TaskQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<TaskQueue>> queues;
+    std::vector<std::thread> workers;
+    std::mutex wake_mutex;
+    std::condition_variable wake;
+    std::atomic<std::size_t> pending;
+    std::atomic<std::size_t> next_queue;
+    bool stopping;
+
+    bool try_run_one(std::size_t first_queue);
+    void worker_loop(std::size_t index);
+
+public:
+    /**
+     * @param threads - number of worker threads, 0 for one per hardware thread
+     */
+    explicit ThreadPool(std::size_t threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    std::size_t size() const { return workers.size(); }
+
+    /**
+     * Runs body(0) .. body(count - 1) on the pool and returns when all are done.
+     * The first exception thrown by a task is rethrown here.
+     */
+    void parallel_for(std::size_t count, const std::function<void(std::size_t)>& body);
+};
+
+#endif // THREADPOOL_H
@@ -0,0 +1,115 @@
+#include "TitleInterner.h"
+#include <functional>
+#include <stdexcept>
+
+// Titles a fresh table has room for; each growth doubles it.
+#define INITIAL_TITLE_CAPACITY 1024
+
+/**
+ * Open-addressing title -> id table plus the id -> title array, with a single
+ * writer and lock-free readers. A title's text pointer and hash are written
+ * before its id is released, so a reader that sees an id also sees both. A
+ * full table is replaced by a copy twice its size rather than resized.
+ */
+class TitleInterner::Table {
+private:
+    struct Slot {
+        std::atomic<std::uint64_t> hash{0};
+        std::atomic<title_id> id{INVALID_TITLE_ID};
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    std::size_t mask;
+    std::unique_ptr<std::atomic<const std::string*>[]> texts; // by id
+    std::size_t room;
+
+    static std::uint64_t hash_of(std::string_view title) {
+        return std::hash<std::string_view>{}(title);
+    }
+
+public:
+    explicit Table(std::size_t capacity)
+        : slots(new Slot[capacity * 2]), mask(capacity * 2 - 1),
+          texts(new std::atomic<const std::string*>[capacity]), room(capacity) {}
+
+    std::size_t capacity() const { return room; }
+
+    // `id` must be the next unused one, below capacity().
+    void insert(title_id id, const std::string* text) {
+        std::uint64_t hash = hash_of(*text);
+        texts[id].store(text, std::memory_order_relaxed);
+        std::size_t i = hash & mask;
+        while (slots[i].id.load(std::memory_order_relaxed) != INVALID_TITLE_ID) {
+            i = (i + 1) & mask;
+        }
+        slots[i].hash.store(hash, std::memory_order_relaxed);
+        slots[i].id.store(id, std::memory_order_release);
+    }
+
+    title_id find(std::string_view title) const {
+        std::uint64_t hash = hash_of(title);
+        for (std::size_t i = hash & mask;; i = (i + 1) & mask) {
+            title_id id = slots[i].id.load(std::memory_order_acquire);
+            if (id == INVALID_TITLE_ID) {
+                return id;
+            }
+            if (slots[i].hash.load(std::memory_order_relaxed) == hash &&
+                *texts[id].load(std::memory_order_relaxed) == title) {
+                return id;
+            }
+        }
+    }
+
+    const std::string& title(title_id id) const {
+        return *texts[id].load(std::memory_order_acquire);
+    }
+};
+
+TitleInterner::TitleInterner() {
+    tables.push_back(std::make_unique<Table>(INITIAL_TITLE_CAPACITY));
+    current.store(tables.back().get(), std::memory_order_release);
+}
+
+TitleInterner& TitleInterner::instance() {
+    // Never destroyed, so titles stay valid for movies released during exit.
+    static TitleInterner* interner = new TitleInterner();
+    return *interner;
+}
+
+title_id TitleInterner::intern(std::string_view title) {
+    title_id existing = find(title);
+    if (existing != INVALID_TITLE_ID) {
+        return existing;
+    }
+
+    std::lock_guard<std::mutex> lock(writer);
+    Table* table = tables.back().get();
+    existing = table->find(title);
+    if (existing != INVALID_TITLE_ID) {
+        return existing;
+    }
+    if (titles.size() >= INVALID_TITLE_ID) {
+        throw std::length_error("Title table is full");
+    }
+    if (titles.size() == table->capacity()) {
+        auto next = std::make_unique<Table>(table->capacity() * 2);
+        for (std::size_t id = 0; id < titles.size(); ++id) {
+            next->insert(static_cast<title_id>(id), &titles[id]);
+        }
+        table = next.get();
+        tables.push_back(std::move(next));
+        current.store(table, std::memory_order_release);
+    }
+    title_id id = static_cast<title_id>(titles.size());
+    titles.emplace_back(title);
+    table->insert(id, &titles.back());
+    return id;
+}
+
+title_id TitleInterner::find(std::string_view title) const {
+    return current.load(std::memory_order_acquire)->find(title);
+}
+
+const std::string& TitleInterner::title(title_id id) const {
+    return current.load(std::memory_order_acquire)->title(id);
+}
@@ -0,0 +1,54 @@
+#ifndef TITLEINTERNER_H
+#define TITLEINTERNER_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+typedef std::uint32_t title_id;
+const title_id INVALID_TITLE_ID = std::numeric_limits<title_id>::max();
+
+/**
+ * Process-wide table of movie titles. Every distinct title is stored once and
+ * gets a small integer handle, so equal titles compare and hash as integers.
+ * Titles are never removed. Lookups are lock-free and do not allocate; only
+ * interning a new title takes a mutex.
+ */
+class TitleInterner {
+private:
+    class Table;
+
+    std::atomic<const Table*> current; // read by lookups without a lock
+    std::deque<std::string> titles;    // stable addresses; guarded by `writer`
+    // Every table ever published: a lookup may still be reading an old one.
+    std::vector<std::unique_ptr<Table>> tables;
+    std::mutex writer;
+
+    TitleInterner();
+
+public:
+    TitleInterner(const TitleInterner&) = delete;
+    TitleInterner& operator=(const TitleInterner&) = delete;
+
+    static TitleInterner& instance();
+
+    /**
+     * @return the handle of the title, adding it if it is new
+     */
+    title_id intern(std::string_view title);
+
+    /**
+     * @return the handle of the title, or INVALID_TITLE_ID if it was never interned
+     */
+    title_id find(std::string_view title) const;
+
+    const std::string& title(title_id id) const;
+};
+
+#endif // TITLEINTERNER_H
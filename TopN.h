@@ -0,0 +1,93 @@
+#ifndef TOPN_H
+#define TOPN_H
+
+#include "MovieCatalog.h"
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <utility>
+#include <vector>
+
+// A ranked movie as the recommenders return it.
+typedef std::pair<sp_movie, double> scored_movie;
+
+struct ScoredId {
+    double score;
+    movie_id id;
+};
+
+/**
+ * Ranking used by every recommender: higher score first, and on equal scores
+ * the lower id (the movie a catalog scan reaches first).
+ */
+inline bool scored_before(const ScoredId& a, const ScoredId& b) {
+    if (a.score != b.score) {
+        return a.score > b.score;
+    }
+    return a.id < b.id;
+}
+
+/**
+ * Bounded selection of the best `limit` candidates seen in a single pass.
+ * Scores that are not greater than -infinity (including NaN) are never kept,
+ * as with the original single-best scans.
+ */
+class TopN {
+private:
+    std::size_t limit;
+    std::vector<ScoredId> heap; // worst kept candidate on top
+
+public:
+    /**
+     * @param candidates - how many candidates can be pushed, if known; only
+     * sizes the reservation, so a limit far above it allocates nothing extra
+     */
+    explicit TopN(std::size_t limit, std::size_t candidates = 0) : limit(limit) {
+        heap.reserve(std::min(limit, candidates));
+    }
+
+    void push(double score, movie_id id) {
+        if (limit == 0 || !(score > -std::numeric_limits<double>::infinity())) {
+            return;
+        }
+        ScoredId candidate{score, id};
+        if (heap.size() < limit) {
+            heap.push_back(candidate);
+            std::push_heap(heap.begin(), heap.end(), scored_before);
+        } else if (scored_before(candidate, heap.front())) {
+            std::pop_heap(heap.begin(), heap.end(), scored_before);
+            heap.back() = candidate;
+            std::push_heap(heap.begin(), heap.end(), scored_before);
+        }
+    }
+
+    void merge(const TopN& other) {
+        for (const ScoredId& candidate : other.heap) {
+            push(candidate.score, candidate.id);
+        }
+    }
+
+    std::size_t size() const { return heap.size(); }
+
+    /**
+     * Once the selection is full, the score of the worst kept candidate:
+     * a scan in increasing id order can skip anything not above it.
+     * -infinity until then.
+     */
+    double floor() const {
+        return (limit != 0 && heap.size() == limit) ? heap.front().score
+                                                    : -std::numeric_limits<double>::infinity();
+    }
+
+    /**
+     * @return the kept candidates, best first. Leaves the selection empty.
+     */
+    std::vector<ScoredId> take_sorted() {
+        std::sort_heap(heap.begin(), heap.end(), scored_before);
+        std::vector<ScoredId> result;
+        result.swap(heap);
+        return result;
+    }
+};
+
+#endif // TOPN_H
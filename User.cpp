@@ -5,11 +5,20 @@
 #include <algorithm>
 #include <iostream>
 #include <cmath> 
+#include <atomic>
 
-User::User(const std::string& name, std::shared_ptr<RecommendationSystem> rs)
+static std::atomic<std::uint64_t> next_user_uid{1};
+static std::atomic<std::uint64_t> next_rating_version{1};
+
+User::User(const std::string& name, std::shared_ptr<RecommendationSystem> rs,
+           RatingStorage storage)
     : name(name), 
+      uid(next_user_uid.fetch_add(1, std::memory_order_relaxed)),
+      rating_version(next_rating_version.fetch_add(1, std::memory_order_relaxed)),
       rs(rs),
-      movie_ratings(0, &sp_movie_hash, &sp_movie_equal) {}
+      storage(storage),
+      movie_ratings(0, &sp_movie_hash, &sp_movie_equal),
+      rank_cache_valid(storage == RatingStorage::map) {}
 
 
 std::string User::get_name() const {
@@ -33,7 +42,7 @@ void User::add_movie_to_user(const std::string& name, int year,
             throw std::runtime_error("add_movie_to_rs returned null sp_movie.");
         }
 
-        movie_ratings[movie] = rating;
+        add_rating(movie, rating);
 
     } catch (const std::exception& e) {
         std::cerr << "[EXCEPTION] Error adding movie \"" << name << " (" << year
@@ -42,14 +51,142 @@ void User::add_movie_to_user(const std::string& name, int year,
     }
 }
 
+void User::add_rating(const sp_movie& movie, double rating) {
+    if (!movie) {
+        throw std::invalid_argument("Cannot rate a null movie.");
+    }
+    // A copy of this user that changes its ratings can never reuse this version.
+    rating_version = next_rating_version.fetch_add(1, std::memory_order_relaxed);
+    // One snapshot for the id and the features the preference is updated with.
+    const MovieCatalog catalog = rs->get_movies();
+    RowCursor rows(catalog);
+    std::size_t sorted = rated_ids.size();
+    store_rating(catalog, rows, movie, rating);
+    sort_rated_ids(sorted);
+}
+
+void User::add_ratings(const MovieCatalog& catalog,
+                       const std::vector<std::pair<sp_movie, double>>& ratings) {
+    for (const auto& entry : ratings) {
+        if (!entry.first) {
+            throw std::invalid_argument("Cannot rate a null movie.");
+        }
+    }
+    if (ratings.empty()) {
+        return;
+    }
+    rating_version = next_rating_version.fetch_add(1, std::memory_order_relaxed);
+    RowCursor rows(catalog);
+    if (storage == RatingStorage::compact) {
+        store_compact_ratings(catalog, rows, ratings);
+        return;
+    }
+    std::size_t sorted = rated_ids.size();
+    for (const auto& entry : ratings) {
+        store_rating(catalog, rows, entry.first, entry.second);
+    }
+    sort_rated_ids(sorted);
+}
+
+// Map mode appends the ids of newly rated movies unsorted; sort_rated_ids
+// puts them in place.
+void User::store_rating(const MovieCatalog& catalog, RowCursor& rows, const sp_movie& movie,
+                        double rating) {
+    movie_id id = catalog.find(movie);
+    if (storage == RatingStorage::map) {
+        auto [it, inserted] = movie_ratings.try_emplace(movie, rating);
+        const double previous = it->second;
+        it->second = rating;
+        if (id == INVALID_MOVIE_ID) {
+            // Not in this system; the recommenders report it on use.
+            preference.invalidate();
+            return;
+        }
+        rated_ids.push_back(id);
+        preference.rate(rows.row(id), catalog.dimension(), catalog.stride(),
+                        inserted ? nullptr : &previous, rating);
+        return;
+    }
+    if (id == INVALID_MOVIE_ID) {
+        throw std::runtime_error("Movie not found in recommendation system");
+    }
+    // The preference sees the rating as stored, i.e. as a float.
+    const float* stored = compact_ratings.find(id);
+    const double previous = stored ? *stored : 0.0;
+    const double rounded = static_cast<float>(rating);
+    preference.rate(rows.row(id), catalog.dimension(), catalog.stride(),
+                    stored ? &previous : nullptr, rounded);
+    compact_ratings.set(id, rating);
+    rank_cache_valid = false;
+}
+
+// The compact side of add_ratings. Every id is resolved before anything is
+// stored. The preference sees the ratings in the given order, as add_rating
+// would; they are then sorted once and merged into the compact ratings.
+void User::store_compact_ratings(const MovieCatalog& catalog, RowCursor& rows,
+                                 const std::vector<std::pair<sp_movie, double>>& ratings) {
+    std::vector<CompactRating> pending;
+    pending.reserve(ratings.size());
+    for (const auto& [movie, rating] : ratings) {
+        movie_id id = catalog.find(movie);
+        if (id == INVALID_MOVIE_ID) {
+            throw std::runtime_error("Movie not found in recommendation system");
+        }
+        pending.push_back(CompactRating{id, static_cast<float>(rating)});
+    }
+    std::vector<std::size_t> order(pending.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&pending](std::size_t a, std::size_t b) {
+        return pending[a].id < pending[b].id;
+    });
+
+    // What each rating replaces: the one before it in this call, else the stored one.
+    std::vector<const float*> replaced(pending.size());
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        const CompactRating& entry = pending[order[i]];
+        bool repeated = i > 0 && pending[order[i - 1]].id == entry.id;
+        replaced[order[i]] = repeated ? &pending[order[i - 1]].rating
+                                      : compact_ratings.find(entry.id);
+    }
+    for (std::size_t i = 0; i < pending.size(); ++i) {
+        const double previous = replaced[i] ? *replaced[i] : 0.0;
+        preference.rate(rows.row(pending[i].id), catalog.dimension(), catalog.stride(),
+                        replaced[i] ? &previous : nullptr, pending[i].rating);
+    }
+
+    std::vector<CompactRating> sorted;
+    sorted.reserve(pending.size());
+    for (std::size_t at : order) {
+        sorted.push_back(pending[at]);
+    }
+    compact_ratings.merge(sorted);
+    rank_cache_valid = false;
+}
+
+// Merges the ids appended after sorted_prefix into the sorted prefix; a
+// re-rated movie's id is appended again and dropped here.
+void User::sort_rated_ids(std::size_t sorted_prefix) {
+    if (rated_ids.size() == sorted_prefix) {
+        return;
+    }
+    auto middle = rated_ids.begin() + sorted_prefix;
+    std::sort(middle, rated_ids.end());
+    std::inplace_merge(rated_ids.begin(), middle, rated_ids.end());
+    rated_ids.erase(std::unique(rated_ids.begin(), rated_ids.end()), rated_ids.end());
+}
+
 sp_movie User::get_rs_recommendation_by_content() {
-    return rs->recommend_by_content(movie_ratings);
+    return rs->recommend_by_content(*this);
 }
 
 sp_movie User::get_rs_recommendation_by_cf(int k) {
     return rs->recommend_by_cf(*this, k);
 }
 
+sp_movie User::get_rs_recommendation_by_user_cf(int k) {
+    return rs->recommend_by_user_cf(*this, k);
+}
+
 double User::get_rs_prediction_score_for_movie(const std::string &name, int year, int k) {
     sp_movie movie = rs->get_movie(name, year);
     if (!movie) {
@@ -58,21 +195,51 @@ double User::get_rs_prediction_score_for_movie(const std::string &name, int year
     return rs->predict_movie_score(*this, movie, k);
 }
 
+std::uint64_t User::get_uid() const {
+    return uid;
+}
+
+std::uint64_t User::get_rating_version() const {
+    return rating_version;
+}
+
 const RecommendationSystem& User::get_rs() const {
     return *rs;
 }
 
 const rank_map& User::get_rank() const {
+    if (!rank_cache_valid) {
+        const MovieCatalog& catalog = rs->get_movies();
+        movie_ratings.clear();
+        for (const CompactRating& entry : compact_ratings) {
+            movie_ratings[catalog.movie(entry.id)] = entry.rating;
+        }
+        rank_cache_valid = true;
+    }
     return movie_ratings; // return map
 }
 
+RatingStorage User::get_storage() const {
+    return storage;
+}
+
+const CompactRatings& User::get_compact_ratings() const {
+    return compact_ratings;
+}
+
+const UserPreference& User::get_preference() const {
+    return preference;
+}
+
+const std::vector<movie_id>& User::get_rated_ids() const {
+    return rated_ids;
+}
+
 std::ostream& operator<<(std::ostream& os, const User& user) {
     os << "name: " << user.get_name() << "\n";
 
-    std::vector<sp_movie> sorted_movies;
-    for (const auto& [movie, features] : user.get_rs().get_movies()) {
-        sorted_movies.push_back(movie);
-    }
+    const MovieCatalog& catalog = user.get_rs().get_movies();
+    std::vector<sp_movie> sorted_movies(catalog.begin(), catalog.end());
 
     std::sort(sorted_movies.begin(), sorted_movies.end(), 
               [](const sp_movie& a, const sp_movie& b) {
@@ -2,27 +2,87 @@
 #define USER_H
 
 #include "Movie.h"
+#include "CompactRatings.h"
+#include "UserPreference.h"
+#include <cstdint>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 #include <string>
 #include <ostream>
 
 class RecommendationSystem;
+class RowCursor;
 
 typedef std::unordered_map<sp_movie, double, hash_func, equal_func> rank_map;
 
+// How a User keeps its ratings. Compact storage keeps ratings as float.
+enum class RatingStorage { map, compact };
+
 class User {
 private:
     std::string name;
+    std::uint64_t uid; // shared by copies of this user
+    std::uint64_t rating_version; // unique across all users, renewed by every rating change
     std::shared_ptr<RecommendationSystem> rs; 
-    rank_map movie_ratings;
+    RatingStorage storage;
+    mutable rank_map movie_ratings; // in compact mode, a cache built by get_rank()
+    mutable bool rank_cache_valid;
+    CompactRatings compact_ratings;
+    std::vector<movie_id> rated_ids; // map mode: catalog ids of the rated movies, sorted
+    UserPreference preference;
+
+    void store_rating(const MovieCatalog& catalog, RowCursor& rows, const sp_movie& movie,
+                      double rating);
+    void sort_rated_ids(std::size_t sorted_prefix);
+    void store_compact_ratings(const MovieCatalog& catalog, RowCursor& rows,
+                               const std::vector<std::pair<sp_movie, double>>& ratings);
 
 public:
-    User(const std::string& name, std::shared_ptr<RecommendationSystem> rs);
+    User(const std::string& name, std::shared_ptr<RecommendationSystem> rs,
+         RatingStorage storage = RatingStorage::map);
+
+    /**
+     * In compact mode the map is built on first use and kept until the next
+     * rating change; prefer get_compact_ratings() there.
+     */
     const rank_map& get_rank() const;
+    RatingStorage get_storage() const;
+    const CompactRatings& get_compact_ratings() const;
+
+    /**
+     * Content preference maintained by every rating change. In map mode
+     * get_rated_ids() lists the rated movies' catalog ids alongside it.
+     */
+    const UserPreference& get_preference() const;
+    const std::vector<movie_id>& get_rated_ids() const;
     std::string get_name() const;
+    std::uint64_t get_uid() const;
+    std::uint64_t get_rating_version() const;
     void add_movie_to_user(const std::string& name, int year, const std::vector<double>& features, double rating);
+
+    /**
+     * Sets the rating of a movie that is already in this user's
+     * RecommendationSystem (e.g. one returned by get_movie), without looking
+     * it up or validating its features again.
+     */
+    void add_rating(const sp_movie& movie, double rating);
+
+    /**
+     * add_rating for many movies at once, as a loader adds a user's row: the
+     * rated ids (map mode) or the compact ratings are sorted once at the end
+     * instead of on every insertion.
+     * @param catalog - the system's catalog (get_movies()), which a loader
+     * reads once for all of its users; every movie must be in it
+     * @throws std::invalid_argument if a movie is null, before any is stored
+     * @throws std::runtime_error in compact mode if a movie is not in the
+     * catalog, before any is stored
+     */
+    void add_ratings(const MovieCatalog& catalog,
+                     const std::vector<std::pair<sp_movie, double>>& ratings);
     sp_movie get_rs_recommendation_by_content();
     sp_movie get_rs_recommendation_by_cf(int k);
+    sp_movie get_rs_recommendation_by_user_cf(int k);
     double get_rs_prediction_score_for_movie(const std::string& name, int year, int k);
 
     const RecommendationSystem& get_rs() const;
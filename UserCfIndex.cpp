@@ -0,0 +1,171 @@
+#include "UserCfIndex.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+static double mean_of(const UserCfIndex::rating_list& ratings) {
+    if (ratings.empty()) {
+        return 0.0;
+    }
+    double sum = 0.0;
+    for (const auto& [movie, rating] : ratings) {
+        sum += rating;
+    }
+    return sum / ratings.size();
+}
+
+/**
+ * Dense per-thread accumulator that is reset through the list of touched
+ * slots, so a query costs O(touched) rather than O(users) or O(movies).
+ */
+class SparseAccumulator {
+private:
+    std::vector<double> values;
+    std::vector<double> weights;
+    std::vector<std::uint32_t> touched;
+
+public:
+    void prepare(std::size_t size) {
+        if (values.size() < size) {
+            values.resize(size, 0.0);
+            weights.resize(size, 0.0);
+        }
+    }
+
+    // weight must be positive; a slot with weight is a touched slot.
+    void add(std::uint32_t slot, double value, double weight) {
+        if (weights[slot] == 0.0) {
+            touched.push_back(slot);
+        }
+        values[slot] += value;
+        weights[slot] += weight;
+    }
+
+    template <typename Visit>
+    void drain(Visit&& visit) {
+        for (std::uint32_t slot : touched) {
+            visit(slot, values[slot], weights[slot]);
+            values[slot] = 0.0;
+            weights[slot] = 0.0;
+        }
+        touched.clear();
+    }
+};
+
+static thread_local SparseAccumulator accumulator;
+
+UserCfIndex::UserCfIndex() : rating_offsets{0} {}
+
+user_id UserCfIndex::add_user(const std::string& name, const rating_list& ratings) {
+    if (names.size() >= std::numeric_limits<user_id>::max()) {
+        throw std::length_error("Too many users for the user CF index");
+    }
+    user_id user = static_cast<user_id>(names.size());
+    double mean = mean_of(ratings);
+    double norm = 0.0;
+    for (const auto& [movie, rating] : ratings) {
+        float centered = static_cast<float>(rating - mean);
+        norm += static_cast<double>(centered) * centered;
+        if (movie >= postings.size()) {
+            postings.resize(movie + 1);
+        }
+        postings[movie].push_back(UserPosting{user, centered});
+        user_ratings.push_back(UserPosting{movie, centered});
+    }
+    names.push_back(name);
+    means.push_back(mean);
+    norms.push_back(std::sqrt(norm));
+    rating_offsets.push_back(user_ratings.size());
+    return user;
+}
+
+std::vector<UserNeighbor> UserCfIndex::nearest_users(const rating_list& ratings,
+                                                     std::string_view name,
+                                                     std::size_t k) const {
+    double mean = mean_of(ratings);
+    double norm = 0.0;
+    accumulator.prepare(names.size());
+    for (const auto& [movie, rating] : ratings) {
+        double centered = rating - mean;
+        norm += centered * centered;
+        if (movie >= postings.size() || centered == 0.0) continue;
+        for (const UserPosting& posting : postings[movie]) {
+            if (posting.centered != 0.0f) {
+                accumulator.add(posting.user, centered * posting.centered, 1.0);
+            }
+        }
+    }
+    norm = std::sqrt(norm);
+
+    std::vector<UserNeighbor> best;
+    auto worse = [](const UserNeighbor& a, const UserNeighbor& b) {
+        return a.similarity != b.similarity ? a.similarity > b.similarity : a.user < b.user;
+    };
+    accumulator.drain([&](std::uint32_t user, double dot, double) {
+        if (k == 0 || norm == 0.0 || norms[user] == 0.0 || names[user] == name) return;
+        double similarity = dot / (norm * norms[user]);
+        if (!(similarity > 0.0)) return;
+        UserNeighbor candidate{similarity, user};
+        if (best.size() < k) {
+            best.push_back(candidate);
+            std::push_heap(best.begin(), best.end(), worse);
+        } else if (worse(candidate, best.front())) {
+            std::pop_heap(best.begin(), best.end(), worse);
+            best.back() = candidate;
+            std::push_heap(best.begin(), best.end(), worse);
+        }
+    });
+    std::sort_heap(best.begin(), best.end(), worse);
+    return best;
+}
+
+double UserCfIndex::predict(const rating_list& ratings, const std::vector<UserNeighbor>& neighbors,
+                            movie_id movie) const {
+    double numerator = 0.0, denominator = 0.0;
+    for (const UserNeighbor& neighbor : neighbors) {
+        auto first = user_ratings.begin() + rating_offsets[neighbor.user];
+        auto last = user_ratings.begin() + rating_offsets[neighbor.user + 1];
+        auto it = std::lower_bound(first, last, movie, [](const UserPosting& entry, movie_id key) {
+            return entry.user < key;
+        });
+        if (it != last && it->user == movie) {
+            numerator += neighbor.similarity * it->centered;
+            denominator += neighbor.similarity;
+        }
+    }
+    double mean = mean_of(ratings);
+    return (denominator == 0.0) ? mean : mean + numerator / denominator;
+}
+
+void UserCfIndex::recommend(const rating_list& ratings, const std::vector<UserNeighbor>& neighbors,
+                            TopN& best) const {
+    accumulator.prepare(postings.size());
+    for (const UserNeighbor& neighbor : neighbors) {
+        for (std::size_t i = rating_offsets[neighbor.user]; i < rating_offsets[neighbor.user + 1]; ++i) {
+            const UserPosting& entry = user_ratings[i];
+            accumulator.add(entry.user, neighbor.similarity * entry.centered, neighbor.similarity);
+        }
+    }
+    double mean = mean_of(ratings);
+    accumulator.drain([&](std::uint32_t movie, double numerator, double denominator) {
+        auto rated = std::lower_bound(ratings.begin(), ratings.end(), movie,
+                                      [](const auto& entry, movie_id key) { return entry.first < key; });
+        if (rated != ratings.end() && rated->first == movie) return;
+        best.push(mean + numerator / denominator, movie);
+    });
+}
+
+std::size_t UserCfIndex::memory_usage() const {
+    std::size_t bytes = postings.capacity() * sizeof(postings[0]) +
+                        user_ratings.capacity() * sizeof(UserPosting) +
+                        rating_offsets.capacity() * sizeof(std::size_t) +
+                        (means.capacity() + norms.capacity()) * sizeof(double);
+    for (const auto& list : postings) {
+        bytes += list.capacity() * sizeof(UserPosting);
+    }
+    for (const std::string& name : names) {
+        bytes += sizeof(std::string) + name.capacity();
+    }
+    return bytes;
+}
@@ -0,0 +1,81 @@
+#ifndef USERCFINDEX_H
+#define USERCFINDEX_H
+
+#include "MovieCatalog.h"
+#include "TopN.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+typedef std::uint32_t user_id;
+
+struct UserPosting {
+    user_id user;
+    float centered; // the user's rating minus their mean rating
+};
+
+struct UserNeighbor {
+    double similarity;
+    user_id user;
+};
+
+/**
+ * User-user collaborative filtering over an inverted index: for every movie,
+ * the posting list of the users who rated it. Users are compared by the
+ * cosine of their mean-centered ratings; a query only touches the posting
+ * lists of the movies it rated, so only users sharing a movie are scored.
+ *
+ * The index holds a copy of the ratings it was built from. Queries take the
+ * querying user's ratings as they are now; an indexed user with the same name
+ * as the querying user is never its own neighbor.
+ */
+class UserCfIndex {
+public:
+    // (movie id, rating) sorted by id
+    typedef std::vector<std::pair<movie_id, double>> rating_list;
+
+private:
+    std::vector<std::string> names;
+    std::vector<double> means;
+    std::vector<double> norms; // of the centered ratings
+    std::vector<std::vector<UserPosting>> postings; // by movie id
+    // Every user's centered ratings, user after user.
+    std::vector<std::size_t> rating_offsets;
+    std::vector<UserPosting> user_ratings; // `user` holds the movie id here
+
+public:
+    UserCfIndex();
+
+    // Users get ids in the order they are added.
+    user_id add_user(const std::string& name, const rating_list& ratings);
+
+    /**
+     * The k users most similar to a user with these ratings, most similar
+     * first (ties by lower id). Only positive similarities are kept.
+     */
+    std::vector<UserNeighbor> nearest_users(const rating_list& ratings, std::string_view name,
+                                            std::size_t k) const;
+
+    /**
+     * Mean rating of the user plus the similarity-weighted mean offset of the
+     * neighbors that rated the movie; just the mean if none did.
+     */
+    double predict(const rating_list& ratings, const std::vector<UserNeighbor>& neighbors,
+                   movie_id movie) const;
+
+    /**
+     * Scores every movie some neighbor rated and the user did not, as predict
+     * would, and keeps the best.
+     */
+    void recommend(const rating_list& ratings, const std::vector<UserNeighbor>& neighbors,
+                   TopN& best) const;
+
+    std::size_t user_count() const { return names.size(); }
+    const std::string& user_name(user_id user) const { return names[user]; }
+    std::size_t memory_usage() const;
+};
+
+#endif // USERCFINDEX_H
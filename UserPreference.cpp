@@ -0,0 +1,44 @@
+#include "UserPreference.h"
+#include "SimdKernels.h"
+#include <cmath>
+
+UserPreference::UserPreference()
+    : rating_sum(0.0), count(0), preference_norm(0.0), dim(0), valid(true) {}
+
+void UserPreference::rate(const double* features, std::size_t dimension, std::size_t stride,
+                          const double* previous, double rating) {
+    if (count == 0 && !previous) {
+        dim = dimension;
+        weighted_sum.assign(dimension, 0.0);
+        feature_sum.assign(dimension, 0.0);
+        preference.assign(stride, 0.0);
+    } else if (dimension != dim || stride != preference.size()) {
+        valid = false;
+        return;
+    }
+
+    if (previous) {
+        // The movie is already counted in S_f; only its weight changes.
+        double delta = rating - *previous;
+        for (std::size_t i = 0; i < dim; ++i) {
+            weighted_sum[i] += delta * features[i];
+        }
+        rating_sum += delta;
+    } else {
+        for (std::size_t i = 0; i < dim; ++i) {
+            weighted_sum[i] += rating * features[i];
+            feature_sum[i] += features[i];
+        }
+        rating_sum += rating;
+        ++count;
+    }
+    refresh();
+}
+
+void UserPreference::refresh() {
+    double average = mean();
+    for (std::size_t i = 0; i < dim; ++i) {
+        preference[i] = weighted_sum[i] - average * feature_sum[i];
+    }
+    preference_norm = std::sqrt(dot_product(preference.data(), preference.data(), preference.size()));
+}
@@ -0,0 +1,51 @@
+#ifndef USERPREFERENCE_H
+#define USERPREFERENCE_H
+
+#include "MovieCatalog.h"
+#include <cstddef>
+#include <vector>
+
+/**
+ * A user's content preference, kept current as ratings change. It holds the
+ * running sums S_rf = sum(r * f), S_f = sum(f) and S_r = sum(r) over the rated
+ * movies, so that after every change the preference vector
+ *
+ *     sum((r - mean) * f) = S_rf - mean * S_f
+ *
+ * and its norm are refreshed in O(dim), independent of the number of ratings.
+ */
+class UserPreference {
+private:
+    std::vector<double> weighted_sum; // S_rf
+    std::vector<double> feature_sum;  // S_f
+    double rating_sum;                // S_r
+    std::size_t count;
+    std::vector<double> preference;   // padded to the catalog stride
+    double preference_norm;
+    std::size_t dim;
+    bool valid;
+
+    void refresh();
+
+public:
+    UserPreference();
+
+    /**
+     * Adds a rating, or replaces one when `previous` points to the old value.
+     * @param features - the movie's (padded) catalog row
+     */
+    void rate(const double* features, std::size_t dimension, std::size_t stride,
+              const double* previous, double rating);
+
+    // A rating whose features are unknown: the sums can no longer be trusted.
+    void invalidate() { valid = false; }
+    bool is_valid() const { return valid; }
+
+    const double* data() const { return preference.data(); }
+    double norm() const { return preference_norm; }
+    double mean() const { return count ? rating_sum / count : 0.0; }
+    std::size_t size() const { return count; }
+    std::size_t dimension() const { return dim; }
+};
+
+#endif // USERPREFERENCE_H
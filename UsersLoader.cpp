@@ -1,5 +1,8 @@
 #include "UsersLoader.h"
-#include <fstream>
+#include "MappedFile.h"
+#include "RatingsMatrix.h"
+#include "TextParser.h"
+#include <exception>
 #include <sstream>
 #include <stdexcept>
 #include <iostream>
@@ -8,146 +11,345 @@
 #define ERROR_MSG "input file is incorrect"
 #define INIT_BUCKET_SIZE 8
 
-std::vector<User> UsersLoader::create_users(const std::string &file_path,
-                                            std::shared_ptr<RecommendationSystem> rs)
-{
-    // Keep RS alive if the caller did std::move(rs)
-    static std::shared_ptr<RecommendationSystem> keep_alive;
-    if (rs)
-    {
-        keep_alive = rs;
-    }
+namespace {
 
-    std::vector<User> users;
+struct HeaderMovie {
+    std::string name;
+    int year;
+    sp_movie movie;
+};
 
-    std::ifstream file(file_path);
-    if (!file.is_open())
-    {
-        std::cerr << "[ERROR] Failed to open file: " << file_path << std::endl;
-        throw std::runtime_error("Failed to open file: " + file_path);
-    }
-    std::string line;
+struct UserRecord {
+    size_t line;
+    std::string name;
+    std::vector<std::pair<size_t, double>> ratings; // (header column, rating)
+};
+
+// Output of one parser thread. Parsing stops at the first bad line, keeping
+// the diagnostics the serial loader would have printed.
+struct UserChunk {
+    std::vector<UserRecord> records;
+    size_t lines = 0;
+    std::exception_ptr error;
+    std::string log;
+};
+
+} // namespace
 
-    if (!std::getline(file, line))
+// Without require_movies (conversion, no system involved) columns need not
+// resolve to a movie.
+static void parse_user_line(std::string_view line, const std::vector<HeaderMovie>& movies,
+                            bool require_movies, UserRecord& record, std::ostringstream& log) {
+    std::string_view rest = line;
+
+    // read user name
+    std::string_view user_name;
+    if (!next_token(rest, user_name))
     {
-        std::cerr << "[ERROR] Missing movie names/years line in file\n";
-        throw std::runtime_error("Invalid file format: missing movie names line.");
+        log << "[ERROR] Missing user name in line => " << line << std::endl;
+        throw std::runtime_error("Invalid file format: missing user name.");
     }
+    record.name = std::string(user_name);
 
-    std::istringstream movie_line(line);
-    std::vector<std::pair<std::string, int>> movies;
+    //For each (m_name, m_year), read a rating (or 'NA')
+    for (size_t column = 0; column < movies.size(); ++column)
     {
-        std::string movie_with_year;
-        while (movie_line >> movie_with_year)
+        const HeaderMovie& header = movies[column];
+        std::string_view rating_str;
+        if (!next_token(rest, rating_str))
+        {
+            log << "[ERROR] Missing rating for movie \"" << header.name 
+                << "\" in user line => " << line << std::endl;
+            throw std::runtime_error("Invalid file format: missing rating for movie " + header.name);
+        }
+
+        if (rating_str == "NA")
+        {
+            continue;
+        }
+
+        try
         {
-            size_t dash_pos = movie_with_year.find('-');
-            if (dash_pos == std::string::npos)
+            if (require_movies && !header.movie)
             {
-                std::cerr << "[ERROR] Invalid movie token (no '-'): " << movie_with_year << std::endl;
-                throw std::runtime_error("Invalid movie name format: " + movie_with_year);
+                log << "[ERROR] rs->get_movie(...) returned nullptr for " 
+                    << header.name << " (" << header.year << ")\n";
+                throw std::runtime_error("Movie not found.");
             }
-            std::string movie_name = movie_with_year.substr(0, dash_pos);
-            int year = std::stoi(movie_with_year.substr(dash_pos + 1));
 
-            movies.emplace_back(movie_name, year);
-        }
-    }
+            double rating = parse_double(rating_str);
+            if (rating < 0 || rating > 10)
+            {
+                log << "[ERROR] rating " << rating 
+                    << " out of [0..10] for movie: " << header.name << "\n";
+                throw std::invalid_argument("Rating must be between 0 and 10.");
+            }
 
+            record.ratings.emplace_back(column, rating);
+        }
+        catch (const std::exception &e)
+        {
+            log << "[EXCEPTION] Error processing movie: " << header.name
+                << " (" << header.year << "). Exception: " << e.what() << "\n";
+            throw; // Re-throw
+        }
+    } // end for each movie
+}
 
-    while (std::getline(file, line))
+static void parse_user_chunk(LineChunk chunk, const std::vector<HeaderMovie>& movies,
+                             bool require_movies, UserChunk& out) {
+    std::string_view line;
+    while (next_line(chunk, line))
     {
+        out.lines++;
         if (line.empty())
         {
             continue;
         }
-        std::istringstream user_line(line);
-
-        // read user name
-        std::string user_name;
-        if (!(user_line >> user_name))
+        UserRecord record;
+        record.line = out.lines - 1;
+        std::ostringstream log;
+        try
         {
-            std::cerr << "[ERROR] Missing user name in line => " << line << std::endl;
-            throw std::runtime_error("Invalid file format: missing user name.");
+            parse_user_line(line, movies, require_movies, record, log);
         }
-        
+        catch (...)
+        {
+            out.error = std::current_exception();
+            out.log = log.str();
+            return;
+        }
+        out.records.push_back(std::move(record));
+    }
+}
 
-        //Create one rank_map for this user's ratings
-        rank_map user_ratings(INIT_BUCKET_SIZE, &sp_movie_hash, &sp_movie_equal);
+// Reads the movie names/years line. Each column is resolved against rs once,
+// when there is one; a missing movie is an error only if someone rated it.
+static std::vector<HeaderMovie> parse_header(LineChunk& rest, const RecommendationSystem* rs) {
+    std::string_view line;
+    if (!next_line(rest, line))
+    {
+        std::cerr << "[ERROR] Missing movie names/years line in file\n";
+        throw std::runtime_error("Invalid file format: missing movie names line.");
+    }
 
-        //For each (m_name, m_year), read a rating (or 'NA')
-        int movie_count = 0;
-        for (const auto &[m_name, m_year] : movies)
+    std::vector<HeaderMovie> movies;
+    std::string_view movie_with_year;
+    while (next_token(line, movie_with_year))
+    {
+        size_t dash_pos = movie_with_year.find('-');
+        if (dash_pos == std::string_view::npos)
         {
-            std::string rating_str;
-            if (!(user_line >> rating_str))
-            {
-                std::cerr << "[ERROR] Missing rating for movie \"" << m_name 
-                          << "\" in user line => " << line << std::endl;
-                throw std::runtime_error("Invalid file format: missing rating for movie " + m_name);
-            }
+            std::cerr << "[ERROR] Invalid movie token (no '-'): " << movie_with_year << std::endl;
+            throw std::runtime_error("Invalid movie name format: " + std::string(movie_with_year));
+        }
+        std::string movie_name(movie_with_year.substr(0, dash_pos));
+        int year = parse_int(movie_with_year.substr(dash_pos + 1));
+        sp_movie movie = rs ? rs->get_movie(movie_name, year) : nullptr;
+        movies.push_back(HeaderMovie{movie_name, year, movie});
+    }
+    return movies;
+}
+
+std::vector<User> UsersLoader::create_users(const std::string &file_path,
+                                            std::shared_ptr<RecommendationSystem> rs,
+                                            RatingStorage storage)
+{
+    // Keep RS alive if the caller did std::move(rs)
+    static std::shared_ptr<RecommendationSystem> keep_alive;
+    if (rs)
+    {
+        keep_alive = rs;
+    }
 
+    std::vector<User> users;
+    stream_users(file_path, rs, [&users](User &user) { users.push_back(std::move(user)); },
+                 storage);
+    return users;
+}
 
-            if (rating_str == "NA")
+void UsersLoader::stream_users(const std::string &file_path,
+                               std::shared_ptr<RecommendationSystem> rs,
+                               const user_callback &on_user,
+                               RatingStorage storage)
+{
+    std::unique_ptr<MappedFile> file;
+    try
+    {
+        file = std::make_unique<MappedFile>(file_path);
+    }
+    catch (const std::exception &)
+    {
+        std::cerr << "[ERROR] Failed to open file: " << file_path << std::endl;
+        throw;
+    }
+    file->advise_sequential();
+
+    LineChunk rest{file->data(), file->data() + file->size()};
+    std::vector<HeaderMovie> movies = parse_header(rest, rs.get());
+    // Every movie the header resolved is in this snapshot.
+    const MovieCatalog catalog = rs ? rs->get_movies() : MovieCatalog();
+    std::vector<std::pair<sp_movie, double>> ratings;
+
+    // Each window of user lines is parsed on several threads, then its users
+    // are built and handed out in file order before the next window is read.
+    size_t threads = parse_thread_count();
+    size_t first_line = 2;
+    while (rest.begin < rest.end)
+    {
+        LineChunk window = take_line_window(rest, threads * parse_chunk_bytes());
+        std::vector<LineChunk> chunks = split_line_chunks(window.begin, window.end - window.begin,
+                                                          parse_chunk_count(window.end - window.begin));
+        std::vector<UserChunk> parsed(chunks.size());
+        auto parse = [&] {
+            run_chunks(chunks.size(), [&](size_t i) { parse_user_chunk(chunks[i], movies, true, parsed[i]); });
+        };
+        if (rs)
+        {
+            RS_STATS_PHASE(rs->stats_data, StatsCounter::users_parse_ns);
+            parse();
+        }
+        else
+        {
+            parse();
+        }
+
+        for (UserChunk &chunk : parsed)
+        {
+            if (rs)
             {
-                continue;
+                RS_STATS_ADD(rs->stats_data, StatsCounter::users_parsed, chunk.records.size());
             }
-
-            try
+            for (const UserRecord &record : chunk.records)
             {
-                sp_movie movie = rs->get_movie(m_name, m_year);
-                if (!movie)
-                {
-                    std::cerr << "[ERROR] rs->get_movie(...) returned nullptr for " 
-                              << m_name << " (" << m_year << ")\n";
-                    throw std::runtime_error("Movie not found.");
-                }
-
-                double rating = std::stod(rating_str);
-                if (rating < 0 || rating > 10)
+                User user(record.name, rs, storage);
+                ratings.clear();
+                for (const auto &[column, rating] : record.ratings)
                 {
-                    std::cerr << "[ERROR] rating " << rating 
-                              << " out of [0..10] for movie: " << m_name << "\n";
-                    throw std::invalid_argument("Rating must be between 0 and 10.");
+                    ratings.emplace_back(movies[column].movie, rating);
                 }
-
-                user_ratings[movie] = rating;
-                movie_count++;
+                user.add_ratings(catalog, ratings);
+                on_user(user);
             }
-            catch (const std::exception &e)
+            if (chunk.error)
             {
-                std::cerr << "[EXCEPTION] Error processing movie: " << m_name
-                          << " (" << m_year << "). Exception: " << e.what() << "\n";
-                throw; // Re-throw
+                std::cerr << chunk.log;
+                std::cerr << "[ERROR] at line " << first_line + chunk.lines - 1
+                          << " of " << file_path << "\n";
+                std::rethrow_exception(chunk.error);
             }
-        } // end for each movie
+            first_line += chunk.lines;
+        }
+    }
+}
 
-        User user(user_name, rs);
+void UsersLoader::convert_users_file(const std::string &text_path, const std::string &matrix_path)
+{
+    std::unique_ptr<MappedFile> file;
+    try
+    {
+        file = std::make_unique<MappedFile>(text_path);
+    }
+    catch (const std::exception &)
+    {
+        std::cerr << "[ERROR] Failed to open file: " << text_path << std::endl;
+        throw;
+    }
+    file->advise_sequential();
 
-        for (const auto &[movie, rating] : user_ratings)
-        {
-            try
-            {
-                const std::vector<double>& feats = rs->get_movie_features(movie);
-                
+    LineChunk rest{file->data(), file->data() + file->size()};
+    std::vector<HeaderMovie> movies = parse_header(rest, nullptr);
 
-                user.add_movie_to_user(movie->get_name(),
-                                       movie->get_year(),
-                                       feats,
-                                       rating);
-            }
-            catch (const std::exception &e)
+    // The whole file is converted at once: only its rated cells are kept.
+    std::vector<LineChunk> chunks = split_line_chunks(rest.begin, rest.end - rest.begin,
+                                                      parse_chunk_count(rest.end - rest.begin));
+    std::vector<UserChunk> parsed(chunks.size());
+    run_chunks(chunks.size(), [&](size_t i) { parse_user_chunk(chunks[i], movies, false, parsed[i]); });
+
+    std::vector<std::string> names;
+    std::vector<std::uint64_t> row_offsets{0};
+    std::vector<RatingEntry> row_entries;
+    size_t first_line = 2;
+    for (UserChunk &chunk : parsed)
+    {
+        for (UserRecord &record : chunk.records)
+        {
+            names.push_back(std::move(record.name));
+            for (const auto &[column, rating] : record.ratings)
             {
-                std::cerr << "[EXCEPTION] Error adding movie to user: " 
-                          << movie->get_name()
-                          << " (" << movie->get_year() 
-                          << "). Exception: " << e.what() << "\n";
-                throw;
+                row_entries.push_back(RatingEntry{static_cast<std::uint32_t>(column),
+                                                  static_cast<float>(rating)});
             }
+            row_offsets.push_back(row_entries.size());
         }
+        if (chunk.error)
+        {
+            std::cerr << chunk.log;
+            std::cerr << "[ERROR] at line " << first_line + chunk.lines - 1
+                      << " of " << text_path << "\n";
+            std::rethrow_exception(chunk.error);
+        }
+        first_line += chunk.lines;
+    }
 
-        users.push_back(std::move(user));
-    } 
+    std::vector<MatrixMovie> dictionary;
+    dictionary.reserve(movies.size());
+    for (const HeaderMovie &movie : movies)
+    {
+        dictionary.push_back(MatrixMovie{movie.name, movie.year});
+    }
+    RatingsMatrix::write(matrix_path, dictionary, names, row_offsets, row_entries);
+}
 
-    file.close();
+std::vector<User> UsersLoader::create_users(const RatingsMatrix &matrix,
+                                            std::shared_ptr<RecommendationSystem> rs,
+                                            RatingStorage storage)
+{
+    std::vector<User> users;
+    users.reserve(matrix.user_count());
+    stream_users(matrix, rs, [&users](User &user) { users.push_back(std::move(user)); }, storage);
     return users;
-}
\ No newline at end of file
+}
+
+void UsersLoader::stream_users(const RatingsMatrix &matrix,
+                               std::shared_ptr<RecommendationSystem> rs,
+                               const user_callback &on_user,
+                               RatingStorage storage)
+{
+    // Resolved once per column; a missing movie is an error only if someone rated it.
+    std::vector<sp_movie> columns(matrix.movie_count());
+    for (size_t column = 0; column < columns.size(); ++column)
+    {
+        columns[column] = rs ? rs->get_movie(matrix.movie(column).name, matrix.movie(column).year)
+                             : nullptr;
+    }
+
+    const MovieCatalog catalog = rs ? rs->get_movies() : MovieCatalog();
+    std::vector<std::pair<sp_movie, double>> ratings;
+    for (size_t u = 0; u < matrix.user_count(); ++u)
+    {
+        User user(std::string(matrix.user_name(u)), rs, storage);
+        ratings.clear();
+        for (const RatingEntry &entry : matrix.row(u))
+        {
+            if (entry.index >= columns.size())
+            {
+                throw std::runtime_error("Corrupt ratings matrix: column out of range.");
+            }
+            if (!columns[entry.index])
+            {
+                const MatrixMovie &movie = matrix.movie(entry.index);
+                std::cerr << "[ERROR] rs->get_movie(...) returned nullptr for "
+                          << movie.name << " (" << movie.year << ")\n";
+                throw std::runtime_error("Movie not found.");
+            }
+            ratings.emplace_back(columns[entry.index], entry.rating);
+        }
+        user.add_ratings(catalog, ratings);
+        on_user(user);
+    }
+    if (rs)
+    {
+        RS_STATS_ADD(rs->stats_data, StatsCounter::users_parsed, matrix.user_count());
+    }
+}
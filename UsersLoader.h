@@ -4,11 +4,14 @@
 
 #include "User.h"
 #include "RecommendationSystem.h"
+#include "RatingsMatrix.h"
+#include <functional>
 #include <string>
 #include <vector>
 
 
 typedef std::unordered_map<sp_movie, double, hash_func, equal_func> rank_map;
+typedef std::function<void(User& user)> user_callback;
 
 class UsersLoader {
 public:
@@ -16,9 +19,46 @@ public:
      * Loads users and their ratings from a file and associates them with a RecommendationSystem
      * @param file_path - Path to the input file
      * @param rs - Shared pointer to the RecommendationSystem
+     * @param storage - how each User keeps its ratings
      * @return A vector of loaded User objects
      */
-    static std::vector<User> create_users(const std::string& file_path, std::shared_ptr<RecommendationSystem> rs);
+    static std::vector<User> create_users(const std::string& file_path, std::shared_ptr<RecommendationSystem> rs,
+                                          RatingStorage storage = RatingStorage::map);
+
+    /**
+     * Streams the users of a file to a callback, in file order, without keeping
+     * them: the file is parsed one window of lines at a time and each user is
+     * built with one rating insertion per rated movie. The callback may move
+     * the user out. Errors are reported exactly as by create_users; users
+     * before the bad line have already been delivered.
+     * @param file_path - Path to the input file
+     * @param rs - Shared pointer to the RecommendationSystem. May be null: no
+     * movie then resolves, so only users without ratings load
+     * @param on_user - called once per fully built user
+     * @param storage - how each User keeps its ratings
+     */
+    static void stream_users(const std::string& file_path, std::shared_ptr<RecommendationSystem> rs,
+                             const user_callback& on_user,
+                             RatingStorage storage = RatingStorage::map);
+
+    /**
+     * Converts a users file to the binary sparse format of RatingsMatrix.
+     * No RecommendationSystem is needed: columns keep their (name, year).
+     * Parse errors are reported exactly as by create_users.
+     */
+    static void convert_users_file(const std::string& text_path, const std::string& matrix_path);
+
+    /**
+     * Builds users straight from a mapped ratings matrix, in row order; no
+     * text is parsed. Ratings come back as stored, i.e. as float.
+     * @throws std::runtime_error if a rated column is not a movie of rs
+     */
+    static std::vector<User> create_users(const RatingsMatrix& matrix,
+                                          std::shared_ptr<RecommendationSystem> rs,
+                                          RatingStorage storage = RatingStorage::map);
+    static void stream_users(const RatingsMatrix& matrix, std::shared_ptr<RecommendationSystem> rs,
+                             const user_callback& on_user,
+                             RatingStorage storage = RatingStorage::map);
 };
 
 #endif // USERSLOADER_H
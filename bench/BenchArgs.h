@@ -0,0 +1,48 @@
+#ifndef BENCHARGS_H
+#define BENCHARGS_H
+
+#include <cstdlib>
+#include <map>
+#include <stdexcept>
+#include <string>
+
+/**
+ * "--name value" command line options; a flag without a value is stored as "1".
+ */
+class BenchArgs {
+private:
+    std::map<std::string, std::string> values;
+
+public:
+    BenchArgs(int argc, char** argv) {
+        for (int i = 1; i < argc; ++i) {
+            std::string name = argv[i];
+            if (name.rfind("--", 0) != 0) {
+                throw std::invalid_argument("Unexpected argument: " + name);
+            }
+            name = name.substr(2);
+            if (i + 1 < argc && std::string(argv[i + 1]).rfind("--", 0) != 0) {
+                values[name] = argv[++i];
+            } else {
+                values[name] = "1";
+            }
+        }
+    }
+
+    bool has(const std::string& name) const { return values.count(name) != 0; }
+
+    std::string get(const std::string& name, const std::string& fallback) const {
+        auto it = values.find(name);
+        return it != values.end() ? it->second : fallback;
+    }
+
+    std::size_t get_size(const std::string& name, std::size_t fallback) const {
+        return has(name) ? std::stoul(get(name, "")) : fallback;
+    }
+
+    double get_double(const std::string& name, double fallback) const {
+        return has(name) ? std::stod(get(name, "")) : fallback;
+    }
+};
+
+#endif // BENCHARGS_H
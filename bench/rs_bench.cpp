@@ -0,0 +1,316 @@
+// Benchmarks the loaders and the recommendation endpoints.
+//
+//   rs_bench [--movies N] [--dim D] [--users U] [--density P] [--seed S]
+//            [--movies-file F --users-file F] [--queries Q] [--cf-queries Q] [--k K]
+//            [--load-repeats R] [--snapshot] [--compact] [--threads T]
+//            [--similarity-index K] [--ann PROBES] [--storage float32|uint8] [--user-cf]
+//            [--cache CAPACITY] [--matrix] [--batch USERS] [--shards N]
+//            [--reduce DIM | --reduce-variance V] [--projection] [--paged CACHE_MB]
+//            [--stats]
+//
+// Without input files a dataset is generated in the temp directory. The
+// engine options are applied after loading so that runs can be compared
+// against each other on the same data. --stats dumps the system's own
+// counters as JSON after the run. --cache enables the result cache and
+// replays the content queries so that the second pass is served from it.
+// --matrix converts the users file to the binary ratings matrix and times
+// building the users from it. --batch times recommend_top_n_by_content_batch
+// over the query users, USERS per call; compare its users_per_sec with the
+// ops_per_sec of recommend_by_content. --shards runs the content and cf
+// queries again through N rs_shard_worker processes. --reduce and --reduce-variance
+// fit a PCA (or with --projection a random projection) right after loading,
+// report how the rankings moved and run the rest on the reduced features.
+// --paged reopens the catalog from a snapshot with its feature rows paged in
+// through a CACHE_MB block cache and reports the cache counters.
+#include "BenchArgs.h"
+#include "DataGenerator.h"
+#include "QuantizationReport.h"
+#include "RecommendationSystemLoader.h"
+#include "ReductionReport.h"
+#include "ShardedRecommender.h"
+#include "SimdKernels.h"
+#include "UsersLoader.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+typedef std::chrono::steady_clock bench_clock;
+
+/**
+ * Per-operation latency samples of one benchmark.
+ */
+class LatencyRecorder {
+private:
+    std::string name;
+    std::vector<double> micros;
+    double total_seconds = 0.0;
+
+public:
+    explicit LatencyRecorder(std::string name) : name(std::move(name)) {}
+
+    template <typename Operation>
+    void time(Operation&& operation) {
+        auto start = bench_clock::now();
+        operation();
+        double seconds = std::chrono::duration<double>(bench_clock::now() - start).count();
+        micros.push_back(seconds * 1e6);
+        total_seconds += seconds;
+    }
+
+    double total() const { return total_seconds; }
+
+    double percentile(double p) const {
+        if (micros.empty()) return 0.0;
+        std::vector<double> sorted(micros);
+        std::size_t rank = std::min(sorted.size() - 1,
+                                    static_cast<std::size_t>(p / 100.0 * sorted.size()));
+        std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+        return sorted[rank];
+    }
+
+    void report() const {
+        double throughput = total_seconds > 0.0 ? micros.size() / total_seconds : 0.0;
+        std::printf("%-22s %9zu %12.1f %14.1f %11.2f %11.2f %11.2f\n", name.c_str(), micros.size(),
+                    total_seconds * 1e3, throughput, percentile(50), percentile(90), percentile(99));
+    }
+
+    static void header() {
+        std::printf("%-22s %9s %12s %14s %11s %11s %11s\n", "benchmark", "ops", "total_ms",
+                    "ops_per_sec", "p50_us", "p90_us", "p99_us");
+    }
+};
+
+// Guards against the optimizer dropping a result.
+static volatile double sink;
+
+static void run(const BenchArgs& args) {
+    DataGeneratorOptions options;
+    options.movies = args.get_size("movies", options.movies);
+    options.dimension = args.get_size("dim", options.dimension);
+    options.users = args.get_size("users", options.users);
+    options.density = args.get_double("density", options.density);
+    options.seed = static_cast<unsigned>(args.get_size("seed", options.seed));
+
+    std::string movies_file = args.get("movies-file", "");
+    std::string users_file = args.get("users-file", "");
+    if (movies_file.empty() || users_file.empty()) {
+        std::string prefix = (std::filesystem::temp_directory_path() / "rs_bench").string();
+        movies_file = prefix + "_movies.txt";
+        users_file = prefix + "_users.txt";
+        DataGenerator::write_movies(movies_file, options);
+        DataGenerator::write_users(users_file, options);
+    }
+    RatingStorage storage = args.has("compact") ? RatingStorage::compact : RatingStorage::map;
+
+    LatencyRecorder load_movies("load_movies"), load_users("load_users");
+    std::shared_ptr<RecommendationSystem> rs;
+    std::vector<User> users;
+    std::size_t repeats = std::max<std::size_t>(1, args.get_size("load-repeats", 3));
+    for (std::size_t r = 0; r < repeats; ++r) {
+        load_movies.time([&] { rs = RecommendationSystemLoader::create_rs_from_movies(movies_file); });
+        users.clear();
+        load_users.time([&] { users = UsersLoader::create_users(users_file, rs, storage); });
+    }
+
+    LatencyRecorder load_snapshot("load_snapshot");
+    if (args.has("snapshot")) {
+        std::string snapshot_file = movies_file + ".snap";
+        RecommendationSystemLoader::save_snapshot(*rs, snapshot_file);
+        for (std::size_t r = 0; r < repeats; ++r) {
+            load_snapshot.time([&] { rs = RecommendationSystemLoader::load_snapshot(snapshot_file); });
+        }
+        users = UsersLoader::create_users(users_file, rs, storage);
+    }
+    LatencyRecorder load_paged("load_snapshot_paged");
+    if (args.has("paged")) {
+        std::string snapshot_file = movies_file + ".snap";
+        RecommendationSystemLoader::save_snapshot(*rs, snapshot_file);
+        PagerOptions pages;
+        pages.cache_bytes = args.get_size("paged", 64) << 20;
+        load_paged.time([&] {
+            rs = RecommendationSystemLoader::load_snapshot_paged(snapshot_file, pages);
+        });
+        users = UsersLoader::create_users(users_file, rs, storage);
+    }
+    LatencyRecorder convert_matrix("convert_matrix"), load_matrix("load_users_matrix");
+    if (args.has("matrix")) {
+        std::string matrix_file = users_file + ".matrix";
+        convert_matrix.time([&] { UsersLoader::convert_users_file(users_file, matrix_file); });
+        for (std::size_t r = 0; r < repeats; ++r) {
+            users.clear();
+            load_matrix.time([&] {
+                RatingsMatrix matrix(matrix_file);
+                users = UsersLoader::create_users(matrix, rs, storage);
+            });
+        }
+        std::printf("users file %ju bytes, matrix %ju bytes\n",
+                    static_cast<std::uintmax_t>(std::filesystem::file_size(users_file)),
+                    static_cast<std::uintmax_t>(std::filesystem::file_size(matrix_file)));
+    }
+    if (args.has("reduce") || args.has("reduce-variance")) {
+        ReductionOptions reduction;
+        reduction.method = args.has("projection") ? ReductionMethod::random_projection
+                                                  : ReductionMethod::pca;
+        reduction.dimension = args.get_size("reduce", 0);
+        reduction.explained_variance =
+            args.get_double("reduce-variance", reduction.explained_variance);
+        reduction.seed = options.seed;
+        std::cout << measure_reduction(*rs, users, reduction);
+    }
+    if (args.has("threads")) {
+        rs->set_executor(std::make_shared<ThreadPool>(args.get_size("threads", 0)));
+    }
+    if (args.has("similarity-index")) {
+        rs->enable_similarity_index(args.get_size("similarity-index", 0));
+    }
+    if (args.has("cache")) {
+        rs->enable_result_cache(args.get_size("cache", DEFAULT_RESULT_CACHE_CAPACITY));
+    }
+    if (args.has("ann")) {
+        AnnOptions ann;
+        ann.probes = args.get_size("ann", ann.probes);
+        rs->enable_ann_index(ann);
+    }
+
+    if (args.has("storage")) {
+        std::string storage_name = args.get("storage", "");
+        FeatureStorage features = storage_name == "uint8"     ? FeatureStorage::uint8
+                                  : storage_name == "float32" ? FeatureStorage::float32
+                                                              : FeatureStorage::float64;
+        std::cout << measure_quantization_error(*rs, users, features);
+    }
+
+    MovieCatalog catalog = rs->get_movies();
+    std::printf("movies=%zu dim=%zu users=%zu kernel=%s storage=%s\n", catalog.size(),
+                catalog.dimension(), users.size(), dot_kernel_name(),
+                storage == RatingStorage::compact ? "compact" : "map");
+    if (users.empty() || catalog.empty()) {
+        throw std::runtime_error("Nothing to benchmark: the dataset has no users or movies");
+    }
+
+    std::size_t queries = std::min(users.size(), args.get_size("queries", 200));
+    std::size_t cf_queries = std::min(queries, args.get_size("cf-queries", 20));
+    int k = static_cast<int>(args.get_size("k", 5));
+    std::mt19937 random(options.seed);
+    std::uniform_int_distribution<movie_id> any_movie(0, static_cast<movie_id>(catalog.size() - 1));
+
+    LatencyRecorder get_movie("get_movie");
+    for (std::size_t i = 0; i < queries * 100; ++i) {
+        const sp_movie& movie = catalog.movie(any_movie(random));
+        get_movie.time([&] { sink = rs->get_movie(movie->get_name(), movie->get_year()) ? 1 : 0; });
+    }
+
+    LatencyRecorder predict("predict_movie_score");
+    for (std::size_t i = 0; i < queries; ++i) {
+        const sp_movie& target = catalog.movie(any_movie(random));
+        predict.time([&] { sink = rs->predict_movie_score(users[i], target, k); });
+    }
+
+    LatencyRecorder content("recommend_by_content");
+    for (std::size_t i = 0; i < queries; ++i) {
+        content.time([&] { sink = rs->recommend_by_content(users[i]) ? 1 : 0; });
+    }
+
+    LatencyRecorder cached_content("content_cache_hit");
+    if (args.has("cache")) {
+        for (std::size_t i = 0; i < queries; ++i) {
+            cached_content.time([&] { sink = rs->recommend_by_content(users[i]) ? 1 : 0; });
+        }
+    }
+
+    LatencyRecorder content_batch("content_batch");
+    std::size_t batch_size = std::max<std::size_t>(1, args.get_size("batch", 64));
+    if (args.has("batch")) {
+        for (std::size_t first = 0; first < queries; first += batch_size) {
+            std::vector<User> batch(users.begin() + first,
+                                    users.begin() + std::min(queries, first + batch_size));
+            content_batch.time([&] {
+                sink = rs->recommend_top_n_by_content_batch(batch, 1).size();
+            });
+        }
+    }
+
+    LatencyRecorder cf("recommend_by_cf");
+    for (std::size_t i = 0; i < cf_queries; ++i) {
+        cf.time([&] { sink = rs->recommend_by_cf(users[i], k) ? 1 : 0; });
+    }
+
+    LatencyRecorder sharded_content("sharded_content"), sharded_cf("sharded_cf");
+    if (args.has("shards")) {
+        ShardedRecommender sharded(rs, args.get_size("shards", 2));
+        for (std::size_t i = 0; i < queries; ++i) {
+            sharded_content.time([&] { sink = sharded.recommend_by_content(users[i]) ? 1 : 0; });
+        }
+        for (std::size_t i = 0; i < cf_queries; ++i) {
+            sharded_cf.time([&] { sink = sharded.recommend_by_cf(users[i], k) ? 1 : 0; });
+        }
+    }
+
+    LatencyRecorder user_cf_build("enable_user_cf");
+    LatencyRecorder user_cf("recommend_by_user_cf");
+    if (args.has("user-cf")) {
+        user_cf_build.time([&] { rs->enable_user_cf(users); });
+        for (std::size_t i = 0; i < queries; ++i) {
+            user_cf.time([&] { sink = rs->recommend_by_user_cf(users[i], k) ? 1 : 0; });
+        }
+    }
+
+    LatencyRecorder::header();
+    load_movies.report();
+    load_users.report();
+    if (args.has("snapshot")) {
+        load_snapshot.report();
+    }
+    if (args.has("paged")) {
+        load_paged.report();
+    }
+    if (args.has("matrix")) {
+        convert_matrix.report();
+        load_matrix.report();
+    }
+    get_movie.report();
+    predict.report();
+    content.report();
+    if (args.has("cache")) {
+        cached_content.report();
+    }
+    if (args.has("batch")) {
+        content_batch.report();
+        std::printf("%-22s %.1f users_per_sec\n", "content_batch",
+                    content_batch.total() > 0.0 ? queries / content_batch.total() : 0.0);
+    }
+    cf.report();
+    if (args.has("shards")) {
+        sharded_content.report();
+        sharded_cf.report();
+    }
+    if (args.has("user-cf")) {
+        user_cf_build.report();
+        user_cf.report();
+    }
+    if (args.has("cache")) {
+        std::cout << rs->result_cache_stats();
+    }
+    if (args.has("paged")) {
+        std::cout << rs->get_paging_stats();
+    }
+    if (args.has("stats")) {
+        std::printf("%s\n", rs->stats().to_json().c_str());
+    }
+}
+
+int main(int argc, char** argv) {
+    try {
+        run(BenchArgs(argc, argv));
+    } catch (const std::exception& e) {
+        std::cerr << "[EXCEPTION] " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,31 @@
+// Writes a synthetic movies/users pair:
+//   rs_datagen --out PREFIX [--movies N] [--dim D] [--users U] [--density P] [--seed S]
+// produces PREFIX_movies.txt and PREFIX_users.txt.
+#include "BenchArgs.h"
+#include "DataGenerator.h"
+#include <iostream>
+
+int main(int argc, char** argv) {
+    try {
+        BenchArgs args(argc, argv);
+        if (!args.has("out")) {
+            std::cerr << "usage: rs_datagen --out PREFIX [--movies N] [--dim D] [--users U]"
+                         " [--density P] [--seed S]\n";
+            return 1;
+        }
+        DataGeneratorOptions options;
+        options.movies = args.get_size("movies", options.movies);
+        options.dimension = args.get_size("dim", options.dimension);
+        options.users = args.get_size("users", options.users);
+        options.density = args.get_double("density", options.density);
+        options.seed = static_cast<unsigned>(args.get_size("seed", options.seed));
+
+        std::string prefix = args.get("out", "");
+        DataGenerator::write_movies(prefix + "_movies.txt", options);
+        DataGenerator::write_users(prefix + "_users.txt", options);
+    } catch (const std::exception& e) {
+        std::cerr << "[EXCEPTION] " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,161 @@
+// Load generator for rs_server:
+//   rs_loadgen --socket PATH --users-file F [--connections C] [--depth D]
+//              [--requests R] [--call content|cf|predict|mixed] [--k K] [--n N] [--seed S]
+// Every connection runs on its own thread and keeps D requests in flight
+// until it has sent R. Users (and, for predict, movies) are drawn from the
+// users file the server was started with. Reports throughput and latency
+// percentiles over all responses.
+#include "BenchArgs.h"
+#include "RecommendationClient.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock load_clock;
+
+struct Workload {
+    std::vector<std::string> users;
+    std::vector<std::pair<std::string, int>> movies; // from the "Name-Year" header
+};
+
+static Workload read_workload(const std::string& users_file) {
+    std::ifstream file(users_file);
+    if (!file) {
+        throw std::runtime_error("Failed to open file: " + users_file);
+    }
+    Workload workload;
+    std::string line, token;
+    std::getline(file, line);
+    std::istringstream header(line);
+    while (header >> token) {
+        std::size_t dash = token.rfind('-');
+        if (dash != std::string::npos) {
+            workload.movies.emplace_back(token.substr(0, dash), std::stoi(token.substr(dash + 1)));
+        }
+    }
+    while (std::getline(file, line)) {
+        std::istringstream row(line);
+        if (row >> token) workload.users.push_back(token);
+    }
+    if (workload.users.empty() || workload.movies.empty()) {
+        throw std::runtime_error("No users or movies in " + users_file);
+    }
+    return workload;
+}
+
+struct ConnectionResult {
+    std::vector<double> micros;
+    std::size_t errors = 0;
+};
+
+static void drive(const BenchArgs& args, const Workload& workload, unsigned seed,
+                  ConnectionResult& result) {
+    const std::size_t total = args.get_size("requests", 10000);
+    const std::size_t depth = std::max<std::size_t>(1, args.get_size("depth", 8));
+    const std::string call = args.get("call", "content");
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<std::size_t> any_user(0, workload.users.size() - 1);
+    std::uniform_int_distribution<std::size_t> any_movie(0, workload.movies.size() - 1);
+
+    RecommendationClient client(args.get("socket", ""));
+    std::deque<load_clock::time_point> in_flight; // responses come back in order
+    std::size_t sent = 0;
+    auto send_next = [&] {
+        ServerRequest request;
+        request.id = static_cast<std::uint32_t>(sent);
+        request.k = static_cast<std::int32_t>(args.get_size("k", 5));
+        request.n = static_cast<std::int32_t>(args.get_size("n", 10));
+        request.user = workload.users[any_user(random)];
+        std::size_t kind = call == "cf"      ? 1
+                           : call == "predict" ? 2
+                           : call == "mixed"   ? sent % 3
+                                               : 0;
+        request.call = kind == 1   ? ServerCall::cf
+                       : kind == 2 ? ServerCall::predict
+                                   : ServerCall::content;
+        if (request.call == ServerCall::predict) {
+            const auto& [name, year] = workload.movies[any_movie(random)];
+            request.movie = name;
+            request.year = year;
+        }
+        in_flight.push_back(load_clock::now());
+        client.send(request);
+        ++sent;
+    };
+    while (sent < total && in_flight.size() < depth) send_next();
+    while (!in_flight.empty()) {
+        ServerResponse response = client.receive();
+        auto elapsed = load_clock::now() - in_flight.front();
+        in_flight.pop_front();
+        result.micros.push_back(std::chrono::duration<double, std::micro>(elapsed).count());
+        result.errors += response.status != ResponseStatus::ok;
+        if (sent < total) send_next();
+    }
+}
+
+static double percentile(std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0.0;
+    std::size_t rank = std::min(sorted.size() - 1,
+                                static_cast<std::size_t>(p / 100.0 * sorted.size()));
+    return sorted[rank];
+}
+
+int main(int argc, char** argv) {
+    try {
+        BenchArgs args(argc, argv);
+        if (!args.has("socket") || !args.has("users-file")) {
+            std::cerr << "usage: rs_loadgen --socket PATH --users-file F [--connections C]"
+                         " [--depth D] [--requests R] [--call content|cf|predict|mixed]"
+                         " [--k K] [--n N] [--seed S]\n";
+            return 1;
+        }
+        Workload workload = read_workload(args.get("users-file", ""));
+        std::size_t connections = std::max<std::size_t>(1, args.get_size("connections", 4));
+        unsigned seed = static_cast<unsigned>(args.get_size("seed", 1));
+
+        std::vector<ConnectionResult> results(connections);
+        std::vector<std::string> failures(connections);
+        auto start = load_clock::now();
+        std::vector<std::thread> threads;
+        for (std::size_t c = 0; c < connections; ++c) {
+            threads.emplace_back([&, c] {
+                try {
+                    drive(args, workload, seed + static_cast<unsigned>(c), results[c]);
+                } catch (const std::exception& e) {
+                    failures[c] = e.what();
+                }
+            });
+        }
+        for (std::thread& thread : threads) thread.join();
+        double seconds = std::chrono::duration<double>(load_clock::now() - start).count();
+
+        std::vector<double> micros;
+        std::size_t errors = 0;
+        for (std::size_t c = 0; c < connections; ++c) {
+            if (!failures[c].empty()) {
+                std::cerr << "[ERROR] connection " << c << ": " << failures[c] << "\n";
+            }
+            micros.insert(micros.end(), results[c].micros.begin(), results[c].micros.end());
+            errors += results[c].errors;
+        }
+        std::sort(micros.begin(), micros.end());
+        std::printf("%-12s %9s %9s %12s %14s %11s %11s %11s %11s\n", "call", "responses", "errors",
+                    "total_ms", "ops_per_sec", "p50_us", "p90_us", "p99_us", "p999_us");
+        std::printf("%-12s %9zu %9zu %12.1f %14.1f %11.1f %11.1f %11.1f %11.1f\n",
+                    args.get("call", "content").c_str(), micros.size(), errors, seconds * 1e3,
+                    seconds > 0.0 ? micros.size() / seconds : 0.0, percentile(micros, 50),
+                    percentile(micros, 90), percentile(micros, 99), percentile(micros, 99.9));
+    } catch (const std::exception& e) {
+        std::cerr << "[EXCEPTION] " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,61 @@
+// Serves a movies/users pair over a Unix socket until SIGINT or SIGTERM:
+//   rs_server --socket PATH --movies-file F --users-file F [--compact]
+//             [--window-us W] [--max-batch B] [--queue Q] [--threads T] [--cache CAPACITY]
+// Prints the server counters on exit. See RecommendationServer for batching
+// and backpressure, ServerProtocol for the wire format.
+#include "BenchArgs.h"
+#include "RecommendationServer.h"
+#include "RecommendationSystemLoader.h"
+#include "UsersLoader.h"
+#include <csignal>
+#include <iostream>
+
+int main(int argc, char** argv) {
+    try {
+        BenchArgs args(argc, argv);
+        if (!args.has("socket") || !args.has("movies-file") || !args.has("users-file")) {
+            std::cerr << "usage: rs_server --socket PATH --movies-file F --users-file F [--compact]"
+                         " [--window-us W] [--max-batch B] [--queue Q] [--threads T]"
+                         " [--cache CAPACITY]\n";
+            return 1;
+        }
+        // Blocked before any thread starts, so only sigwait sees them.
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+        auto rs = RecommendationSystemLoader::create_rs_from_movies(args.get("movies-file", ""));
+        RatingStorage storage = args.has("compact") ? RatingStorage::compact : RatingStorage::map;
+        std::vector<User> users =
+            UsersLoader::create_users(args.get("users-file", ""), rs, storage);
+        if (args.has("threads")) {
+            rs->set_executor(std::make_shared<ThreadPool>(args.get_size("threads", 0)));
+        }
+        if (args.has("cache")) {
+            rs->enable_result_cache(args.get_size("cache", DEFAULT_RESULT_CACHE_CAPACITY));
+        }
+
+        ServerOptions options;
+        options.socket_path = args.get("socket", "");
+        options.batch_window = std::chrono::microseconds(
+            args.get_size("window-us", static_cast<std::size_t>(options.batch_window.count())));
+        options.max_batch = args.get_size("max-batch", options.max_batch);
+        options.queue_capacity = args.get_size("queue", options.queue_capacity);
+
+        std::size_t user_count = users.size();
+        RecommendationServer server(rs, std::move(users), options);
+        server.start();
+        std::cout << "serving " << rs->get_movies().size() << " movies and " << user_count
+                  << " users on " << options.socket_path << std::endl;
+        int received = 0;
+        sigwait(&signals, &received);
+        server.stop();
+        std::cout << server.stats();
+    } catch (const std::exception& e) {
+        std::cerr << "[EXCEPTION] " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,7 @@
+// Shard worker started by ShardedRecommender, which hands it its socket on
+// descriptor 3; not meant to be run by hand.
+#include "ShardedRecommender.h"
+
+int main() {
+    return ShardedRecommender::run_worker();
+}
@@ -0,0 +1,65 @@
+#ifndef TESTDATA_H
+#define TESTDATA_H
+
+#include "DataGenerator.h"
+#include "RecommendationSystemLoader.h"
+#include "UsersLoader.h"
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct TestDataset {
+    std::string movies;
+    std::string users;
+};
+
+/**
+ * Generates a movies/users pair in the temp directory, named after the test.
+ */
+inline TestDataset make_dataset(const std::string& name, const DataGeneratorOptions& options) {
+    std::filesystem::path base = std::filesystem::temp_directory_path() / ("rs_test_" + name);
+    TestDataset dataset{base.string() + "_movies.txt", base.string() + "_users.txt"};
+    DataGenerator::write_movies(dataset.movies, options);
+    DataGenerator::write_users(dataset.users, options);
+    return dataset;
+}
+
+/**
+ * The catalog most recommendation tests run on: 400 movies of width 10 and 25
+ * users who rated about a tenth of them.
+ */
+inline DataGeneratorOptions small_options() {
+    DataGeneratorOptions options;
+    options.movies = 400;
+    options.dimension = 10;
+    options.users = 25;
+    options.density = 0.1;
+    options.seed = 3;
+    return options;
+}
+
+/**
+ * A generated dataset loaded into a fresh system, with its users in map
+ * storage. load_users() reads them again, e.g. in compact storage or after
+ * the system changed.
+ */
+struct TestSystem {
+    TestDataset data;
+    std::shared_ptr<RecommendationSystem> rs;
+    std::vector<User> users;
+
+    std::vector<User> load_users(RatingStorage storage = RatingStorage::map) const {
+        return UsersLoader::create_users(data.users, rs, storage);
+    }
+};
+
+inline TestSystem make_system(const std::string& name,
+                              const DataGeneratorOptions& options = small_options()) {
+    TestSystem system{make_dataset(name, options), nullptr, {}};
+    system.rs = RecommendationSystemLoader::create_rs_from_movies(system.data.movies);
+    system.users = system.load_users();
+    return system;
+}
+
+#endif // TESTDATA_H
@@ -0,0 +1,91 @@
+#ifndef TESTHARNESS_H
+#define TESTHARNESS_H
+
+#include <cmath>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/**
+ * Minimal test harness: TEST_CASE registers a function, the CHECK macros
+ * record failures without stopping the test, and TEST_MAIN runs every
+ * registered case. The process exits non-zero if anything failed.
+ */
+namespace test_harness {
+
+struct TestCase {
+    const char* name;
+    std::function<void()> body;
+};
+
+inline std::vector<TestCase>& registry() {
+    static std::vector<TestCase> cases;
+    return cases;
+}
+
+inline int& failures() {
+    static int count = 0;
+    return count;
+}
+
+struct Registrar {
+    Registrar(const char* name, std::function<void()> body) {
+        registry().push_back({name, std::move(body)});
+    }
+};
+
+inline void fail(const char* file, int line, const std::string& message) {
+    ++failures();
+    std::cerr << "[FAIL] " << file << ":" << line << ": " << message << "\n";
+}
+
+inline int run_all() {
+    for (const TestCase& test : registry()) {
+        int before = failures();
+        try {
+            test.body();
+        } catch (const std::exception& e) {
+            fail(test.name, 0, std::string("unexpected exception: ") + e.what());
+        }
+        std::cout << (failures() == before ? "[ OK ] " : "[FAIL] ") << test.name << "\n";
+    }
+    return failures() == 0 ? 0 : 1;
+}
+
+} // namespace test_harness
+
+#define TEST_CASE(name)                                                   \
+    static void name();                                                   \
+    static test_harness::Registrar name##_registrar(#name, name);         \
+    static void name()
+
+#define CHECK(condition)                                                  \
+    do {                                                                  \
+        if (!(condition)) test_harness::fail(__FILE__, __LINE__, #condition); \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                        \
+    do {                                                                  \
+        if (!((actual) == (expected)))                                    \
+            test_harness::fail(__FILE__, __LINE__, #actual " == " #expected); \
+    } while (0)
+
+#define CHECK_NEAR(actual, expected, tolerance)                           \
+    do {                                                                  \
+        if (!(std::fabs((actual) - (expected)) <= (tolerance)))           \
+            test_harness::fail(__FILE__, __LINE__, #actual " ~ " #expected); \
+    } while (0)
+
+#define CHECK_THROWS(expression, exception_type)                          \
+    do {                                                                  \
+        bool thrown = false;                                              \
+        try { expression; } catch (const exception_type&) { thrown = true; } \
+        if (!thrown) test_harness::fail(__FILE__, __LINE__, #expression " throws " #exception_type); \
+    } while (0)
+
+#define TEST_MAIN() \
+    int main() { return test_harness::run_all(); }
+
+#endif // TESTHARNESS_H
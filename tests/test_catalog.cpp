@@ -0,0 +1,197 @@
+#include "TestHarness.h"
+#include "MovieCatalog.h"
+#include "RecommendationSystem.h"
+#include "SimilarityIndex.h"
+#include "ThreadPool.h"
+#include "TitleInterner.h"
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Counts every plain heap allocation in this test binary.
+static std::atomic<std::size_t> allocations{0};
+
+void* operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* block = std::malloc(size ? size : 1)) {
+        return block;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* block) noexcept {
+    std::free(block);
+}
+
+void operator delete(void* block, std::size_t) noexcept {
+    std::free(block);
+}
+
+static std::vector<double> features(double first, std::size_t dim = 3) {
+    std::vector<double> values(dim, 1.0);
+    values[0] = first;
+    return values;
+}
+
+TEST_CASE(ids_follow_insertion_order) {
+    MovieCatalog catalog;
+    CHECK(catalog.empty());
+    CHECK_EQ(catalog.add("Alpha", 1999, features(2.0)), 0u);
+    CHECK_EQ(catalog.add("Beta", 2001, features(3.0)), 1u);
+    CHECK_EQ(catalog.size(), 2u);
+    CHECK_EQ(catalog.find("Beta", 2001), 1u);
+    CHECK_EQ(catalog.find("Beta", 2002), INVALID_MOVIE_ID);
+    CHECK_EQ(catalog.find("Gamma", 2001), INVALID_MOVIE_ID);
+    CHECK_EQ(catalog.find(catalog.movie(0)), 0u);
+    CHECK_EQ(catalog.movie(1)->get_name(), "Beta");
+}
+
+TEST_CASE(lookups_do_not_allocate) {
+    auto rs = std::make_shared<RecommendationSystem>();
+    rs->add_movie_to_rs("A title long enough to defeat the small string buffer", 1999,
+                        features(2.0));
+    rs->add_movie_to_rs("Beta", 2001, features(3.0));
+    MovieCatalog catalog = rs->get_movies();
+    sp_movie beta = catalog.movie(1);
+    std::string_view long_title = catalog.movie(0)->get_name();
+
+    std::size_t before = allocations.load();
+    movie_id by_name = catalog.find(long_title, 1999);
+    movie_id by_movie = catalog.find(beta);
+    movie_id missing = catalog.find("Gamma", 2001);
+    sp_movie found = rs->get_movie(long_title, 1999);
+    sp_movie absent = rs->get_movie("Beta", 2002);
+    std::size_t after = allocations.load();
+
+    CHECK_EQ(after, before);
+    CHECK_EQ(by_name, 0u);
+    CHECK_EQ(by_movie, 1u);
+    CHECK_EQ(missing, INVALID_MOVIE_ID);
+    CHECK(found == catalog.movie(0));
+    CHECK(!absent);
+}
+
+// Lookups take no lock, so they must stay right while interning grows the table.
+TEST_CASE(titles_are_found_while_others_are_interned) {
+    TitleInterner& interner = TitleInterner::instance();
+    title_id first = interner.intern("Interned before the writer");
+    std::atomic<bool> writing{true};
+    std::atomic<std::size_t> wrong{0};
+    std::thread reader([&] {
+        while (writing.load()) {
+            if (interner.find("Interned before the writer") != first ||
+                interner.title(first) != "Interned before the writer" ||
+                interner.find("Never interned") != INVALID_TITLE_ID) {
+                wrong.fetch_add(1);
+            }
+        }
+    });
+    std::vector<title_id> ids;
+    for (int i = 0; i < 5000; ++i) {
+        ids.push_back(interner.intern("Interned title " + std::to_string(i)));
+    }
+    writing = false;
+    reader.join();
+    CHECK_EQ(wrong.load(), 0u);
+    for (int i = 0; i < 5000; ++i) {
+        std::string title = "Interned title " + std::to_string(i);
+        CHECK_EQ(interner.find(title), ids[i]);
+        CHECK_EQ(interner.intern(title), ids[i]);
+        CHECK_EQ(interner.title(ids[i]), title);
+    }
+}
+
+TEST_CASE(rows_are_aligned_and_padded) {
+    MovieCatalog catalog;
+    catalog.add("Padded", 2000, features(4.0, 5));
+    CHECK_EQ(catalog.dimension(), 5u);
+    CHECK_EQ(catalog.stride() % (FEATURE_ALIGNMENT / sizeof(double)), 0u);
+    CHECK_EQ(reinterpret_cast<std::uintptr_t>(catalog.row(0)) % FEATURE_ALIGNMENT, 0u);
+    for (std::size_t i = catalog.dimension(); i < catalog.stride(); ++i) {
+        CHECK_EQ(catalog.row(0)[i], 0.0);
+    }
+    CHECK_NEAR(catalog.norm(0), std::sqrt(16.0 + 4.0), 1e-12);
+}
+
+TEST_CASE(feature_size_mismatch_throws) {
+    MovieCatalog catalog;
+    catalog.add("First", 2000, features(1.0, 3));
+    CHECK_THROWS(catalog.add("Second", 2000, features(1.0, 4)), std::runtime_error);
+}
+
+TEST_CASE(copies_do_not_see_later_movies) {
+    MovieCatalog catalog;
+    catalog.add("Old", 1990, features(1.0));
+    MovieCatalog snapshot = catalog;
+    const double* old_row = snapshot.row(0);
+    for (int i = 0; i < 200; ++i) {
+        catalog.add("New" + std::to_string(i), 2000, features(i + 1.0));
+    }
+    CHECK_EQ(snapshot.size(), 1u);
+    CHECK_EQ(snapshot.find("New0", 2000), INVALID_MOVIE_ID);
+    CHECK_EQ(snapshot.row(0), old_row);
+    CHECK_EQ(catalog.find("New199", 2000), 200u);
+    CHECK_EQ(catalog.features_of(200)[0], 200.0);
+}
+
+TEST_CASE(diverged_copies_stay_independent) {
+    MovieCatalog base;
+    base.add("Shared", 2000, features(1.0));
+    MovieCatalog left = base;
+    MovieCatalog right = base;
+    left.add("Left", 2000, features(2.0));
+    right.add("Right", 2000, features(3.0));
+    CHECK_EQ(left.find("Left", 2000), 1u);
+    CHECK_EQ(left.find("Right", 2000), INVALID_MOVIE_ID);
+    CHECK_EQ(right.find("Right", 2000), 1u);
+    CHECK_EQ(right.find("Left", 2000), INVALID_MOVIE_ID);
+    CHECK_EQ(right.features_of(1)[0], 3.0);
+    CHECK_EQ(left.features_of(1)[0], 2.0);
+}
+
+TEST_CASE(external_storage_is_copied_on_write) {
+    auto rows = std::make_shared<std::vector<double>>(std::vector<double>{1, 2, 0, 0, 3, 4, 0, 0});
+    auto norms = std::make_shared<std::vector<double>>(std::vector<double>{std::sqrt(5.0), 5.0});
+    MovieCatalog catalog;
+    catalog.attach_external(2, 4, 2, rows->data(), norms->data(), rows);
+    catalog.add_external("ExternalA", 1980);
+    catalog.add_external("ExternalB", 1981);
+    CHECK(catalog.is_external());
+    CHECK_EQ(catalog.row(1), rows->data() + 4);
+    CHECK_EQ(catalog.norm(1), 5.0);
+
+    catalog.add("Owned", 1982, std::vector<double>{5.0, 6.0});
+    CHECK(!catalog.is_external());
+    CHECK_EQ(catalog.size(), 3u);
+    CHECK_EQ(catalog.features_of(1)[1], 4.0);
+    CHECK_EQ(catalog.find("ExternalA", 1980), 0u);
+}
+
+TEST_CASE(incremental_similarity_index_matches_rebuild) {
+    MovieCatalog catalog;
+    SimilarityIndex incremental(4);
+    for (int i = 0; i < 30; ++i) {
+        std::vector<double> values{1.0 + i % 7, 2.0 + (i * 3) % 5, 1.0 + (i * 5) % 9};
+        movie_id id = catalog.add("Movie" + std::to_string(i), 2000, values);
+        incremental.add_movie(catalog, id);
+    }
+    SimilarityIndex rebuilt(4);
+    ThreadPool pool(2);
+    rebuilt.build(catalog, &pool);
+    for (movie_id id = 0; id < catalog.size(); ++id) {
+        const neighbor_list& a = incremental.neighbors_of(id);
+        const neighbor_list& b = rebuilt.neighbors_of(id);
+        CHECK_EQ(a.size(), b.size());
+        for (std::size_t i = 0; i < a.size() && i < b.size(); ++i) {
+            CHECK_EQ(a[i].id, b[i].id);
+        }
+    }
+}
+
+TEST_MAIN()
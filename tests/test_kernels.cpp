@@ -0,0 +1,158 @@
+#include "TestHarness.h"
+#include "SimdKernels.h"
+#include "ThreadPool.h"
+#include "TopN.h"
+#include <atomic>
+#include <random>
+#include <vector>
+
+// Kernel results may differ from the scalar sum by reassociation only.
+static void check_kernel(dot_func kernel, const char* name) {
+    std::mt19937 random(7);
+    std::uniform_real_distribution<double> value(-10.0, 10.0);
+    for (std::size_t n = 0; n <= 67; ++n) {
+        std::vector<double> a(n), b(n);
+        double magnitude = 0.0;
+        for (std::size_t i = 0; i < n; ++i) {
+            a[i] = value(random);
+            b[i] = value(random);
+            magnitude += std::fabs(a[i] * b[i]);
+        }
+        double expected = dot_product_scalar(a.data(), b.data(), n);
+        double actual = kernel(a.data(), b.data(), n);
+        if (std::fabs(actual - expected) > 1e-12 * (1.0 + magnitude)) {
+            test_harness::fail(__FILE__, __LINE__,
+                               std::string(name) + " differs at n=" + std::to_string(n));
+        }
+    }
+}
+
+TEST_CASE(dispatched_kernel_matches_scalar) {
+    check_kernel(dot_product, dot_kernel_name());
+    CHECK(select_dot_kernel() != nullptr);
+}
+
+TEST_CASE(every_supported_kernel_matches_scalar) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) check_kernel(dot_product_sse2, "sse2");
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        check_kernel(dot_product_avx2, "avx2");
+    }
+    if (__builtin_cpu_supports("avx512f")) check_kernel(dot_product_avx512, "avx512");
+#endif
+}
+
+TEST_CASE(quantized_kernels_match_scalar) {
+    std::mt19937 random(11);
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::uniform_real_distribution<float> value(-10.0f, 10.0f);
+    const QuantizedKernels& kernels = quantized_kernels();
+    for (std::size_t n : {0, 32, 64, 96, 4096, 300000}) {
+        std::vector<std::uint8_t> a(n), b(n);
+        std::vector<float> x(n), y(n);
+        double magnitude = 0.0;
+        for (std::size_t i = 0; i < n; ++i) {
+            a[i] = static_cast<std::uint8_t>(byte(random));
+            b[i] = static_cast<std::uint8_t>(byte(random));
+            x[i] = value(random);
+            y[i] = value(random);
+            magnitude += std::fabs(x[i] * y[i]) + std::fabs(x[i] * b[i]);
+        }
+        // Integer dot products are exact, including past the int32 flush block.
+        CHECK_EQ(kernels.u8(a.data(), b.data(), n), dot_product_u8_scalar(a.data(), b.data(), n));
+        CHECK_NEAR(kernels.f32(x.data(), y.data(), n), dot_product_f32_scalar(x.data(), y.data(), n),
+                   1e-5 * (1.0 + magnitude));
+        CHECK_NEAR(kernels.f32_u8(x.data(), b.data(), n),
+                   dot_product_f32_u8_scalar(x.data(), b.data(), n), 1e-5 * (1.0 + magnitude));
+    }
+}
+
+TEST_CASE(panel_kernels_match_row_by_row_dots) {
+    std::mt19937 random(5);
+    std::uniform_real_distribution<double> value(-10.0, 10.0);
+    std::vector<dot_panel_func> kernels{dot_panel_kernel(), dot_panel_scalar};
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        kernels.push_back(dot_panel_avx2);
+    }
+    if (__builtin_cpu_supports("avx512f")) kernels.push_back(dot_panel_avx512);
+#endif
+    for (std::size_t rows : {1, 4, 7}) {
+        for (std::size_t dim : {1, 10, 33}) {
+            for (std::size_t width : {8, 16, 24}) {
+                const std::size_t stride = dim + 3, out_stride = width + 8;
+                std::vector<double> a(rows * stride), panel(dim * width);
+                for (double& x : a) x = value(random);
+                for (double& x : panel) x = value(random);
+                for (dot_panel_func kernel : kernels) {
+                    std::vector<double> out(rows * out_stride, -1.0);
+                    kernel(a.data(), rows, stride, panel.data(), dim, width, out.data(), out_stride);
+                    for (std::size_t r = 0; r < rows; ++r) {
+                        for (std::size_t c = 0; c < width; ++c) {
+                            double expected = 0.0;
+                            for (std::size_t k = 0; k < dim; ++k) {
+                                expected += a[r * stride + k] * panel[k * width + c];
+                            }
+                            CHECK_NEAR(out[r * out_stride + c], expected, 1e-9);
+                        }
+                        // Past width is left alone.
+                        CHECK_EQ(out[r * out_stride + width], -1.0);
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE(cosine_of_zero_vector_is_zero) {
+    CHECK_EQ(cosine_from_norms(3.0, 0.0, 2.0), 0.0);
+    CHECK_NEAR(cosine_from_norms(2.0, 1.0, 2.0), 1.0, 1e-15);
+}
+
+TEST_CASE(top_n_orders_by_score_then_id) {
+    TopN best(3);
+    best.push(1.0, 4);
+    best.push(2.0, 9);
+    best.push(1.0, 2);
+    best.push(0.5, 1);
+    best.push(std::nan(""), 0);
+    std::vector<ScoredId> sorted = best.take_sorted();
+    CHECK_EQ(sorted.size(), 3u);
+    CHECK_EQ(sorted[0].id, 9u);
+    CHECK_EQ(sorted[1].id, 2u);
+    CHECK_EQ(sorted[2].id, 4u);
+}
+
+TEST_CASE(top_n_merge_equals_single_pass) {
+    TopN whole(5), left(5), right(5);
+    for (movie_id id = 0; id < 40; ++id) {
+        double score = static_cast<double>((id * 7) % 11);
+        whole.push(score, id);
+        (id < 17 ? left : right).push(score, id);
+    }
+    left.merge(right);
+    std::vector<ScoredId> expected = whole.take_sorted();
+    std::vector<ScoredId> merged = left.take_sorted();
+    CHECK_EQ(merged.size(), expected.size());
+    for (std::size_t i = 0; i < expected.size() && i < merged.size(); ++i) {
+        CHECK_EQ(merged[i].id, expected[i].id);
+    }
+}
+
+// Each call returns as soon as its last task is done, so a batch freed too
+// early is touched by the worker that finished it.
+TEST_CASE(back_to_back_parallel_fors_complete) {
+    ThreadPool pool(3);
+    std::atomic<std::size_t> runs{0};
+    std::size_t expected = 0;
+    for (std::size_t call = 0; call < 20000; ++call) {
+        std::size_t count = 1 + call % 4;
+        pool.parallel_for(count, [&runs](std::size_t) { runs.fetch_add(1); });
+        expected += count;
+    }
+    CHECK_EQ(runs.load(), expected);
+}
+
+TEST_MAIN()
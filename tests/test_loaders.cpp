@@ -0,0 +1,420 @@
+#include "TestHarness.h"
+#include "TestData.h"
+#include "RecommendationSystemLoader.h"
+#include "UsersLoader.h"
+#include "TextParser.h"
+#include "CatalogSnapshot.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <sstream>
+
+// Runs a load that must throw an Exception and returns what it printed.
+template <typename Exception>
+static std::string failed_load_output(const std::function<void()>& load) {
+    std::ostringstream captured;
+    std::streambuf* previous = std::cerr.rdbuf(captured.rdbuf());
+    bool thrown = false;
+    try {
+        load();
+    } catch (const Exception&) {
+        thrown = true;
+    } catch (...) {
+        std::cerr.rdbuf(previous);
+        throw;
+    }
+    std::cerr.rdbuf(previous);
+    CHECK(thrown);
+    return captured.str();
+}
+
+TEST_CASE(generated_files_load) {
+    DataGeneratorOptions options;
+    options.movies = 120;
+    options.dimension = 6;
+    options.users = 15;
+    TestDataset data = make_dataset("load", options);
+
+    auto rs = RecommendationSystemLoader::create_rs_from_movies(data.movies);
+    CHECK_EQ(rs->get_movies().size(), options.movies);
+    CHECK_EQ(rs->get_movies().dimension(), options.dimension);
+
+    std::size_t streamed = 0;
+    UsersLoader::stream_users(data.users, rs, [&](User& user) {
+        ++streamed;
+        CHECK(!user.get_rank().empty());
+    });
+    CHECK_EQ(streamed, options.users);
+}
+
+TEST_CASE(generator_is_deterministic) {
+    DataGeneratorOptions options;
+    options.movies = 50;
+    TestDataset first = make_dataset("determinism_a", options);
+    TestDataset second = make_dataset("determinism_b", options);
+    std::ifstream a(first.users), b(second.users);
+    std::string line_a, line_b;
+    bool same = true;
+    while (std::getline(a, line_a)) {
+        same = same && std::getline(b, line_b) && line_a == line_b;
+    }
+    CHECK(same);
+}
+
+TEST_CASE(snapshot_round_trip_keeps_catalog) {
+    DataGeneratorOptions options;
+    options.movies = 200;
+    options.dimension = 9;
+    TestDataset data = make_dataset("snapshot", options);
+    auto rs = RecommendationSystemLoader::create_rs_from_movies(data.movies);
+    std::string path = data.movies + ".snap";
+    RecommendationSystemLoader::save_snapshot(*rs, path);
+    auto loaded = RecommendationSystemLoader::load_snapshot(path, true);
+
+    MovieCatalog original = rs->get_movies();
+    MovieCatalog mapped = loaded->get_movies();
+    CHECK(mapped.is_external());
+    CHECK_EQ(mapped.size(), original.size());
+    for (movie_id id = 0; id < original.size() && id < mapped.size(); ++id) {
+        CHECK_EQ(mapped.movie(id)->get_name(), original.movie(id)->get_name());
+        CHECK(mapped.features_of(id).to_vector() == original.features_of(id).to_vector());
+        CHECK_EQ(mapped.norm(id), original.norm(id));
+    }
+    CHECK(loaded->get_movie(original.movie(5)->get_name(), original.movie(5)->get_year()));
+}
+
+// Loads a copy of the snapshot at `path` after `edit`, which must fail; returns the error.
+static std::string damaged_snapshot_error(const std::string& path,
+                                          const std::function<void(std::string&)>& edit,
+                                          bool paged) {
+    std::ifstream in(path, std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    edit(bytes);
+    std::string damaged = path + ".damaged";
+    std::ofstream(damaged, std::ios::binary).write(bytes.data(), bytes.size());
+    try {
+        if (paged) {
+            RecommendationSystemLoader::load_snapshot_paged(damaged, PagerOptions(), true);
+        } else {
+            RecommendationSystemLoader::load_snapshot(damaged, true);
+        }
+    } catch (const std::runtime_error& e) {
+        return e.what();
+    }
+    return "loaded";
+}
+
+TEST_CASE(damaged_snapshots_are_rejected) {
+    DataGeneratorOptions options;
+    options.movies = 50;
+    options.dimension = 9;
+    TestDataset data = make_dataset("damaged", options);
+    auto rs = RecommendationSystemLoader::create_rs_from_movies(data.movies);
+    std::string path = data.movies + ".snap";
+    RecommendationSystemLoader::save_snapshot(*rs, path);
+    auto header = [](std::string& bytes) { return reinterpret_cast<SnapshotHeader*>(&bytes[0]); };
+
+    for (bool paged : {false, true}) {
+        // 2^61 more movies wrap both the rows and the norms extent back to the real ones.
+        CHECK(damaged_snapshot_error(path, [&](std::string& bytes) {
+                  header(bytes)->count += 1ull << 61;
+              }, paged).find("Corrupt snapshot layout") != std::string::npos);
+        CHECK(damaged_snapshot_error(path, [&](std::string& bytes) {
+                  header(bytes)->strings_offset = 0;
+              }, paged).find("Corrupt snapshot layout") != std::string::npos);
+        CHECK(damaged_snapshot_error(path, [&](std::string& bytes) {
+                  header(bytes)->strings_size = UINT64_MAX;
+              }, paged).find("Corrupt snapshot layout") != std::string::npos);
+        CHECK(damaged_snapshot_error(path, [&](std::string& bytes) {
+                  header(bytes)->features_offset -= sizeof(double);
+                  header(bytes)->norms_offset -= sizeof(double);
+              }, paged).find("Corrupt snapshot layout") != std::string::npos);
+        CHECK(damaged_snapshot_error(path, [&](std::string& bytes) {
+                  bytes[bytes.size() - 1] ^= 1;
+              }, paged).find("checksum mismatch") != std::string::npos);
+    }
+}
+
+TEST_CASE(paged_snapshot_scores_like_resident_catalog) {
+    DataGeneratorOptions options;
+    options.movies = 600;
+    options.dimension = 10;
+    options.users = 12;
+    options.density = 0.05;
+    TestDataset data = make_dataset("paged", options);
+    auto rs = RecommendationSystemLoader::create_rs_from_movies(data.movies);
+    std::string path = data.movies + ".snap";
+    RecommendationSystemLoader::save_snapshot(*rs, path);
+
+    PagerOptions pages;
+    pages.block_rows = 16;
+    pages.cache_bytes = 4 * 16 * 16 * sizeof(double); // four blocks of 16-double rows
+    auto paged = RecommendationSystemLoader::load_snapshot_paged(path, pages);
+    CHECK(paged->get_movies().is_paged());
+    CHECK_EQ(paged->get_movies().size(), rs->get_movies().size());
+
+    std::vector<User> users = UsersLoader::create_users(data.users, rs);
+    std::vector<User> paged_users = UsersLoader::create_users(data.users, paged);
+    auto same = [](const std::vector<scored_movie>& a, const std::vector<scored_movie>& b) {
+        if (a.size() != b.size()) return false;
+        for (std::size_t i = 0; i < a.size(); ++i) {
+            if (a[i].first->get_name() != b[i].first->get_name() ||
+                a[i].second != b[i].second) {
+                return false;
+            }
+        }
+        return true;
+    };
+    MovieCatalog catalog = rs->get_movies();
+    for (std::size_t u = 0; u < users.size(); ++u) {
+        CHECK(same(paged->recommend_top_n_by_content(paged_users[u], 5),
+                   rs->recommend_top_n_by_content(users[u], 5)));
+        CHECK(same(paged->recommend_top_n_by_cf(paged_users[u], 3, 5),
+                   rs->recommend_top_n_by_cf(users[u], 3, 5)));
+        sp_movie target = catalog.movie(static_cast<movie_id>(u * 37));
+        CHECK_EQ(paged->predict_movie_score(paged_users[u], target, 3),
+                 rs->predict_movie_score(users[u], target, 3));
+    }
+    sp_movie last = catalog.movie(static_cast<movie_id>(catalog.size() - 1));
+    CHECK(paged->get_movie_features(last).to_vector() == rs->get_movie_features(last).to_vector());
+
+    PagerStats stats = paged->get_paging_stats();
+    CHECK(stats.misses > 0);
+    CHECK(stats.hits > 0);
+    CHECK(stats.evictions > 0);
+    CHECK(stats.prefetches > 0);
+    CHECK_EQ(stats.capacity_blocks, 4u);
+    CHECK(stats.resident_blocks <= stats.capacity_blocks);
+    CHECK_EQ(rs->get_paging_stats().misses, 0u);
+    CHECK_THROWS(paged->add_movie_to_rs("Fresh", 2030, std::vector<double>(10, 5.0)),
+                 std::logic_error);
+}
+
+TEST_CASE(ratings_matrix_round_trip_keeps_users) {
+    DataGeneratorOptions options;
+    options.movies = 150;
+    options.dimension = 5;
+    options.users = 40;
+    options.density = 0.05;
+    TestDataset data = make_dataset("matrix", options);
+    auto rs = RecommendationSystemLoader::create_rs_from_movies(data.movies);
+    std::string path = data.users + ".matrix";
+    UsersLoader::convert_users_file(data.users, path);
+    RatingsMatrix matrix(path, true);
+    CHECK_EQ(matrix.user_count(), options.users);
+    CHECK_EQ(matrix.movie_count(), options.movies);
+    CHECK(matrix.file_size() < std::filesystem::file_size(data.users));
+
+    std::vector<User> from_text = UsersLoader::create_users(data.users, rs, RatingStorage::compact);
+    std::vector<User> from_matrix = UsersLoader::create_users(matrix, rs, RatingStorage::compact);
+    CHECK_EQ(from_matrix.size(), from_text.size());
+    std::size_t entries = 0;
+    for (std::size_t u = 0; u < from_text.size() && u < from_matrix.size(); ++u) {
+        CHECK_EQ(from_matrix[u].get_name(), from_text[u].get_name());
+        const CompactRatings& expected = from_text[u].get_compact_ratings();
+        const CompactRatings& actual = from_matrix[u].get_compact_ratings();
+        CHECK(std::equal(expected.begin(), expected.end(), actual.begin(), actual.end(),
+                         [](const CompactRating& a, const CompactRating& b) {
+                             return a.id == b.id && a.rating == b.rating;
+                         }));
+        entries += expected.size();
+    }
+    CHECK_EQ(matrix.entry_count(), entries);
+
+    // Every cell is reachable from its column as well.
+    std::size_t column_entries = 0;
+    for (std::size_t column = 0; column < matrix.movie_count(); ++column) {
+        for (const RatingEntry& entry : matrix.column(column)) {
+            ++column_entries;
+            const RatingEntry* cell = nullptr;
+            for (const RatingEntry& candidate : matrix.row(entry.index)) {
+                if (candidate.index == column) cell = &candidate;
+            }
+            CHECK(cell && cell->rating == entry.rating);
+        }
+    }
+    CHECK_EQ(column_entries, entries);
+
+    {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        std::streamoff last = static_cast<std::streamoff>(matrix.file_size() - 1);
+        file.seekg(last);
+        char byte = static_cast<char>(file.get());
+        file.seekp(last);
+        file.put(static_cast<char>(~byte));
+    }
+    CHECK_THROWS(RatingsMatrix(path, true), std::runtime_error);
+}
+
+// Edits a copy of the matrix at `path`, re-seals its checksum and opens it verified.
+static std::string damaged_matrix_error(const std::string& path,
+                                        const std::function<void(std::string&)>& edit) {
+    std::ifstream in(path, std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    edit(bytes);
+    RatingsHeader* header = reinterpret_cast<RatingsHeader*>(&bytes[0]);
+    header->checksum = snapshot_checksum(bytes.data() + sizeof(RatingsHeader),
+                                         bytes.size() - sizeof(RatingsHeader));
+    std::string damaged = path + ".damaged";
+    std::ofstream(damaged, std::ios::binary).write(bytes.data(), bytes.size());
+    try {
+        RatingsMatrix matrix(damaged, true);
+    } catch (const std::runtime_error& e) {
+        return e.what();
+    }
+    return "loaded";
+}
+
+TEST_CASE(damaged_ratings_matrices_are_rejected) {
+    DataGeneratorOptions options;
+    options.movies = 30;
+    options.dimension = 4;
+    options.users = 10;
+    options.density = 0.2;
+    TestDataset data = make_dataset("damaged_matrix", options);
+    std::string path = data.users + ".matrix";
+    UsersLoader::convert_users_file(data.users, path);
+    CHECK_EQ(damaged_matrix_error(path, [](std::string&) {}), "loaded");
+
+    auto header = [](std::string& bytes) { return reinterpret_cast<RatingsHeader*>(&bytes[0]); };
+    auto entry = [&](std::string& bytes, std::uint64_t offset) {
+        return reinterpret_cast<RatingEntry*>(&bytes[offset]);
+    };
+    // (users + 1) * 8 wraps back onto the real layout.
+    CHECK(damaged_matrix_error(path, [&](std::string& bytes) {
+              header(bytes)->users += 1ull << 61;
+          }).find("Corrupt ratings matrix layout") != std::string::npos);
+    // entries * sizeof(RatingEntry) wraps to the same sizes.
+    CHECK(damaged_matrix_error(path, [&](std::string& bytes) {
+              header(bytes)->entries += 1ull << 61;
+          }).find("Corrupt ratings matrix layout") != std::string::npos);
+    CHECK(damaged_matrix_error(path, [&](std::string& bytes) {
+              header(bytes)->dictionary_offset = 0;
+          }).find("Corrupt ratings matrix layout") != std::string::npos);
+    CHECK(damaged_matrix_error(path, [&](std::string& bytes) {
+              entry(bytes, header(bytes)->row_entries_offset)->index =
+                  static_cast<std::uint32_t>(header(bytes)->movies);
+          }).find("Corrupt ratings matrix entries") != std::string::npos);
+    CHECK(damaged_matrix_error(path, [&](std::string& bytes) {
+              entry(bytes, header(bytes)->column_entries_offset)->index =
+                  static_cast<std::uint32_t>(header(bytes)->users);
+          }).find("Corrupt ratings matrix entries") != std::string::npos);
+}
+
+TEST_CASE(bad_feature_value_is_reported) {
+    std::string path = (std::filesystem::temp_directory_path() / "rs_test_bad_movies.txt").string();
+    {
+        std::ofstream file(path);
+        file << "Good-2000 1 2 3\nBad-2001 1 20 3\n";
+    }
+    std::string output = failed_load_output<std::runtime_error>([&] {
+        RecommendationSystemLoader::create_rs_from_movies(path);
+    });
+    CHECK(output.find("[ERROR] at line 2 of " + path) != std::string::npos);
+}
+
+TEST_CASE(multi_chunk_parse_matches_single_chunk) {
+    DataGeneratorOptions options;
+    options.movies = 150;
+    options.dimension = 6;
+    options.users = 40;
+    TestDataset data = make_dataset("chunks", options);
+    auto whole = RecommendationSystemLoader::create_rs_from_movies(data.movies);
+    std::vector<User> whole_users = UsersLoader::create_users(data.users, whole);
+
+    // A few hundred bytes per chunk puts every file through several chunks
+    // and the users file through several windows.
+    set_parse_limits(256, 4);
+    auto chunked = RecommendationSystemLoader::create_rs_from_movies(data.movies);
+    std::vector<User> chunked_users = UsersLoader::create_users(data.users, chunked);
+
+    MovieCatalog a = whole->get_movies(), b = chunked->get_movies();
+    CHECK_EQ(b.size(), a.size());
+    for (movie_id id = 0; id < a.size() && id < b.size(); ++id) {
+        CHECK_EQ(b.movie(id)->get_name(), a.movie(id)->get_name());
+        CHECK(b.features_of(id).to_vector() == a.features_of(id).to_vector());
+    }
+    CHECK_EQ(chunked_users.size(), whole_users.size());
+    for (std::size_t u = 0; u < whole_users.size() && u < chunked_users.size(); ++u) {
+        CHECK_EQ(chunked_users[u].get_name(), whole_users[u].get_name());
+        CHECK_EQ(chunked_users[u].get_rank().size(), whole_users[u].get_rank().size());
+    }
+
+    // Errors deep in a later chunk still name their line in the whole file.
+    std::string movies_path = data.movies + ".bad";
+    {
+        std::ofstream file(movies_path);
+        for (int line = 1; line <= 60; ++line) {
+            file << "Movie" << line << "-2000 1 2 " << (line == 47 ? 20 : 3) << "\n";
+        }
+    }
+    std::string output = failed_load_output<std::runtime_error>([&] {
+        RecommendationSystemLoader::create_rs_from_movies(movies_path);
+    });
+    CHECK(output.find("[ERROR] at line 47 of " + movies_path) != std::string::npos);
+
+    std::string users_path = data.users + ".bad";
+    {
+        std::ofstream file(users_path);
+        file << "Movie1-2000 Movie2-2000\n";
+        for (int line = 2; line <= 80; ++line) {
+            file << "user" << line << " " << (line == 71 ? "11" : "5") << " NA\n";
+        }
+    }
+    auto small = RecommendationSystemLoader::create_rs_from_movies(data.movies);
+    small->add_movie_to_rs("Movie1", 2000, std::vector<double>(6, 2.0));
+    small->add_movie_to_rs("Movie2", 2000, std::vector<double>(6, 3.0));
+    output = failed_load_output<std::invalid_argument>([&] {
+        UsersLoader::create_users(users_path, small);
+    });
+    CHECK(output.find("[ERROR] at line 71 of " + users_path) != std::string::npos);
+
+    set_parse_limits(MIN_PARSE_CHUNK_BYTES);
+}
+
+TEST_CASE(ratings_parse_like_stod) {
+    CHECK_EQ(parse_double(" 7.5"), 7.5);
+    CHECK_EQ(parse_double("0x1p3"), 8.0);
+    CHECK(std::isnan(parse_double("nan")));
+    CHECK_EQ(parse_double("-inf"), -std::numeric_limits<double>::infinity());
+    CHECK_THROWS(parse_double("x"), std::invalid_argument);
+    CHECK_THROWS(parse_double("1e999"), std::out_of_range);
+}
+
+TEST_CASE(chunk_errors_are_rethrown_after_every_thread_is_joined) {
+    for (std::size_t failing : {0, 2}) {
+        std::vector<int> done(4, 0);
+        CHECK_THROWS(run_chunks(4, [&](std::size_t i) {
+                         if (i == failing) throw std::bad_alloc();
+                         done[i] = 1;
+                     }),
+                     std::bad_alloc);
+        CHECK_EQ(std::count(done.begin(), done.end(), 1), 3);
+    }
+}
+
+TEST_CASE(users_stream_without_a_system) {
+    std::string path = (std::filesystem::temp_directory_path() / "rs_test_no_system.txt").string();
+    {
+        std::ofstream file(path);
+        file << "Alpha-2000 Beta-2001\nidle NA NA\nrater 5 NA\n";
+    }
+    std::vector<std::string> names;
+    std::string output = failed_load_output<std::runtime_error>([&] {
+        UsersLoader::stream_users(path, nullptr, [&](User& user) {
+            names.push_back(user.get_name());
+        });
+    });
+    CHECK(names == std::vector<std::string>{"idle"});
+    CHECK(output.find("[ERROR] at line 3 of " + path) != std::string::npos);
+}
+
+TEST_CASE(missing_file_throws) {
+    CHECK_THROWS(RecommendationSystemLoader::create_rs_from_movies("/nonexistent/movies.txt"),
+                 std::runtime_error);
+}
+
+TEST_MAIN()
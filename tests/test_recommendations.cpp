@@ -0,0 +1,573 @@
+#include "TestHarness.h"
+#include "TestData.h"
+#include "RecommendationSystemLoader.h"
+#include "UsersLoader.h"
+#include "QuantizationReport.h"
+#include "ReductionReport.h"
+#include "ShardedRecommender.h"
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+static bool same_ranking(const std::vector<scored_movie>& a, const std::vector<scored_movie>& b) {
+    if (a.size() != b.size()) return false;
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        if (a[i].first != b[i].first || a[i].second != b[i].second) return false;
+    }
+    return true;
+}
+
+TEST_CASE(parallel_scans_match_serial) {
+    TestSystem system = make_system("parallel");
+    auto rs = system.rs;
+    std::vector<User>& users = system.users;
+
+    std::vector<std::vector<scored_movie>> content, cf;
+    for (const User& user : users) {
+        content.push_back(rs->recommend_top_n_by_content(user, 5));
+        cf.push_back(rs->recommend_top_n_by_cf(user, 3, 5));
+    }
+    rs->set_executor(std::make_shared<ThreadPool>(3), 1);
+    for (std::size_t u = 0; u < users.size(); ++u) {
+        CHECK(same_ranking(rs->recommend_top_n_by_content(users[u], 5), content[u]));
+        CHECK(same_ranking(rs->recommend_top_n_by_cf(users[u], 3, 5), cf[u]));
+    }
+}
+
+TEST_CASE(n_beyond_catalog_returns_every_candidate) {
+    TestSystem system = make_system("huge_n");
+    auto rs = system.rs;
+    std::vector<User>& users = system.users;
+    MovieCatalog catalog = rs->get_movies();
+    // Every unrated movie, in id order.
+    auto unrated = [&](const User& user) {
+        std::vector<sp_movie> movies;
+        for (movie_id id = 0; id < catalog.size(); ++id) {
+            if (!user.get_rank().count(catalog.movie(id))) movies.push_back(catalog.movie(id));
+        }
+        return movies;
+    };
+    auto ids = [&](const std::vector<scored_movie>& ranking) {
+        std::vector<sp_movie> movies;
+        for (const scored_movie& entry : ranking) movies.push_back(entry.first);
+        std::sort(movies.begin(), movies.end(), [&](const sp_movie& a, const sp_movie& b) {
+            return catalog.find(a) < catalog.find(b);
+        });
+        return movies;
+    };
+
+    for (std::shared_ptr<ThreadPool> pool : {std::shared_ptr<ThreadPool>(),
+                                             std::make_shared<ThreadPool>(3)}) {
+        rs->set_executor(pool, 1);
+        std::vector<std::vector<scored_movie>> batch =
+            rs->recommend_top_n_by_content_batch(users, INT_MAX);
+        for (std::size_t u = 0; u < users.size(); ++u) {
+            std::vector<scored_movie> content = rs->recommend_top_n_by_content(users[u], INT_MAX);
+            std::vector<scored_movie> cf = rs->recommend_top_n_by_cf(users[u], 3, INT_MAX);
+            CHECK(ids(content) == unrated(users[u]));
+            CHECK(ids(cf) == unrated(users[u]));
+            CHECK(same_ranking(content, rs->recommend_top_n_by_content(
+                                            users[u], static_cast<int>(catalog.size()))));
+            CHECK(same_ranking(cf, rs->recommend_top_n_by_cf(users[u], 3,
+                                                             static_cast<int>(catalog.size()))));
+            CHECK(ids(batch[u]) == unrated(users[u]));
+        }
+    }
+}
+
+TEST_CASE(similarity_index_keeps_predictions_exact) {
+    TestSystem system = make_system("index");
+    auto rs = system.rs;
+    std::vector<User>& users = system.users;
+    MovieCatalog catalog = rs->get_movies();
+
+    std::vector<double> expected;
+    for (const User& user : users) {
+        expected.push_back(rs->predict_movie_score(user, catalog.movie(7), 3));
+    }
+    rs->enable_similarity_index(catalog.size());
+    CHECK(rs->get_similarity_index() != nullptr);
+    for (std::size_t u = 0; u < users.size(); ++u) {
+        CHECK_NEAR(rs->predict_movie_score(users[u], catalog.movie(7), 3), expected[u], 1e-12);
+    }
+}
+
+TEST_CASE(ann_with_every_list_probed_is_exact) {
+    TestSystem system = make_system("ann");
+    auto rs = system.rs;
+    std::vector<User>& users = system.users;
+    AnnOptions options;
+    options.lists = 8;
+    rs->enable_ann_index(options);
+    for (const User& user : users) {
+        std::vector<scored_movie> exact = rs->recommend_top_n_by_content_exact(user, 5);
+        CHECK(same_ranking(rs->recommend_top_n_by_content_ann(user, 5, options.lists), exact));
+    }
+    rs->disable_ann_index();
+    CHECK_THROWS(rs->recommend_top_n_by_content_ann(users[0], 5, 1), std::logic_error);
+}
+
+TEST_CASE(quantized_features_stay_close_to_double) {
+    TestSystem system = make_system("quantized");
+    auto rs = system.rs;
+    std::vector<User>& users = system.users;
+
+    QuantizationReport single = measure_quantization_error(*rs, users, FeatureStorage::float32);
+    CHECK(rs->get_feature_storage() == FeatureStorage::float32);
+    CHECK(single.max_content_deviation < 1e-5);
+    CHECK(single.max_predict_deviation < 1e-4);
+    CHECK(single.feature_bytes * 2 <= single.double_bytes + 64);
+
+    QuantizationReport bytes = measure_quantization_error(*rs, users, FeatureStorage::uint8);
+    CHECK(rs->get_feature_storage() == FeatureStorage::uint8);
+    CHECK_NEAR(rs->get_quantized_features()->quantization_step(), 9.0 / 255.0, 1e-3);
+    CHECK(bytes.max_content_deviation < 1e-2);
+    // Predictions can move further: a small cosine change may swap which
+    // rated movies make the top k.
+    CHECK(bytes.max_predict_deviation < 10.0);
+    CHECK(bytes.top1_agreement >= 0.8);
+    CHECK(bytes.feature_bytes < single.feature_bytes);
+
+    // Movies added after the copy was built are scored in double.
+    std::size_t dim = rs->get_movies().dimension();
+    sp_movie added = rs->add_movie_to_rs("Fresh", 2030, std::vector<double>(dim, 5.0));
+    CHECK(rs->get_quantized_features()->indexed_count() < rs->get_movies().size());
+    CHECK(rs->predict_movie_score(users[0], added, 3) > 0.0);
+
+    rs->set_feature_storage(FeatureStorage::float64);
+    CHECK(rs->get_quantized_features() == nullptr);
+}
+
+TEST_CASE(reduced_features_track_full_width_rankings) {
+    TestSystem system = make_system("reduced");
+    auto rs = system.rs;
+    std::vector<User>& users = system.users;
+    std::vector<std::vector<scored_movie>> full;
+    for (const User& user : users) full.push_back(rs->recommend_top_n_by_content(user, 5));
+
+    ReductionOptions options;
+    options.dimension = 6;
+    ReductionReport report = measure_reduction(*rs, users, options, 5);
+    CHECK_EQ(report.input_dimension, 10u);
+    CHECK_EQ(report.output_dimension, 6u);
+    CHECK(report.explained_variance > 0.9 && report.explained_variance <= 1.0 + 1e-12);
+    // The report compares exactly the lists a caller sees before and after.
+    double changed = 0.0, overlap = 0.0;
+    for (std::size_t u = 0; u < users.size(); ++u) {
+        std::vector<scored_movie> reduced = rs->recommend_top_n_by_content(users[u], 5);
+        CHECK_EQ(reduced.size(), full[u].size());
+        changed += reduced.front().first != full[u].front().first;
+        std::size_t kept = 0;
+        for (const scored_movie& entry : full[u]) {
+            for (const scored_movie& other : reduced) kept += other.first == entry.first;
+        }
+        overlap += static_cast<double>(kept) / full[u].size();
+    }
+    CHECK_NEAR(report.top1_change_rate, changed / users.size(), 1e-12);
+    CHECK_NEAR(report.top_n_overlap, overlap / users.size(), 1e-12);
+    CHECK_EQ(rs->get_movies().dimension(), 6u);
+    CHECK_THROWS(rs->reduce_features(rs->get_feature_reduction()), std::logic_error);
+
+    // Projecting a full-width maintained preference scores like a preference
+    // built over the projected rows.
+    std::vector<User> reloaded = system.load_users();
+    for (std::size_t u = 0; u < users.size(); ++u) {
+        std::vector<scored_movie> projected = rs->recommend_top_n_by_content(users[u], 5);
+        std::vector<scored_movie> rebuilt = rs->recommend_top_n_by_content(reloaded[u], 5);
+        CHECK_EQ(projected.size(), rebuilt.size());
+        for (std::size_t r = 0; r < std::min(projected.size(), rebuilt.size()); ++r) {
+            CHECK_NEAR(projected[r].second, rebuilt[r].second, 1e-9);
+        }
+    }
+
+    // New movies come in at full width and are projected.
+    sp_movie added = rs->add_movie_to_rs("Fresh", 2030, std::vector<double>(10, 5.0));
+    CHECK_EQ(rs->get_movie_features(added).size(), 6u);
+    CHECK_THROWS(rs->add_movie_to_rs("Narrow", 2030, std::vector<double>(6, 5.0)),
+                 std::runtime_error);
+
+    rs->restore_features();
+    CHECK(rs->get_feature_reduction() == nullptr);
+    CHECK_EQ(rs->get_movies().dimension(), 10u);
+    CHECK_EQ(rs->get_movie_features(added).size(), 10u);
+    CHECK(same_ranking(rs->recommend_top_n_by_content(users[0], 5), full[0]));
+
+    rs->reduce_features(FeatureReduction::fit(rs->get_movies(), options), false);
+    CHECK_THROWS(rs->restore_features(), std::logic_error);
+
+    ReductionOptions projection;
+    projection.method = ReductionMethod::random_projection;
+    CHECK_THROWS(FeatureReduction::fit(rs->get_movies(), projection), std::invalid_argument);
+    projection.dimension = 4;
+    auto first = FeatureReduction::fit(rs->get_movies(), projection);
+    auto second = FeatureReduction::fit(rs->get_movies(), projection);
+    std::vector<double> row(6, 1.0);
+    CHECK(first->project(row) == second->project(row));
+    options.dimension = 6;
+    CHECK_THROWS(FeatureReduction::fit(rs->get_movies(), options), std::invalid_argument);
+}
+
+TEST_CASE(compact_ratings_match_map_ratings) {
+    TestSystem system = make_system("compact");
+    auto rs = system.rs;
+    const std::vector<User>& map_users = system.users;
+    std::vector<User> compact_users = system.load_users(RatingStorage::compact);
+    CHECK_EQ(map_users.size(), compact_users.size());
+    sp_movie target = rs->get_movies().movie(11);
+    for (std::size_t u = 0; u < map_users.size() && u < compact_users.size(); ++u) {
+        CHECK_EQ(compact_users[u].get_compact_ratings().size(), map_users[u].get_rank().size());
+        CHECK_NEAR(rs->predict_movie_score(compact_users[u], target, 2),
+                   rs->predict_movie_score(map_users[u], target, 2), 1e-5);
+    }
+}
+
+// Dense reference for user-user CF: every user against every other user.
+static double brute_force_user_cf(const MovieCatalog& catalog, const std::vector<User>& users,
+                                  std::size_t target, movie_id movie, std::size_t k) {
+    std::vector<std::map<movie_id, double>> centered(users.size());
+    std::vector<double> means(users.size()), norms(users.size());
+    for (std::size_t u = 0; u < users.size(); ++u) {
+        const rank_map& ratings = users[u].get_rank();
+        for (const auto& [rated, rating] : ratings) means[u] += rating / ratings.size();
+        for (const auto& [rated, rating] : ratings) {
+            centered[u][catalog.find(rated)] = rating - means[u];
+            norms[u] += (rating - means[u]) * (rating - means[u]);
+        }
+        norms[u] = std::sqrt(norms[u]);
+    }
+    std::vector<std::pair<double, std::size_t>> similar;
+    for (std::size_t v = 0; v < users.size(); ++v) {
+        if (v == target || norms[v] == 0.0 || norms[target] == 0.0) continue;
+        double dot = 0.0;
+        for (const auto& [rated, value] : centered[target]) {
+            auto it = centered[v].find(rated);
+            if (it != centered[v].end()) dot += value * it->second;
+        }
+        double similarity = dot / (norms[target] * norms[v]);
+        if (similarity > 0.0) similar.emplace_back(-similarity, v);
+    }
+    std::sort(similar.begin(), similar.end());
+    similar.resize(std::min(similar.size(), k));
+    double numerator = 0.0, denominator = 0.0;
+    for (const auto& [negated, v] : similar) {
+        auto it = centered[v].find(movie);
+        if (it == centered[v].end()) continue;
+        numerator -= negated * it->second;
+        denominator -= negated;
+    }
+    return denominator == 0.0 ? means[target] : means[target] + numerator / denominator;
+}
+
+TEST_CASE(user_cf_matches_dense_reference) {
+    DataGeneratorOptions options = small_options();
+    options.movies = 60;
+    options.density = 0.3;
+    TestSystem system = make_system("user_cf", options);
+    auto rs = system.rs;
+    const std::vector<User>& users = system.users;
+    MovieCatalog catalog = rs->get_movies();
+
+    CHECK_THROWS(rs->recommend_by_user_cf(users[0], 3), std::logic_error);
+    rs->enable_user_cf(users);
+    CHECK_EQ(rs->get_user_cf_index()->user_count(), users.size());
+
+    for (std::size_t u = 0; u < users.size(); ++u) {
+        for (movie_id movie = 0; movie < catalog.size(); movie += 7) {
+            if (users[u].get_rank().count(catalog.movie(movie))) continue;
+            CHECK_NEAR(rs->predict_movie_score_by_user_cf(users[u], catalog.movie(movie), 4),
+                       brute_force_user_cf(catalog, users, u, movie, 4), 1e-4);
+        }
+        // The top five scores of the dense reference over every unrated movie.
+        std::vector<double> reference;
+        for (movie_id movie = 0; movie < catalog.size(); ++movie) {
+            if (users[u].get_rank().count(catalog.movie(movie))) continue;
+            reference.push_back(brute_force_user_cf(catalog, users, u, movie, 4));
+        }
+        std::sort(reference.rbegin(), reference.rend());
+        reference.resize(std::min<std::size_t>(reference.size(), 5));
+        std::vector<scored_movie> best = rs->recommend_top_n_by_user_cf(users[u], 4, 5);
+        CHECK_EQ(best.size(), reference.size());
+        for (std::size_t i = 0; i < best.size() && i < reference.size(); ++i) {
+            CHECK(users[u].get_rank().count(best[i].first) == 0);
+            CHECK_NEAR(best[i].second, reference[i], 1e-4);
+            CHECK_NEAR(best[i].second,
+                       rs->predict_movie_score_by_user_cf(users[u], best[i].first, 4), 1e-9);
+        }
+    }
+}
+
+TEST_CASE(maintained_preference_matches_recomputed) {
+    auto rs = make_system("preference").rs;
+    MovieCatalog catalog = rs->get_movies();
+    for (RatingStorage storage : {RatingStorage::map, RatingStorage::compact}) {
+        User user("preference", rs, storage);
+        for (movie_id id = 0; id < 120; id += 3) {
+            user.add_rating(catalog.movie(id), 1.0 + id % 10);
+        }
+        // Changing ratings only moves the weights, not the feature sums.
+        for (movie_id id = 0; id < 60; id += 9) {
+            user.add_rating(catalog.movie(id), 10.0 - id % 7);
+        }
+        CHECK(user.get_preference().is_valid());
+        CHECK_EQ(user.get_preference().size(), user.get_rank().size());
+
+        // The same ratings in one bulk call, out of id order.
+        std::vector<std::pair<sp_movie, double>> ratings;
+        for (movie_id end = 120; end > 0; end -= 3) {
+            ratings.emplace_back(catalog.movie(end - 3), 1.0 + (end - 3) % 10);
+        }
+        for (movie_id id = 0; id < 60; id += 9) {
+            ratings.emplace_back(catalog.movie(id), 10.0 - id % 7);
+        }
+        User bulk("bulk", rs, storage);
+        bulk.add_ratings(catalog, ratings);
+        CHECK(bulk.get_rated_ids() == user.get_rated_ids());
+        CHECK(std::is_sorted(bulk.get_rated_ids().begin(), bulk.get_rated_ids().end()));
+        CHECK(bulk.get_rank() == user.get_rank());
+        const CompactRatings& stored = bulk.get_compact_ratings();
+        // Strictly increasing ids: sorted, one entry per movie.
+        CHECK(std::adjacent_find(stored.begin(), stored.end(),
+                                 [](const CompactRating& a, const CompactRating& b) {
+                                     return a.id >= b.id;
+                                 }) == stored.end());
+        CHECK_EQ(bulk.get_preference().size(), user.get_preference().size());
+        CHECK_NEAR(bulk.get_preference().norm(), user.get_preference().norm(), 1e-9);
+
+        std::vector<scored_movie> maintained = rs->recommend_top_n_by_content(user, 10);
+        std::vector<scored_movie> recomputed = rs->recommend_top_n_by_content(user.get_rank(), 10);
+        CHECK_EQ(maintained.size(), recomputed.size());
+        for (std::size_t i = 0; i < maintained.size() && i < recomputed.size(); ++i) {
+            CHECK_NEAR(maintained[i].second, recomputed[i].second, 1e-9);
+        }
+    }
+}
+
+TEST_CASE(batch_scoring_matches_per_user_scans) {
+    TestSystem system = make_system("batch");
+    auto rs = system.rs;
+    // More users than one block, in both storage modes.
+    std::vector<User>& users = system.users;
+    std::vector<User> compact = system.load_users(RatingStorage::compact);
+    users.insert(users.end(), compact.begin(), compact.end());
+    users.emplace_back("nobody", rs);
+
+    for (std::shared_ptr<ThreadPool> pool : {std::shared_ptr<ThreadPool>(),
+                                             std::make_shared<ThreadPool>(3)}) {
+        rs->set_executor(pool, 1);
+        std::vector<std::vector<scored_movie>> batch = rs->recommend_top_n_by_content_batch(users, 7);
+        CHECK_EQ(batch.size(), users.size());
+        for (std::size_t u = 0; u < users.size() && u < batch.size(); ++u) {
+            std::vector<scored_movie> single = rs->recommend_top_n_by_content_exact(users[u], 7);
+            CHECK_EQ(batch[u].size(), single.size());
+            for (std::size_t i = 0; i < single.size() && i < batch[u].size(); ++i) {
+                CHECK_NEAR(batch[u][i].second, single[i].second, 1e-12);
+                bool tied = (i > 0 && single[i - 1].second - single[i].second < 1e-12) ||
+                            (i + 1 < single.size() && single[i].second - single[i + 1].second < 1e-12);
+                if (!tied) CHECK(batch[u][i].first == single[i].first);
+            }
+        }
+    }
+}
+
+TEST_CASE(sharded_scans_match_unsharded) {
+    TestSystem system = make_system("sharded");
+    auto rs = system.rs;
+    std::vector<User>& users = system.users;
+    std::vector<User> compact = system.load_users(RatingStorage::compact);
+    users.insert(users.end(), compact.begin(), compact.end());
+    // Rated in a system of another width: the preference is rebuilt from rows
+    // the shards hand back.
+    User other("other", std::make_shared<RecommendationSystem>());
+    for (movie_id id = 0; id < 5; ++id) {
+        const sp_movie& movie = rs->get_movies().movie(id);
+        other.add_movie_to_user(movie->get_name(), movie->get_year(), {2.0 + id, 5.0}, 1.0 + id);
+    }
+    users.push_back(other);
+
+    for (std::size_t shards : {1, 3}) {
+        ShardedRecommender sharded(rs, shards);
+        std::size_t held = 0;
+        for (std::size_t s = 0; s < sharded.shard_count(); ++s) held += sharded.shard_size(s);
+        CHECK_EQ(held, rs->get_movies().size());
+        for (const User& user : users) {
+            CHECK(same_ranking(sharded.recommend_top_n_by_content(user, 7),
+                               rs->recommend_top_n_by_content(user, 7)));
+            CHECK(same_ranking(sharded.recommend_top_n_by_cf(user, 3, 7),
+                               rs->recommend_top_n_by_cf(user, 3, 7)));
+            CHECK(sharded.recommend_by_content(user) == rs->recommend_by_content(user));
+        }
+        CHECK_THROWS(sharded.recommend_top_n_by_cf(users[0], -1, 3), std::invalid_argument);
+    }
+
+    // Full-width preferences are projected by the coordinator.
+    ReductionOptions options;
+    options.dimension = 6;
+    rs->reduce_features(FeatureReduction::fit(rs->get_movies(), options));
+    std::vector<User> reduced = system.load_users();
+    users.insert(users.end(), reduced.begin(), reduced.end());
+    ShardedRecommender sharded(rs, 2);
+    for (const User& user : users) {
+        CHECK(same_ranking(sharded.recommend_top_n_by_content(user, 7),
+                           rs->recommend_top_n_by_content(user, 7)));
+    }
+}
+
+TEST_CASE(result_cache_never_serves_stale_results) {
+    TestSystem system = make_system("cache");
+    auto rs = system.rs;
+    std::vector<User>& users = system.users;
+    MovieCatalog catalog = rs->get_movies();
+    User& user = users[0];
+
+    std::vector<scored_movie> content = rs->recommend_top_n_by_content(user, 5);
+    double predicted = rs->predict_movie_score(user, catalog.movie(5), 3);
+    rs->enable_result_cache(64);
+    for (int round = 0; round < 3; ++round) {
+        CHECK(same_ranking(rs->recommend_top_n_by_content(user, 5), content));
+        CHECK_EQ(rs->predict_movie_score(user, catalog.movie(5), 3), predicted);
+    }
+    ResultCacheStats stats = rs->result_cache_stats();
+    CHECK_EQ(stats.misses, 2u);
+    CHECK_EQ(stats.hits, 4u);
+
+    // A new rating and a new movie each change the answer's key.
+    user.add_rating(content.front().first, 1.0);
+    CHECK(same_ranking(rs->recommend_top_n_by_content(user, 5),
+                       rs->recommend_top_n_by_content_exact(user, 5)));
+    std::vector<double> features(catalog.features_of(0).begin(), catalog.features_of(0).end());
+    rs->add_movie_to_rs("Clone", 2030, features);
+    std::vector<scored_movie> widened = rs->recommend_top_n_by_content(user, 50);
+    CHECK_EQ(widened.size(), 50u);
+    CHECK(same_ranking(widened, rs->recommend_top_n_by_content_exact(user, 50)));
+    CHECK_EQ(rs->result_cache_stats().hits, 4u);
+
+    // Copies share the entries until one of them changes its ratings.
+    User copy = users[1];
+    rs->recommend_by_cf(users[1], 3);
+    rs->recommend_by_cf(copy, 3);
+    CHECK_EQ(rs->result_cache_stats().hits, 5u);
+    copy.add_rating(catalog.movie(0), 10.0);
+    rs->recommend_by_cf(copy, 3);
+    CHECK_EQ(rs->result_cache_stats().hits, 5u);
+}
+
+TEST_CASE(filters_apply_inside_the_scan) {
+    TestSystem system = make_system("filter");
+    auto rs = system.rs;
+    std::vector<User>& users = system.users;
+    MovieCatalog catalog = rs->get_movies();
+
+    RecommendationFilter filter;
+    filter.min_year = 1980;
+    filter.max_year = 2005;
+    for (movie_id id = 0; id < catalog.size(); id += 2) filter.allow.push_back(catalog.movie(id));
+    for (movie_id id = 0; id < catalog.size(); id += 6) filter.exclude.push_back(catalog.movie(id));
+    auto passes = [&](const sp_movie& movie) {
+        movie_id id = catalog.find(movie);
+        return id % 2 == 0 && id % 6 != 0 && movie->get_year() >= 1980 && movie->get_year() <= 2005;
+    };
+    // The unfiltered ranking of every movie, filtered afterwards.
+    auto expected = [&](std::vector<scored_movie> all) {
+        std::vector<scored_movie> kept;
+        for (const scored_movie& entry : all) {
+            if (passes(entry.first) && kept.size() < 5) kept.push_back(entry);
+        }
+        return kept;
+    };
+
+    for (int pass = 0; pass < 2; ++pass) {
+        for (std::size_t u = 0; u < 5; ++u) {
+            CHECK(same_ranking(rs->recommend_top_n_by_content(users[u], 5, filter),
+                               expected(rs->recommend_top_n_by_content(users[u], catalog.size()))));
+            CHECK(same_ranking(rs->recommend_top_n_by_cf(users[u], 3, 5, filter),
+                               expected(rs->recommend_top_n_by_cf(users[u], 3, catalog.size()))));
+        }
+        rs->set_executor(std::make_shared<ThreadPool>(3), 1);
+    }
+    // Allowing a single passing movie returns it alone, scored as unfiltered.
+    movie_id only = 2;
+    while (!passes(catalog.movie(only)) || users[0].get_rank().count(catalog.movie(only))) {
+        only += 2;
+    }
+    filter.allow = {catalog.movie(only)};
+    std::vector<scored_movie> alone = rs->recommend_top_n_by_content(users[0], 5, filter);
+    CHECK_EQ(alone.size(), 1u);
+    CHECK(alone.size() == 1 && alone[0].first == catalog.movie(only));
+    for (const scored_movie& entry :
+         rs->recommend_top_n_by_content(users[0], static_cast<int>(catalog.size()))) {
+        if (entry.first == catalog.movie(only)) CHECK(same_ranking(alone, {entry}));
+    }
+    // An excluded or out-of-range movie leaves nothing.
+    filter.allow = {catalog.movie(6)};
+    CHECK(rs->recommend_top_n_by_content(users[0], 5, filter).empty());
+}
+
+TEST_CASE(reads_run_while_movies_are_added) {
+    TestSystem system = make_system("concurrent");
+    auto rs = system.rs;
+    std::vector<User>& users = system.users;
+    std::size_t dim = rs->get_movies().dimension();
+    std::uint64_t version = rs->get_version();
+
+    std::atomic<bool> done{false};
+    std::atomic<int> bad_reads{0};
+    std::thread reader([&] {
+        for (std::size_t i = 0; !done || i < users.size(); ++i) {
+            const User& user = users[i % users.size()];
+            std::vector<scored_movie> best = rs->recommend_top_n_by_content(user, 3);
+            MovieCatalog snapshot = rs->get_movies();
+            if (best.size() != 3 || snapshot.find(snapshot.movie(snapshot.size() - 1)) == INVALID_MOVIE_ID) {
+                ++bad_reads;
+            }
+        }
+    });
+    for (int i = 0; i < 300; ++i) {
+        rs->add_movie_to_rs("Added" + std::to_string(i), 2024, std::vector<double>(dim, 1.0 + i % 9));
+    }
+    done = true;
+    reader.join();
+
+    CHECK_EQ(bad_reads.load(), 0);
+    CHECK_EQ(rs->get_movies().size(), small_options().movies + 300);
+    CHECK(rs->get_version() != version);
+    CHECK(rs->get_movie("Added299", 2024) != nullptr);
+}
+
+TEST_CASE(destroying_a_system_releases_idle_readers) {
+    std::weak_ptr<const Movie> movie;
+    std::mutex step;
+    std::condition_variable changed;
+    int stage = 0; // 1: the thread has read, 2: the system is gone
+    auto rs = std::make_shared<RecommendationSystem>();
+    movie = rs->add_movie_to_rs("Pinned", 2000, std::vector<double>{1.0, 2.0});
+
+    // A long-lived thread whose last read was of the system.
+    std::thread idle([&] {
+        CHECK(rs->get_movie("Pinned", 2000) != nullptr);
+        std::unique_lock<std::mutex> lock(step);
+        stage = 1;
+        changed.notify_all();
+        changed.wait(lock, [&] { return stage == 2; });
+    });
+    {
+        std::unique_lock<std::mutex> lock(step);
+        changed.wait(lock, [&] { return stage == 1; });
+    }
+    CHECK(rs->get_movie("Pinned", 2000) != nullptr);
+    rs.reset();
+    CHECK(movie.expired());
+    {
+        std::lock_guard<std::mutex> lock(step);
+        stage = 2;
+    }
+    changed.notify_all();
+    idle.join();
+}
+
+TEST_MAIN()
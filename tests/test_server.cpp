@@ -0,0 +1,218 @@
+#include "TestHarness.h"
+#include "TestData.h"
+#include "RecommendationClient.h"
+#include "RecommendationServer.h"
+#include "RecommendationSystemLoader.h"
+#include "UsersLoader.h"
+#include <climits>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+static DataGeneratorOptions server_options() {
+    DataGeneratorOptions options;
+    options.movies = 300;
+    options.dimension = 8;
+    options.users = 12;
+    options.density = 0.1;
+    options.seed = 9;
+    return options;
+}
+
+static std::string socket_path(const std::string& name) {
+    return (std::filesystem::temp_directory_path() / ("rs_test_" + name + ".sock")).string();
+}
+
+static ServerRequest make_request(std::uint32_t id, ServerCall call, const std::string& user) {
+    ServerRequest request;
+    request.id = id;
+    request.call = call;
+    request.user = user;
+    request.k = 3;
+    request.n = 4;
+    return request;
+}
+
+TEST_CASE(protocol_round_trips_and_rejects_truncation) {
+    ServerRequest request = make_request(7, ServerCall::predict, "user3");
+    request.movie = "Movie 12";
+    request.year = 1999;
+    std::string frame;
+    ServerProtocol::encode(request, frame);
+    CHECK_EQ(ServerProtocol::frame_size(frame.data(), frame.size()), frame.size());
+    CHECK_EQ(ServerProtocol::frame_size(frame.data(), frame.size() - 1), 0u);
+
+    ServerRequest decoded;
+    CHECK(ServerProtocol::decode(frame.data() + 4, frame.size() - 4, decoded));
+    CHECK_EQ(decoded.id, 7u);
+    CHECK(decoded.call == ServerCall::predict);
+    CHECK_EQ(decoded.user, "user3");
+    CHECK_EQ(decoded.movie, "Movie 12");
+    CHECK_EQ(decoded.year, 1999);
+    CHECK(!ServerProtocol::decode(frame.data() + 4, frame.size() - 5, decoded));
+
+    ServerResponse response;
+    response.id = 9;
+    response.movies.push_back({"A", 2001, 0.5});
+    frame.clear();
+    ServerProtocol::encode(response, frame);
+    ServerResponse back;
+    CHECK(ServerProtocol::decode(frame.data() + 4, frame.size() - 4, back));
+    CHECK_EQ(back.movies.size(), 1u);
+    CHECK_EQ(back.movies[0].name, "A");
+    CHECK_EQ(back.movies[0].score, 0.5);
+
+    request.n = INT_MAX;
+    frame.clear();
+    ServerProtocol::encode(request, frame);
+    CHECK(ServerProtocol::decode(frame.data() + 4, frame.size() - 4, decoded));
+    CHECK_EQ(decoded.n, MAX_RESPONSE_MOVIES);
+}
+
+TEST_CASE(server_answers_like_the_system) {
+    TestDataset data = make_dataset("server", server_options());
+    auto rs = RecommendationSystemLoader::create_rs_from_movies(data.movies);
+    std::vector<User> users = UsersLoader::create_users(data.users, rs);
+    ServerOptions options;
+    options.socket_path = socket_path("server");
+    RecommendationServer server(rs, users, options);
+    server.start();
+
+    RecommendationClient client(options.socket_path);
+    std::uint32_t id = 0;
+    for (const User& user : users) {
+        ServerResponse content =
+            client.call(make_request(++id, ServerCall::content, user.get_name()));
+        std::vector<scored_movie> expected = rs->recommend_top_n_by_content_exact(user, 4);
+        CHECK_EQ(content.id, id);
+        CHECK_EQ(content.movies.size(), expected.size());
+        for (std::size_t i = 0; i < expected.size() && i < content.movies.size(); ++i) {
+            CHECK_NEAR(content.movies[i].score, expected[i].second, 1e-12);
+        }
+
+        ServerResponse cf = client.call(make_request(++id, ServerCall::cf, user.get_name()));
+        expected = rs->recommend_top_n_by_cf(user, 3, 4);
+        CHECK_EQ(cf.movies.size(), expected.size());
+        for (std::size_t i = 0; i < expected.size() && i < cf.movies.size(); ++i) {
+            CHECK_EQ(cf.movies[i].name, expected[i].first->get_name());
+            CHECK_EQ(cf.movies[i].score, expected[i].second);
+        }
+
+        ServerRequest predict = make_request(++id, ServerCall::predict, user.get_name());
+        const sp_movie& movie = rs->get_movies().movie(5);
+        predict.movie = movie->get_name();
+        predict.year = movie->get_year();
+        ServerResponse score = client.call(predict);
+        CHECK_EQ(score.movies.size(), 1u);
+        if (!score.movies.empty()) {
+            CHECK_EQ(score.movies[0].score, rs->predict_movie_score(user, movie, 3));
+        }
+    }
+    ServerResponse unknown = client.call(make_request(++id, ServerCall::content, "nobody"));
+    CHECK(unknown.status == ResponseStatus::error);
+    CHECK_EQ(server.stats().errors, 1u);
+}
+
+TEST_CASE(full_queue_pauses_reads_without_dropping) {
+    TestDataset data = make_dataset("backpressure", server_options());
+    auto rs = RecommendationSystemLoader::create_rs_from_movies(data.movies);
+    std::vector<User> users = UsersLoader::create_users(data.users, rs);
+    ServerOptions options;
+    options.socket_path = socket_path("backpressure");
+    options.queue_capacity = 2;
+    options.max_batch = 2;
+    RecommendationServer server(rs, users, options);
+    server.start();
+
+    RecommendationClient client(options.socket_path);
+    const std::uint32_t requests = 200;
+    for (std::uint32_t id = 0; id < requests; ++id) {
+        client.send(make_request(id, id % 2 ? ServerCall::cf : ServerCall::content,
+                                 users[id % users.size()].get_name()));
+    }
+    for (std::uint32_t id = 0; id < requests; ++id) {
+        ServerResponse response = client.receive();
+        CHECK_EQ(response.id, id);
+        CHECK(response.status == ResponseStatus::ok);
+    }
+    ServerStats stats = server.stats();
+    CHECK_EQ(stats.requests, requests);
+    CHECK(stats.read_pauses > 0);
+    CHECK(stats.mean_batch() <= 2.0);
+}
+
+TEST_CASE(failing_request_fails_alone_in_its_batch) {
+    TestDataset data = make_dataset("isolation", server_options());
+    auto rs = RecommendationSystemLoader::create_rs_from_movies(data.movies);
+    std::vector<User> users = UsersLoader::create_users(data.users, rs);
+    // Rated a movie the served system lacks, so its content query throws.
+    User stranger("stranger", std::make_shared<RecommendationSystem>());
+    stranger.add_movie_to_user("Nowhere", 1900, {5.0, 5.0}, 7.0);
+    users.push_back(stranger);
+    ServerOptions options;
+    options.socket_path = socket_path("isolation");
+    options.batch_window = std::chrono::milliseconds(200);
+    RecommendationServer server(rs, users, options);
+    server.start();
+
+    RecommendationClient client(options.socket_path);
+    ServerRequest everything = make_request(1, ServerCall::content, users[0].get_name());
+    everything.n = INT_MAX;
+    client.send(everything);
+    client.send(make_request(2, ServerCall::content, "stranger"));
+    client.send(make_request(3, ServerCall::content, users[1].get_name()));
+
+    ServerResponse all = client.receive();
+    CHECK(all.status == ResponseStatus::ok);
+    CHECK_EQ(all.movies.size(), rs->recommend_top_n_by_content_exact(users[0], INT_MAX).size());
+    ServerResponse failed = client.receive();
+    CHECK_EQ(failed.id, 2u);
+    CHECK(failed.status == ResponseStatus::error);
+    ServerResponse other = client.receive();
+    std::vector<scored_movie> expected = rs->recommend_top_n_by_content_exact(users[1], 4);
+    CHECK(other.status == ResponseStatus::ok);
+    CHECK_EQ(other.movies.size(), expected.size());
+    for (std::size_t i = 0; i < expected.size() && i < other.movies.size(); ++i) {
+        CHECK_EQ(other.movies[i].name, expected[i].first->get_name());
+    }
+    ServerStats stats = server.stats();
+    CHECK_EQ(stats.batches, 1u);
+    CHECK_EQ(stats.errors, 1u);
+}
+
+TEST_CASE(long_titles_are_cut_to_one_frame) {
+    auto rs = std::make_shared<RecommendationSystem>();
+    const std::string padding(8000, 'x');
+    for (int i = 0; i < 200; ++i) {
+        rs->add_movie_to_rs("Movie " + std::to_string(i) + padding, 2000,
+                            {1.0 + i % 9, 1.0 + (i * 7) % 10});
+    }
+    User user("long", rs);
+    user.add_rating(rs->get_movie("Movie 0" + padding, 2000), 9.0);
+    user.add_rating(rs->get_movie("Movie 1" + padding, 2000), 2.0);
+    ServerOptions options;
+    options.socket_path = socket_path("long_titles");
+    RecommendationServer server(rs, {user}, options);
+    server.start();
+
+    RecommendationClient client(options.socket_path);
+    ServerRequest content = make_request(1, ServerCall::content, "long");
+    content.n = INT_MAX;
+    ServerRequest cf = make_request(2, ServerCall::cf, "long");
+    cf.n = INT_MAX;
+    for (const ServerRequest& request : {content, cf}) {
+        ServerResponse response = client.call(request);
+        CHECK(response.status == ResponseStatus::ok);
+        // Full up to the frame: the next title would not have fit.
+        std::string frame;
+        ServerProtocol::encode(response, frame);
+        std::size_t body = frame.size() - sizeof(std::uint32_t);
+        CHECK(body <= MAX_FRAME_BYTES);
+        CHECK(body + RESPONSE_MOVIE_BYTES + padding.size() > MAX_FRAME_BYTES);
+    }
+    // The connection is still usable.
+    ServerResponse again = client.call(make_request(3, ServerCall::content, "long"));
+    CHECK_EQ(again.movies.size(), 4u);
+}
+
+TEST_MAIN()
@@ -0,0 +1,60 @@
+#include "TestHarness.h"
+#include "TestData.h"
+#include "RecommendationSystemLoader.h"
+#include "UsersLoader.h"
+#include <sstream>
+
+#ifdef RS_ENABLE_STATS
+
+TEST_CASE(endpoints_and_counters_are_recorded) {
+    DataGeneratorOptions options;
+    options.movies = 150;
+    options.dimension = 5;
+    options.users = 6;
+    TestDataset data = make_dataset("stats", options);
+    auto rs = RecommendationSystemLoader::create_rs_from_movies(data.movies);
+    std::vector<User> users = UsersLoader::create_users(data.users, rs);
+
+    StatsSnapshot loaded = rs->stats();
+    CHECK(loaded.enabled);
+    CHECK_EQ(loaded.counter(StatsCounter::movies_parsed), options.movies);
+    CHECK_EQ(loaded.counter(StatsCounter::users_parsed), options.users);
+    CHECK_EQ(loaded.endpoint(StatsEndpoint::add_movie).calls, options.movies);
+
+    rs->reset_stats();
+    std::size_t rated = users[0].get_rank().size();
+    rs->recommend_by_content(users[0]);
+    rs->recommend_top_n_by_cf(users[0], 3, 2);
+    rs->get_movie("Movie1", 1900);
+
+    StatsSnapshot snapshot = rs->stats();
+    CHECK_EQ(snapshot.endpoint(StatsEndpoint::content).calls, 1u);
+    CHECK_EQ(snapshot.endpoint(StatsEndpoint::cf).calls, 1u);
+    CHECK_EQ(snapshot.endpoint(StatsEndpoint::get_movie).calls, 1u);
+    CHECK_EQ(snapshot.endpoint(StatsEndpoint::add_movie).calls, 0u);
+    CHECK_EQ(snapshot.counter(StatsCounter::exclusion_hits), 2 * rated);
+    CHECK_EQ(snapshot.counter(StatsCounter::candidates_scanned), 2 * (options.movies - rated));
+    // Content scores each candidate once; CF compares it with every rated movie.
+    CHECK_EQ(snapshot.counter(StatsCounter::similarity_evaluations),
+             (options.movies - rated) * (1 + rated));
+    CHECK(snapshot.endpoint(StatsEndpoint::cf).latency_percentile_ns(50) > 0);
+
+    std::ostringstream text;
+    text << snapshot;
+    CHECK(text.str().find("cf: calls=1") != std::string::npos);
+    std::string json = snapshot.to_json();
+    CHECK(json.find("\"content\":{\"calls\":1") != std::string::npos);
+    CHECK(json.find("\"exclusion_hits\":" + std::to_string(2 * rated)) != std::string::npos);
+}
+
+#else
+
+TEST_CASE(stats_are_compiled_out) {
+    RecommendationSystem rs;
+    CHECK(!rs.stats().enabled);
+    CHECK_EQ(rs.stats().to_json().find("\"enabled\":false"), 1u);
+}
+
+#endif
+
+TEST_MAIN()